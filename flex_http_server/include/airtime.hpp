@@ -0,0 +1,61 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+
+// One FLEX frame (1.875 s at 1600 bps); the size assumed before any page is encoded
+#define FLEX_FRAME_BYTES 375
+
+// Weight of a new sample in the running averages, in 1/16ths
+#define AIRTIME_EWMA_WEIGHT 4
+
+/**
+ * @brief Estimates how long the transmitter is busy with one page.
+ *
+ * A page costs its time on air (the encoded frame at the FLEX bitrate) plus
+ * a fixed overhead for opening the device and the AT command round trips.
+ * The overhead starts at the configured value and follows what the radio
+ * actually measures, and the frame size used before a page is encoded
+ * follows the frames seen so far. Not thread-safe.
+ */
+class AirtimeModel {
+public:
+    AirtimeModel(uint32_t bitrate_bps, uint32_t overhead_ms)
+        : bitrate(bitrate_bps ? bitrate_bps : 1600), overhead(overhead_ms), typical_frame(FLEX_FRAME_BYTES) {}
+
+    uint32_t on_air_ms(size_t frame_bytes) const {
+        return static_cast<uint32_t>(frame_bytes * 8 * 1000 / bitrate);
+    }
+
+    // Whole transmission of an encoded frame
+    uint32_t page_ms(size_t frame_bytes) const {
+        return on_air_ms(frame_bytes) + overhead;
+    }
+
+    // Best guess for a page that has not been encoded yet
+    uint32_t estimate_ms() const {
+        return page_ms(typical_frame);
+    }
+
+    void observe_frame(size_t frame_bytes) {
+        typical_frame = average(typical_frame, frame_bytes);
+    }
+
+    // elapsed_ms: how long the radio took to send a frame of frame_bytes
+    void observe_transmit(size_t frame_bytes, uint32_t elapsed_ms) {
+        uint32_t air = on_air_ms(frame_bytes);
+        overhead = static_cast<uint32_t>(average(overhead, elapsed_ms > air ? elapsed_ms - air : 0));
+    }
+
+    uint32_t overhead_ms() const {
+        return overhead;
+    }
+
+private:
+    static size_t average(size_t current, size_t sample) {
+        return (current * (16 - AIRTIME_EWMA_WEIGHT) + sample * AIRTIME_EWMA_WEIGHT) / 16;
+    }
+
+    uint32_t bitrate;
+    uint32_t overhead;
+    size_t typical_frame;
+};
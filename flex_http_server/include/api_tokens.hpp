@@ -0,0 +1,111 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <algorithm>
+#include <cstdint>
+#include "auth_cache.hpp"
+
+// Tokens shorter than this are rejected when the token file is loaded
+#define API_TOKEN_MIN_LENGTH 16
+
+/**
+ * @brief Compares two strings in time that depends only on their lengths.
+ */
+inline bool constant_time_equals(std::string_view a, std::string_view b) {
+    unsigned char diff = (a.size() == b.size()) ? 0 : 1;
+    size_t n = std::max(a.size(), b.size());
+    for (size_t i = 0; i < n; ++i) {
+        unsigned char x = i < a.size() ? a[i] : 0;
+        unsigned char y = i < b.size() ? b[i] : 0;
+        diff |= x ^ y;
+    }
+    return diff == 0;
+}
+
+/**
+ * @brief In-memory table of bearer tokens for machine clients.
+ *
+ * The token file holds one "name:token" pair per line ('#' starts a comment).
+ * Tokens are bucketed by a SipHash under a random per-process key, so the
+ * lookup itself reveals nothing useful about stored tokens, and the final
+ * match is a constant-time comparison.
+ */
+class ApiTokenTable {
+public:
+    ApiTokenTable() {
+        std::random_device rd;
+        for (int i = 0; i < 2; ++i) {
+            key[i] = (static_cast<uint64_t>(rd()) << 32) | rd();
+        }
+    }
+
+    // Replaces the table with the file contents; a missing file leaves it empty
+    size_t load(const std::string& filename) {
+        tokens.clear();
+
+        std::ifstream file(filename);
+        if (!file.is_open()) {
+            return 0;
+        }
+
+        std::string line;
+        int line_number = 0;
+        while (std::getline(file, line)) {
+            line_number++;
+            if (!line.empty() && line.back() == '\r') {
+                line.pop_back();
+            }
+            if (line.empty() || line[0] == '#') {
+                continue;
+            }
+
+            size_t colon = line.find(':');
+            if (colon == std::string::npos || colon == 0) {
+                std::cerr << "Ignoring malformed line " << line_number << " in '" << filename << "'" << std::endl;
+                continue;
+            }
+
+            std::string name = line.substr(0, colon);
+            std::string token = line.substr(colon + 1);
+            if (token.size() < API_TOKEN_MIN_LENGTH) {
+                std::cerr << "Ignoring token for '" << name << "': shorter than "
+                          << API_TOKEN_MIN_LENGTH << " characters" << std::endl;
+                continue;
+            }
+            tokens.emplace(hash(token), Entry{name, token});
+        }
+        return tokens.size();
+    }
+
+    // Returns the client name owning the token, or nullptr
+    const std::string* lookup(std::string_view token) const {
+        auto range = tokens.equal_range(hash(token));
+        for (auto it = range.first; it != range.second; ++it) {
+            if (constant_time_equals(it->second.token, token)) {
+                return &it->second.name;
+            }
+        }
+        return nullptr;
+    }
+
+    size_t size() const {
+        return tokens.size();
+    }
+
+private:
+    struct Entry {
+        std::string name;
+        std::string token;
+    };
+
+    uint64_t hash(std::string_view token) const {
+        return siphash24(key, token.data(), token.size());
+    }
+
+    uint64_t key[2];
+    std::unordered_multimap<uint64_t, Entry> tokens;
+};
@@ -0,0 +1,699 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include <errno.h>
+#include <unistd.h>
+#include "metrics.hpp"
+
+typedef enum {
+    LOG_LEVEL_ERROR,
+    LOG_LEVEL_WARN,
+    LOG_LEVEL_INFO,
+    LOG_LEVEL_DEBUG,
+    LOG_LEVEL_TRACE,
+    LOG_LEVEL_COUNT
+} log_level_t;
+
+typedef enum {
+    LOG_CORE,       // startup, shutdown and the event loop
+    LOG_HTTP,
+    LOG_SERIAL,
+    LOG_BINARY,
+    LOG_QUEUE,
+    LOG_ENCODER,
+    LOG_RADIO,
+    LOG_AT,         // AT command traffic with the FLEX device
+    LOG_COMPONENT_COUNT
+} log_component_t;
+
+// Bytes of queued records per logging thread
+#define LOG_RING_BYTES (256 * 1024)
+
+// Largest single record; longer strings and dumps are cut short
+#define LOG_MAX_RECORD 4096
+
+// How long the writer sleeps when every ring is empty
+#define LOG_FLUSH_MS 20
+
+inline const char* log_level_name(log_level_t level) {
+    switch (level) {
+    case LOG_LEVEL_ERROR: return "error";
+    case LOG_LEVEL_WARN:  return "warn";
+    case LOG_LEVEL_INFO:  return "info";
+    case LOG_LEVEL_DEBUG: return "debug";
+    case LOG_LEVEL_TRACE: return "trace";
+    case LOG_LEVEL_COUNT: break;
+    }
+    return "unknown";
+}
+
+inline const char* log_component_name(log_component_t component) {
+    switch (component) {
+    case LOG_CORE:    return "core";
+    case LOG_HTTP:    return "http";
+    case LOG_SERIAL:  return "serial";
+    case LOG_BINARY:  return "binary";
+    case LOG_QUEUE:   return "queue";
+    case LOG_ENCODER: return "encoder";
+    case LOG_RADIO:   return "radio";
+    case LOG_AT:      return "at";
+    case LOG_COMPONENT_COUNT: break;
+    }
+    return "unknown";
+}
+
+inline void log_json_escape(std::string& out, std::string_view text) {
+    static const char digits[] = "0123456789abcdef";
+    for (char c : text) {
+        unsigned char u = static_cast<unsigned char>(c);
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if (c == '\n') {
+            out += "\\n";
+        } else if (c == '\r') {
+            out += "\\r";
+        } else if (c == '\t') {
+            out += "\\t";
+        } else if (u < 0x20) {
+            out += "\\u00";
+            out += digits[u >> 4];
+            out += digits[u & 0xF];
+        } else {
+            out += c;
+        }
+    }
+}
+
+typedef enum {
+    LOG_FIELD_UINT,
+    LOG_FIELD_INT,
+    LOG_FIELD_DOUBLE,
+    LOG_FIELD_BOOL,
+    LOG_FIELD_STRING,
+    LOG_FIELD_HEX       // raw bytes, printed as a hex string
+} log_field_t;
+
+/*
+ * Record layout, 8-byte aligned throughout:
+ *
+ *   LogRecordHeader
+ *   field_count x { LogFieldHeader, value padded to 8 bytes }
+ *
+ * Numbers are stored as 8 raw bytes, strings and dumps as their bytes.
+ * Keys and event names are pointers, so they must be string literals.
+ */
+struct LogRecordHeader {
+    uint32_t size;              // whole record; 0 marks the unused end of a ring
+    uint8_t level;
+    uint8_t component;
+    uint8_t truncated;
+    uint8_t field_count;
+    int64_t time_ns;            // system clock
+    const char* event;
+};
+
+struct LogFieldHeader {
+    const char* key;
+    uint32_t type;
+    uint32_t length;
+};
+
+inline size_t log_align(size_t n) {
+    return (n + 7) & ~static_cast<size_t>(7);
+}
+
+/**
+ * @brief Single-producer, single-consumer byte ring holding one thread's
+ * records until the writer thread formats them.
+ *
+ * The producer only moves head and the consumer only moves tail, so both
+ * sides work without locks. A record that would straddle the end of the
+ * buffer is preceded by a zero size marker and written at the start instead.
+ * When the ring is full the record is dropped and counted, never waited for.
+ */
+struct LogRing {
+    explicit LogRing(unsigned thread_index)
+        : data(new char[LOG_RING_BYTES]), head(0), tail(0), dropped(0), dropped_reported(0),
+          thread(thread_index) {}
+
+    bool push(const char* record, uint32_t size) {
+        uint64_t h = head.load(std::memory_order_relaxed);
+        uint64_t t = tail.load(std::memory_order_acquire);
+        size_t offset = h % LOG_RING_BYTES;
+        size_t contiguous = LOG_RING_BYTES - offset;
+        size_t needed = size <= contiguous ? size : contiguous + size;
+        if (h - t + needed > LOG_RING_BYTES) {
+            dropped.store(dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            return false;
+        }
+        if (size > contiguous) {
+            uint32_t marker = 0;
+            memcpy(data.get() + offset, &marker, sizeof(marker));
+            h += contiguous;
+            offset = 0;
+        }
+        memcpy(data.get() + offset, record, size);
+        head.store(h + size, std::memory_order_release);
+        return true;
+    }
+
+    // Calls fn(record) for every queued record, releasing each as it goes
+    template <typename F>
+    size_t drain(F fn) {
+        uint64_t t = tail.load(std::memory_order_relaxed);
+        uint64_t h = head.load(std::memory_order_acquire);
+        size_t count = 0;
+        while (t < h) {
+            size_t offset = t % LOG_RING_BYTES;
+            uint32_t size;
+            memcpy(&size, data.get() + offset, sizeof(size));
+            if (size == 0) {
+                t += LOG_RING_BYTES - offset;
+            } else {
+                fn(data.get() + offset);
+                t += size;
+                ++count;
+            }
+            tail.store(t, std::memory_order_release);
+        }
+        return count;
+    }
+
+    std::unique_ptr<char[]> data;
+    alignas(64) std::atomic<uint64_t> head;
+    alignas(64) std::atomic<uint64_t> tail;
+    std::atomic<uint64_t> dropped;      // written by the producer only
+    uint64_t dropped_reported;          // writer thread only
+    unsigned thread;
+};
+
+/**
+ * @brief Asynchronous JSON-lines logger.
+ *
+ * Callers copy their fields into a binary record and push it onto a ring
+ * owned by their thread; nothing is formatted or written on their side.
+ * A background thread drains every ring, turns the records into one JSON
+ * object per line and writes them in batches. Each component has its own
+ * level, which can be changed at any time from any thread.
+ */
+class Logger {
+    struct LogLine {
+        int64_t time_ns;
+        size_t offset;
+        size_t length;
+    };
+
+public:
+    Logger() : fd(STDOUT_FILENO), running(false), stopping(false), thread_count(0) {
+        for (auto& level : levels) {
+            level.store(LOG_LEVEL_INFO, std::memory_order_relaxed);
+        }
+    }
+
+    ~Logger() {
+        stop();
+    }
+
+    bool enabled(log_component_t component, log_level_t level) const {
+        return level <= levels[component].load(std::memory_order_relaxed);
+    }
+
+    void set_level(log_component_t component, log_level_t level) {
+        levels[component].store(level, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Applies a level spec such as "info,radio=debug,at=trace": a bare
+     * level sets every component, component=level sets one. Nothing changes
+     * if any part is invalid.
+     */
+    bool set_levels(const std::string& spec, std::string& error) {
+        log_level_t parsed[LOG_COMPONENT_COUNT];
+        for (size_t c = 0; c < LOG_COMPONENT_COUNT; ++c) {
+            parsed[c] = static_cast<log_level_t>(levels[c].load(std::memory_order_relaxed));
+        }
+
+        size_t start = 0;
+        while (start <= spec.size()) {
+            size_t end = spec.find(',', start);
+            if (end == std::string::npos) {
+                end = spec.size();
+            }
+            std::string item = trim_spaces(spec.substr(start, end - start));
+            start = end + 1;
+            if (item.empty()) {
+                continue;
+            }
+
+            size_t eq = item.find('=');
+            log_level_t level;
+            if (!parse_level(trim_spaces(eq == std::string::npos ? item : item.substr(eq + 1)), level)) {
+                error = "Unknown log level in '" + item + "'";
+                return false;
+            }
+            if (eq == std::string::npos) {
+                for (auto& p : parsed) {
+                    p = level;
+                }
+                continue;
+            }
+            log_component_t component;
+            if (!parse_component(trim_spaces(item.substr(0, eq)), component)) {
+                error = "Unknown log component in '" + item + "'";
+                return false;
+            }
+            parsed[component] = level;
+        }
+
+        for (size_t c = 0; c < LOG_COMPONENT_COUNT; ++c) {
+            levels[c].store(parsed[c], std::memory_order_relaxed);
+        }
+        return true;
+    }
+
+    // Current levels in the form accepted by set_levels
+    std::string levels_spec() const {
+        std::string spec;
+        for (size_t c = 0; c < LOG_COMPONENT_COUNT; ++c) {
+            if (!spec.empty()) {
+                spec += ",";
+            }
+            spec += log_component_name(static_cast<log_component_t>(c));
+            spec += "=";
+            spec += log_level_name(static_cast<log_level_t>(levels[c].load(std::memory_order_relaxed)));
+        }
+        return spec;
+    }
+
+    // Starts the writer thread; records pushed before this are kept
+    void start(int output_fd = STDOUT_FILENO) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (running) {
+            return;
+        }
+        fd = output_fd;
+        fflush(stdout);     // earlier printf output goes first
+        stopping = false;
+        running = true;
+        writer = std::thread(&Logger::run, this);
+    }
+
+    // Writes everything still queued and stops the writer thread
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!running) {
+                return;
+            }
+            stopping = true;
+        }
+        wake.notify_one();
+        writer.join();
+        std::lock_guard<std::mutex> lock(mutex);
+        running = false;
+    }
+
+    void push(const char* record, uint32_t size) {
+        if (!local().push(record, size)) {
+            return;
+        }
+        // Without a writer thread (before start or after stop) write right away
+        if (!writer_active.load(std::memory_order_acquire)) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!running) {
+                fflush(stdout);
+                std::string out;
+                drain(out);
+                write_all(out);
+            }
+        }
+    }
+
+private:
+    LogRing& local() {
+        thread_local LogRing* ring = nullptr;
+        if (!ring) {
+            std::lock_guard<std::mutex> lock(rings_mutex);
+            rings.push_back(std::unique_ptr<LogRing>(new LogRing(thread_count++)));
+            ring = rings.back().get();
+        }
+        return *ring;
+    }
+
+    void run() {
+        writer_active.store(true, std::memory_order_release);
+        std::string out;
+        while (true) {
+            out.clear();
+            size_t count = drain(out);
+            write_all(out);
+            if (count > 0) {
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(mutex);
+            if (stopping) {
+                break;
+            }
+            wake.wait_for(lock, std::chrono::milliseconds(LOG_FLUSH_MS));
+        }
+        writer_active.store(false, std::memory_order_release);
+
+        // Anything pushed while the flag was turning off
+        out.clear();
+        drain(out);
+        write_all(out);
+    }
+
+    // Formats every queued record into out, oldest first across all threads
+    size_t drain(std::string& out) {
+        std::vector<LogRing*> snapshot;
+        {
+            std::lock_guard<std::mutex> lock(rings_mutex);
+            for (const auto& ring : rings) {
+                snapshot.push_back(ring.get());
+            }
+        }
+
+        std::string batch;
+        std::vector<LogLine> lines;
+        for (LogRing* ring : snapshot) {
+            ring->drain([&](const char* record) {
+                LogRecordHeader header;
+                memcpy(&header, record, sizeof(header));
+                size_t offset = batch.size();
+                format(record, ring->thread, batch);
+                lines.push_back({header.time_ns, offset, batch.size() - offset});
+            });
+
+            uint64_t dropped = ring->dropped.load(std::memory_order_relaxed);
+            if (dropped > ring->dropped_reported) {
+                uint64_t lost = dropped - ring->dropped_reported;
+                ring->dropped_reported = dropped;
+                metrics_count(METRIC_LOG_DROPPED, lost);
+                int64_t now = now_ns();
+                size_t offset = batch.size();
+                format_prefix(batch, now, LOG_LEVEL_WARN, LOG_CORE, ring->thread, "log_records_dropped");
+                batch += ",\"count\":" + std::to_string(lost) + "}\n";
+                lines.push_back({now, offset, batch.size() - offset});
+            }
+        }
+
+        // Each ring is already in order; interleave them by timestamp
+        std::stable_sort(lines.begin(), lines.end(),
+                         [](const LogLine& a, const LogLine& b) { return a.time_ns < b.time_ns; });
+        for (const LogLine& line : lines) {
+            out.append(batch, line.offset, line.length);
+        }
+        return lines.size();
+    }
+
+    static void format_prefix(std::string& out, int64_t time_ns, log_level_t level, log_component_t component,
+                              unsigned thread, const char* event) {
+        time_t seconds = static_cast<time_t>(time_ns / 1000000000);
+        struct tm utc;
+        gmtime_r(&seconds, &utc);
+        char stamp[64];
+        size_t n = strftime(stamp, sizeof(stamp), "%Y-%m-%dT%H:%M:%S", &utc);
+        snprintf(stamp + n, sizeof(stamp) - n, ".%06dZ", static_cast<int>((time_ns % 1000000000) / 1000));
+
+        out += "{\"ts\":\"";
+        out += stamp;
+        out += "\",\"level\":\"";
+        out += log_level_name(level);
+        out += "\",\"component\":\"";
+        out += log_component_name(component);
+        out += "\",\"thread\":";
+        out += std::to_string(thread);
+        out += ",\"event\":\"";
+        log_json_escape(out, event);
+        out += "\"";
+    }
+
+    static void format(const char* record, unsigned thread, std::string& out) {
+        static const char digits[] = "0123456789ABCDEF";
+        LogRecordHeader header;
+        memcpy(&header, record, sizeof(header));
+        format_prefix(out, header.time_ns, static_cast<log_level_t>(header.level),
+                      static_cast<log_component_t>(header.component), thread, header.event);
+
+        size_t offset = sizeof(header);
+        for (unsigned i = 0; i < header.field_count; ++i) {
+            LogFieldHeader field;
+            memcpy(&field, record + offset, sizeof(field));
+            const char* value = record + offset + sizeof(field);
+            offset += sizeof(field) + log_align(field.length);
+
+            out += ",\"";
+            log_json_escape(out, field.key);
+            out += "\":";
+            uint64_t raw = 0;
+            if (field.length == sizeof(raw)) {
+                memcpy(&raw, value, sizeof(raw));
+            }
+            char number[32];
+            switch (field.type) {
+            case LOG_FIELD_UINT:
+                out += std::to_string(raw);
+                break;
+            case LOG_FIELD_INT:
+                out += std::to_string(static_cast<int64_t>(raw));
+                break;
+            case LOG_FIELD_DOUBLE: {
+                double d;
+                memcpy(&d, &raw, sizeof(d));
+                snprintf(number, sizeof(number), "%.9g", d);
+                out += number;
+                break;
+            }
+            case LOG_FIELD_BOOL:
+                out += raw ? "true" : "false";
+                break;
+            case LOG_FIELD_STRING:
+                out += "\"";
+                log_json_escape(out, std::string_view(value, field.length));
+                out += "\"";
+                break;
+            case LOG_FIELD_HEX:
+                out += "\"";
+                for (uint32_t b = 0; b < field.length; ++b) {
+                    unsigned char u = static_cast<unsigned char>(value[b]);
+                    out += digits[u >> 4];
+                    out += digits[u & 0xF];
+                }
+                out += "\"";
+                break;
+            default:
+                out += "null";
+                break;
+            }
+        }
+        if (header.truncated) {
+            out += ",\"truncated\":true";
+        }
+        out += "}\n";
+    }
+
+    void write_all(const std::string& out) {
+        size_t written = 0;
+        while (written < out.size()) {
+            ssize_t n = write(fd, out.data() + written, out.size() - written);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                return;
+            }
+            written += static_cast<size_t>(n);
+        }
+    }
+
+    static int64_t now_ns() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+    static std::string trim_spaces(const std::string& s) {
+        size_t start = s.find_first_not_of(" \t");
+        if (start == std::string::npos) {
+            return "";
+        }
+        return s.substr(start, s.find_last_not_of(" \t") - start + 1);
+    }
+
+    static bool parse_level(const std::string& name, log_level_t& level) {
+        for (size_t l = 0; l < LOG_LEVEL_COUNT; ++l) {
+            if (name == log_level_name(static_cast<log_level_t>(l))) {
+                level = static_cast<log_level_t>(l);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    static bool parse_component(const std::string& name, log_component_t& component) {
+        for (size_t c = 0; c < LOG_COMPONENT_COUNT; ++c) {
+            if (name == log_component_name(static_cast<log_component_t>(c))) {
+                component = static_cast<log_component_t>(c);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    std::atomic<uint8_t> levels[LOG_COMPONENT_COUNT];
+    int fd;
+
+    std::mutex mutex;                   // writer state, and the inline fallback
+    std::condition_variable wake;
+    std::thread writer;
+    bool running;
+    bool stopping;
+    std::atomic<bool> writer_active{false};
+
+    std::mutex rings_mutex;
+    std::vector<std::unique_ptr<LogRing>> rings;
+    unsigned thread_count;
+
+    friend class LogEvent;
+};
+
+inline Logger& logger() {
+    static Logger instance;
+    return instance;
+}
+
+/**
+ * @brief One log record being built on the caller's stack.
+ *
+ *     log_debug(LOG_RADIO, "transmit_start").u("job", id).s("device", path);
+ *
+ * Fields are copied as raw bytes and the record is queued when the
+ * statement ends. If the component's level is below the record's, every
+ * call is a no-op. Keys must be string literals.
+ */
+class LogEvent {
+public:
+    LogEvent(log_component_t component, log_level_t level, const char* event)
+        : active(logger().enabled(component, level)), used(sizeof(LogRecordHeader)) {
+        if (!active) {
+            return;
+        }
+        header.size = 0;
+        header.level = static_cast<uint8_t>(level);
+        header.component = static_cast<uint8_t>(component);
+        header.truncated = 0;
+        header.field_count = 0;
+        header.time_ns = Logger::now_ns();
+        header.event = event;
+    }
+
+    LogEvent(const LogEvent&) = delete;
+    LogEvent& operator=(const LogEvent&) = delete;
+
+    ~LogEvent() {
+        if (!active) {
+            return;
+        }
+        header.size = static_cast<uint32_t>(used);
+        memcpy(record, &header, sizeof(header));
+        logger().push(record, header.size);
+    }
+
+    LogEvent& u(const char* key, uint64_t value) {
+        return number(key, LOG_FIELD_UINT, &value);
+    }
+
+    LogEvent& i(const char* key, int64_t value) {
+        return number(key, LOG_FIELD_INT, &value);
+    }
+
+    LogEvent& f(const char* key, double value) {
+        return number(key, LOG_FIELD_DOUBLE, &value);
+    }
+
+    LogEvent& b(const char* key, bool value) {
+        uint64_t raw = value ? 1 : 0;
+        return number(key, LOG_FIELD_BOOL, &raw);
+    }
+
+    LogEvent& s(const char* key, std::string_view value) {
+        return bytes(key, LOG_FIELD_STRING, value.data(), value.size());
+    }
+
+    LogEvent& hex(const char* key, const void* data, size_t length) {
+        return bytes(key, LOG_FIELD_HEX, data, length);
+    }
+
+private:
+    LogEvent& number(const char* key, log_field_t type, const void* value) {
+        return bytes(key, type, value, sizeof(uint64_t));
+    }
+
+    LogEvent& bytes(const char* key, log_field_t type, const void* data, size_t length) {
+        if (!active) {
+            return *this;
+        }
+        size_t room = LOG_MAX_RECORD - used;
+        if (header.field_count == UINT8_MAX || room < sizeof(LogFieldHeader) + sizeof(uint64_t)) {
+            header.truncated = 1;
+            return *this;
+        }
+        if (length > room - sizeof(LogFieldHeader)) {
+            length = (room - sizeof(LogFieldHeader)) & ~static_cast<size_t>(7);
+            header.truncated = 1;
+        }
+
+        LogFieldHeader field;
+        field.key = key;
+        field.type = type;
+        field.length = static_cast<uint32_t>(length);
+        memcpy(record + used, &field, sizeof(field));
+        memcpy(record + used + sizeof(field), data, length);
+        used += sizeof(field) + log_align(length);
+        header.field_count++;
+        return *this;
+    }
+
+    bool active;
+    size_t used;
+    LogRecordHeader header;
+    alignas(8) char record[LOG_MAX_RECORD];
+};
+
+inline LogEvent log_error(log_component_t component, const char* event) {
+    return LogEvent(component, LOG_LEVEL_ERROR, event);
+}
+
+inline LogEvent log_warn(log_component_t component, const char* event) {
+    return LogEvent(component, LOG_LEVEL_WARN, event);
+}
+
+inline LogEvent log_info(log_component_t component, const char* event) {
+    return LogEvent(component, LOG_LEVEL_INFO, event);
+}
+
+inline LogEvent log_debug(log_component_t component, const char* event) {
+    return LogEvent(component, LOG_LEVEL_DEBUG, event);
+}
+
+inline LogEvent log_trace(log_component_t component, const char* event) {
+    return LogEvent(component, LOG_LEVEL_TRACE, event);
+}
+
+inline bool log_enabled(log_component_t component, log_level_t level) {
+    return logger().enabled(component, level);
+}
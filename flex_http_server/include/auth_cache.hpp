@@ -0,0 +1,207 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <mutex>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <cstdint>
+#include <sys/stat.h>
+
+// Entries per cache set; a full set evicts its oldest entry
+#define AUTH_CACHE_WAYS 4
+
+inline uint64_t siphash_rotl(uint64_t x, int b) {
+    return (x << b) | (x >> (64 - b));
+}
+
+/**
+ * @brief SipHash-2-4 of data under a 128-bit key.
+ */
+inline uint64_t siphash24(const uint64_t key[2], const void* data, size_t len) {
+    const unsigned char* in = static_cast<const unsigned char*>(data);
+    uint64_t v0 = 0x736f6d6570736575ULL ^ key[0];
+    uint64_t v1 = 0x646f72616e646f6dULL ^ key[1];
+    uint64_t v2 = 0x6c7967656e657261ULL ^ key[0];
+    uint64_t v3 = 0x7465646279746573ULL ^ key[1];
+
+    auto round = [&] {
+        v0 += v1; v1 = siphash_rotl(v1, 13); v1 ^= v0; v0 = siphash_rotl(v0, 32);
+        v2 += v3; v3 = siphash_rotl(v3, 16); v3 ^= v2;
+        v0 += v3; v3 = siphash_rotl(v3, 21); v3 ^= v0;
+        v2 += v1; v1 = siphash_rotl(v1, 17); v1 ^= v2; v2 = siphash_rotl(v2, 32);
+    };
+
+    size_t blocks = len / 8;
+    for (size_t i = 0; i < blocks; ++i) {
+        uint64_t m = 0;
+        for (int b = 0; b < 8; ++b) {
+            m |= static_cast<uint64_t>(in[i * 8 + b]) << (8 * b);
+        }
+        v3 ^= m;
+        round();
+        round();
+        v0 ^= m;
+    }
+
+    uint64_t last = static_cast<uint64_t>(len & 0xFF) << 56;
+    for (size_t b = 0; b < (len & 7); ++b) {
+        last |= static_cast<uint64_t>(in[blocks * 8 + b]) << (8 * b);
+    }
+    v3 ^= last;
+    round();
+    round();
+    v0 ^= last;
+
+    v2 ^= 0xFF;
+    round();
+    round();
+    round();
+    round();
+    return v0 ^ v1 ^ v2 ^ v3;
+}
+
+/**
+ * @brief Bounded cache of Authorization headers that passed verification.
+ *
+ * Checking a crypt() hash costs milliseconds per request, so successful
+ * logins are remembered for a limited time. Only a 128-bit SipHash of the
+ * header, under a random key generated at startup, is stored; the header
+ * and password never are. The table is set-associative with a fixed size,
+ * so lookups and inserts never allocate. clear() must be called whenever
+ * the password file changes. Each clear() starts a new generation: a login
+ * checked against the old passwords carries the generation read together
+ * with them, and insert() drops it if a clear() happened in between.
+ */
+class AuthCache {
+public:
+    AuthCache(size_t capacity, uint32_t ttl_seconds) : ttl(std::chrono::seconds(ttl_seconds)), current_generation(0) {
+        std::random_device rd;
+        for (int i = 0; i < 4; ++i) {
+            key[i / 2][i % 2] = (static_cast<uint64_t>(rd()) << 32) | rd();
+        }
+
+        // Round up to a power of two number of sets
+        size_t sets = 1;
+        while (sets * AUTH_CACHE_WAYS < capacity) {
+            sets <<= 1;
+        }
+        set_mask = sets - 1;
+        entries.resize(capacity > 0 ? sets * AUTH_CACHE_WAYS : 0);
+    }
+
+    bool enabled() const {
+        return !entries.empty() && ttl.count() > 0;
+    }
+
+    bool contains(std::string_view auth_header) {
+        if (!enabled()) {
+            return false;
+        }
+        Digest d = digest(auth_header);
+        auto now = std::chrono::steady_clock::now();
+
+        std::lock_guard<std::mutex> lock(mutex);
+        Entry* set = &entries[(d.lo & set_mask) * AUTH_CACHE_WAYS];
+        for (int i = 0; i < AUTH_CACHE_WAYS; ++i) {
+            if (set[i].hi == d.hi && set[i].lo == d.lo && set[i].expires > now) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Read together with the credentials the header will be verified against
+    uint64_t generation() const {
+        return current_generation.load(std::memory_order_acquire);
+    }
+
+    void insert(std::string_view auth_header, uint64_t generation) {
+        if (!enabled()) {
+            return;
+        }
+        Digest d = digest(auth_header);
+        auto now = std::chrono::steady_clock::now();
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (generation != current_generation.load(std::memory_order_relaxed)) {
+            return;     // verified against credentials that have since been replaced
+        }
+        Entry* set = &entries[(d.lo & set_mask) * AUTH_CACHE_WAYS];
+        Entry* victim = &set[0];
+        for (int i = 0; i < AUTH_CACHE_WAYS; ++i) {
+            if (set[i].hi == d.hi && set[i].lo == d.lo) {
+                victim = &set[i];
+                break;
+            }
+            if (set[i].expires < victim->expires) {
+                victim = &set[i];
+            }
+        }
+        victim->hi = d.hi;
+        victim->lo = d.lo;
+        victim->expires = now + ttl;
+    }
+
+    void clear() {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::fill(entries.begin(), entries.end(), Entry());
+        current_generation.fetch_add(1, std::memory_order_release);
+    }
+
+private:
+    struct Digest {
+        uint64_t hi;
+        uint64_t lo;
+    };
+
+    struct Entry {
+        uint64_t hi = 0;
+        uint64_t lo = 0;
+        std::chrono::steady_clock::time_point expires;
+    };
+
+    Digest digest(std::string_view data) const {
+        return Digest{siphash24(key[0], data.data(), data.size()),
+                      siphash24(key[1], data.data(), data.size())};
+    }
+
+    uint64_t key[2][2];
+    std::chrono::seconds ttl;
+    size_t set_mask;
+    std::vector<Entry> entries;
+    std::atomic<uint64_t> current_generation;    // changed only with mutex held
+    std::mutex mutex;
+};
+
+// Identity of the password file, used to notice edits and replacements
+struct FileStamp {
+    dev_t dev = 0;
+    ino_t ino = 0;
+    off_t size = 0;
+    struct timespec mtime = {0, 0};
+};
+
+/**
+ * @brief Refreshes stamp from the file at path.
+ * Returns true if the file differs from the previous stamp (including
+ * appearing or disappearing).
+ */
+inline bool file_stamp_changed(const std::string& path, FileStamp& stamp) {
+    struct stat st;
+    FileStamp current;
+    if (stat(path.c_str(), &st) == 0) {
+        current.dev = st.st_dev;
+        current.ino = st.st_ino;
+        current.size = st.st_size;
+        current.mtime = st.st_mtim;
+    }
+
+    bool changed = current.dev != stamp.dev || current.ino != stamp.ino || current.size != stamp.size ||
+                   current.mtime.tv_sec != stamp.mtime.tv_sec || current.mtime.tv_nsec != stamp.mtime.tv_nsec;
+    stamp = current;
+    return changed;
+}
@@ -0,0 +1,115 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include "priority_lanes.hpp"
+
+/*
+ * Binary submission protocol
+ *
+ * Every page is one frame: a fixed header followed by the UTF-8 message.
+ * All integers are big-endian (network byte order).
+ *
+ *   offset  size  field
+ *        0     2  magic      BINARY_MAGIC
+ *        2     1  priority   0 = PRIORITY_DEFAULT, else PRIORITY_* + 1
+ *        3     1  flags      BINARY_FLAG_*
+ *        4     4  seq        chosen by the client, echoed in every ack
+ *        8     8  capcode
+ *       16     8  frequency  Hz, 0 = DEFAULT_FREQUENCY
+ *       24     4  length     message bytes that follow
+ *
+ * The priority byte was reserved before priorities existed and older clients
+ * send 0 there, so 0 keeps meaning the default priority and the levels start
+ * at 1.
+ *
+ * Clients may write any number of frames back to back without waiting.
+ * The server answers every frame with an ack as soon as it has been queued
+ * or rejected, and once more after transmission when the frame asked for
+ * it. Acks are a fixed 16 bytes:
+ *
+ *        0     2  magic      BINARY_MAGIC
+ *        2     1  type       binary_ack_t
+ *        3     1  status     binary_status_t (why a frame was rejected)
+ *        4     4  seq
+ *        8     8  job id     0 when rejected; seconds to wait when rate limited or busy
+ */
+
+#define BINARY_MAGIC 0x464C
+#define BINARY_HEADER_SIZE 28
+#define BINARY_ACK_SIZE 16
+
+// Longest message accepted in one frame
+#define BINARY_MAX_PAYLOAD 4096
+
+// Report the transmission result with a second ack
+#define BINARY_FLAG_REPORT_RESULT 0x01
+#define BINARY_FLAGS_KNOWN BINARY_FLAG_REPORT_RESULT
+
+typedef enum {
+    BINARY_ACK_QUEUED = 1,
+    BINARY_ACK_REJECTED = 2,
+    BINARY_ACK_SENT = 3,
+    BINARY_ACK_FAILED = 4
+} binary_ack_t;
+
+typedef enum {
+    BINARY_STATUS_OK = 0,
+    BINARY_STATUS_INVALID_CAPCODE = 1,
+    BINARY_STATUS_INVALID_FREQUENCY = 2,
+    BINARY_STATUS_EMPTY_MESSAGE = 3,
+    BINARY_STATUS_TOO_LONG = 4,
+    BINARY_STATUS_UNKNOWN_FLAGS = 5,
+    BINARY_STATUS_INVALID_PRIORITY = 6,
+    BINARY_STATUS_RATE_LIMITED = 7,
+    BINARY_STATUS_BUSY = 8,
+    BINARY_STATUS_LOG_FAILED = 9     // the page could not be written to the page log
+} binary_status_t;
+
+struct BinaryFrameHeader {
+    unsigned priority;  // PRIORITY_*, decoded from the wire value
+    uint8_t flags;
+    uint32_t seq;
+    uint64_t capcode;
+    uint64_t frequency;
+    uint32_t length;
+};
+
+inline uint64_t binary_get(const unsigned char* p, size_t bytes) {
+    uint64_t value = 0;
+    for (size_t i = 0; i < bytes; ++i) {
+        value = (value << 8) | p[i];
+    }
+    return value;
+}
+
+inline void binary_put(std::string& out, uint64_t value, size_t bytes) {
+    for (size_t i = bytes; i-- > 0; ) {
+        out.push_back(static_cast<char>((value >> (i * 8)) & 0xFF));
+    }
+}
+
+// Decodes a header from at least BINARY_HEADER_SIZE bytes; false on a bad magic
+inline bool binary_read_header(const char* data, BinaryFrameHeader& header) {
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(data);
+    if (binary_get(p, 2) != BINARY_MAGIC) {
+        return false;
+    }
+    // Values past PRIORITY_EMERGENCY + 1 decode to an invalid level
+    header.priority = p[2] == 0 ? PRIORITY_DEFAULT : p[2] - 1u;
+    header.flags = p[3];
+    header.seq = static_cast<uint32_t>(binary_get(p + 4, 4));
+    header.capcode = binary_get(p + 8, 8);
+    header.frequency = binary_get(p + 16, 8);
+    header.length = static_cast<uint32_t>(binary_get(p + 24, 4));
+    return true;
+}
+
+inline void binary_write_ack(std::string& out, binary_ack_t type, binary_status_t status,
+                             uint32_t seq, uint64_t job_id) {
+    binary_put(out, BINARY_MAGIC, 2);
+    out.push_back(static_cast<char>(type));
+    out.push_back(static_cast<char>(status));
+    binary_put(out, seq, 4);
+    binary_put(out, job_id, 8);
+}
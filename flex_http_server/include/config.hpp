@@ -3,11 +3,15 @@
 #include <fstream>
 #include <iostream>
 #include <cstdlib>
+#include <atomic>
+#include <memory>
+#include <vector>
 
 struct Config {
     std::string BIND_ADDRESS;
     uint32_t SERIAL_LISTEN_PORT;
     uint32_t HTTP_LISTEN_PORT;
+    uint32_t BINARY_LISTEN_PORT;
     std::string HTTP_AUTH_CREDENTIALS;
 
     // FLEX-specific configuration (updated from TTGO)
@@ -15,6 +19,74 @@ struct Config {
     uint32_t FLEX_BAUDRATE;
     int FLEX_POWER;
     uint64_t DEFAULT_FREQUENCY;
+
+    // HTTP keep-alive
+    uint32_t HTTP_KEEPALIVE_TIMEOUT;
+    uint32_t HTTP_KEEPALIVE_MAX_REQUESTS;
+
+    // HTTP credential cache
+    uint32_t HTTP_AUTH_CACHE_TTL;
+    uint32_t HTTP_AUTH_CACHE_SIZE;
+
+    // HTTP API tokens
+    std::string HTTP_API_TOKENS;
+
+    // Threading
+    uint32_t HTTP_WORKER_THREADS;
+    uint32_t ENCODER_THREADS;
+
+    // Listener tuning
+    uint32_t LISTEN_BACKLOG;
+    uint32_t LISTEN_REUSEPORT;
+    uint32_t LISTEN_DEFER_ACCEPT;
+    uint32_t LISTEN_FASTOPEN;
+
+    // Local (unix domain socket) listeners
+    std::string HTTP_UNIX_SOCKET;
+    std::string SERIAL_UNIX_SOCKET;
+    uint32_t UNIX_SOCKET_MODE;
+    std::string UNIX_SOCKET_ALLOW;
+
+    // Slow and abusive client protection
+    uint32_t HTTP_HEADER_TIMEOUT;
+    uint32_t HTTP_BODY_TIMEOUT;
+    uint32_t HTTP_MAX_HEADER_SIZE;
+    uint32_t HTTP_MAX_BODY_SIZE;
+    uint32_t MAX_CONNECTIONS_PER_IP;
+
+    // Transmit scheduling
+    uint32_t PRIORITY_AGING_SECONDS;
+    uint32_t DEDUP_WINDOW_SECONDS;
+
+    // Rate limiting
+    uint32_t RATE_LIMIT_PER_USER;
+    uint32_t RATE_LIMIT_PER_IP;
+    uint32_t RATE_LIMIT_PER_CAPCODE;
+    uint32_t RATE_LIMIT_BURST;
+
+    // Admission control
+    uint32_t FLEX_BITRATE;
+    uint32_t TRANSMIT_OVERHEAD_MS;
+    uint32_t QUEUE_SLA_SECONDS;
+    uint32_t MAX_QUEUED_PAGES;
+
+    // Logging
+    std::string LOG_LEVELS;
+
+    // Tracing
+    std::string TRACE_FILE;
+
+    // Health checks
+    uint32_t READY_QUEUE_THRESHOLD;
+
+    // Page log
+    std::string WAL_FILE;
+
+    // Shutdown
+    uint32_t SHUTDOWN_DRAIN_SECONDS;
+
+    // Listener handoff
+    std::string HANDOFF_SOCKET;
 };
 
 // Helper function to trim whitespace and trailing commas
@@ -38,6 +110,7 @@ inline bool load_config(const std::string& filename, Config& config) {
     config.BIND_ADDRESS = "127.0.0.1";
     config.SERIAL_LISTEN_PORT = 16175;
     config.HTTP_LISTEN_PORT = 16180;
+    config.BINARY_LISTEN_PORT = 0;
     config.HTTP_AUTH_CREDENTIALS = "passwords";
 
     // FLEX defaults (updated from TTGO)
@@ -46,6 +119,74 @@ inline bool load_config(const std::string& filename, Config& config) {
     config.FLEX_POWER = 2;                // Changed from TTGO_POWER, range 2-20
     config.DEFAULT_FREQUENCY = 916000000; // 916.0 MHz
 
+    // HTTP keep-alive
+    config.HTTP_KEEPALIVE_TIMEOUT = 5;
+    config.HTTP_KEEPALIVE_MAX_REQUESTS = 100;
+
+    // HTTP credential cache
+    config.HTTP_AUTH_CACHE_TTL = 300;
+    config.HTTP_AUTH_CACHE_SIZE = 1024;
+
+    // HTTP API tokens
+    config.HTTP_API_TOKENS = "tokens";
+
+    // Threading
+    config.HTTP_WORKER_THREADS = 2;
+    config.ENCODER_THREADS = 1;
+
+    // Listener tuning
+    config.LISTEN_BACKLOG = 128;
+    config.LISTEN_REUSEPORT = 0;
+    config.LISTEN_DEFER_ACCEPT = 0;
+    config.LISTEN_FASTOPEN = 0;
+
+    // Local (unix domain socket) listeners
+    config.HTTP_UNIX_SOCKET = "";
+    config.SERIAL_UNIX_SOCKET = "";
+    config.UNIX_SOCKET_MODE = 0660;
+    config.UNIX_SOCKET_ALLOW = "";
+
+    // Slow and abusive client protection
+    config.HTTP_HEADER_TIMEOUT = 10;
+    config.HTTP_BODY_TIMEOUT = 30;
+    config.HTTP_MAX_HEADER_SIZE = 8192;
+    config.HTTP_MAX_BODY_SIZE = 1048576;
+    config.MAX_CONNECTIONS_PER_IP = 32;
+
+    // Transmit scheduling
+    config.PRIORITY_AGING_SECONDS = 60;
+    config.DEDUP_WINDOW_SECONDS = 60;
+
+    // Rate limiting
+    config.RATE_LIMIT_PER_USER = 60;
+    config.RATE_LIMIT_PER_IP = 60;
+    config.RATE_LIMIT_PER_CAPCODE = 12;
+    config.RATE_LIMIT_BURST = 20;
+
+    // Admission control
+    config.FLEX_BITRATE = 1600;
+    config.TRANSMIT_OVERHEAD_MS = 3000;
+    config.QUEUE_SLA_SECONDS = 300;
+    config.MAX_QUEUED_PAGES = 1000;
+
+    // Logging
+    config.LOG_LEVELS = "info";
+
+    // Tracing
+    config.TRACE_FILE = "";
+
+    // Health checks
+    config.READY_QUEUE_THRESHOLD = 100;
+
+    // Page log
+    config.WAL_FILE = "";
+
+    // Shutdown
+    config.SHUTDOWN_DRAIN_SECONDS = 20;
+
+    // Listener handoff
+    config.HANDOFF_SOCKET = "";
+
     std::string line;
     while (std::getline(file, line)) {
         // Skip comments and empty lines
@@ -67,6 +208,8 @@ inline bool load_config(const std::string& filename, Config& config) {
             config.SERIAL_LISTEN_PORT = std::stoul(value);
         } else if (key == "HTTP_LISTEN_PORT") {
             config.HTTP_LISTEN_PORT = std::stoul(value);
+        } else if (key == "BINARY_LISTEN_PORT") {
+            config.BINARY_LISTEN_PORT = std::stoul(value);
         } else if (key == "HTTP_AUTH_CREDENTIALS") {
             config.HTTP_AUTH_CREDENTIALS = value;
         } else if (key == "FLEX_DEVICE") {           // Updated from TTGO_DEVICE
@@ -77,6 +220,78 @@ inline bool load_config(const std::string& filename, Config& config) {
             config.FLEX_POWER = std::stoi(value);
         } else if (key == "DEFAULT_FREQUENCY") {
             config.DEFAULT_FREQUENCY = std::stoull(value);
+        } else if (key == "HTTP_KEEPALIVE_TIMEOUT") {
+            config.HTTP_KEEPALIVE_TIMEOUT = std::stoul(value);
+        } else if (key == "HTTP_KEEPALIVE_MAX_REQUESTS") {
+            config.HTTP_KEEPALIVE_MAX_REQUESTS = std::stoul(value);
+        } else if (key == "HTTP_AUTH_CACHE_TTL") {
+            config.HTTP_AUTH_CACHE_TTL = std::stoul(value);
+        } else if (key == "HTTP_AUTH_CACHE_SIZE") {
+            config.HTTP_AUTH_CACHE_SIZE = std::stoul(value);
+        } else if (key == "HTTP_API_TOKENS") {
+            config.HTTP_API_TOKENS = value;
+        } else if (key == "HTTP_WORKER_THREADS") {
+            config.HTTP_WORKER_THREADS = std::stoul(value);
+        } else if (key == "ENCODER_THREADS") {
+            config.ENCODER_THREADS = std::stoul(value);
+        } else if (key == "LISTEN_BACKLOG") {
+            config.LISTEN_BACKLOG = std::stoul(value);
+        } else if (key == "LISTEN_REUSEPORT") {
+            config.LISTEN_REUSEPORT = std::stoul(value);
+        } else if (key == "LISTEN_DEFER_ACCEPT") {
+            config.LISTEN_DEFER_ACCEPT = std::stoul(value);
+        } else if (key == "LISTEN_FASTOPEN") {
+            config.LISTEN_FASTOPEN = std::stoul(value);
+        } else if (key == "HTTP_UNIX_SOCKET") {
+            config.HTTP_UNIX_SOCKET = value;
+        } else if (key == "SERIAL_UNIX_SOCKET") {
+            config.SERIAL_UNIX_SOCKET = value;
+        } else if (key == "UNIX_SOCKET_MODE") {
+            config.UNIX_SOCKET_MODE = std::stoul(value, nullptr, 8);
+        } else if (key == "UNIX_SOCKET_ALLOW") {
+            config.UNIX_SOCKET_ALLOW = value;
+        } else if (key == "HTTP_HEADER_TIMEOUT") {
+            config.HTTP_HEADER_TIMEOUT = std::stoul(value);
+        } else if (key == "HTTP_BODY_TIMEOUT") {
+            config.HTTP_BODY_TIMEOUT = std::stoul(value);
+        } else if (key == "HTTP_MAX_HEADER_SIZE") {
+            config.HTTP_MAX_HEADER_SIZE = std::stoul(value);
+        } else if (key == "HTTP_MAX_BODY_SIZE") {
+            config.HTTP_MAX_BODY_SIZE = std::stoul(value);
+        } else if (key == "MAX_CONNECTIONS_PER_IP") {
+            config.MAX_CONNECTIONS_PER_IP = std::stoul(value);
+        } else if (key == "PRIORITY_AGING_SECONDS") {
+            config.PRIORITY_AGING_SECONDS = std::stoul(value);
+        } else if (key == "DEDUP_WINDOW_SECONDS") {
+            config.DEDUP_WINDOW_SECONDS = std::stoul(value);
+        } else if (key == "RATE_LIMIT_PER_USER") {
+            config.RATE_LIMIT_PER_USER = std::stoul(value);
+        } else if (key == "RATE_LIMIT_PER_IP") {
+            config.RATE_LIMIT_PER_IP = std::stoul(value);
+        } else if (key == "RATE_LIMIT_PER_CAPCODE") {
+            config.RATE_LIMIT_PER_CAPCODE = std::stoul(value);
+        } else if (key == "RATE_LIMIT_BURST") {
+            config.RATE_LIMIT_BURST = std::stoul(value);
+        } else if (key == "FLEX_BITRATE") {
+            config.FLEX_BITRATE = std::stoul(value);
+        } else if (key == "TRANSMIT_OVERHEAD_MS") {
+            config.TRANSMIT_OVERHEAD_MS = std::stoul(value);
+        } else if (key == "QUEUE_SLA_SECONDS") {
+            config.QUEUE_SLA_SECONDS = std::stoul(value);
+        } else if (key == "MAX_QUEUED_PAGES") {
+            config.MAX_QUEUED_PAGES = std::stoul(value);
+        } else if (key == "LOG_LEVELS") {
+            config.LOG_LEVELS = value;
+        } else if (key == "TRACE_FILE") {
+            config.TRACE_FILE = value;
+        } else if (key == "READY_QUEUE_THRESHOLD") {
+            config.READY_QUEUE_THRESHOLD = std::stoul(value);
+        } else if (key == "WAL_FILE") {
+            config.WAL_FILE = value;
+        } else if (key == "SHUTDOWN_DRAIN_SECONDS") {
+            config.SHUTDOWN_DRAIN_SECONDS = std::stoul(value);
+        } else if (key == "HANDOFF_SOCKET") {
+            config.HANDOFF_SOCKET = value;
         }
 
         // Support legacy TTGO_ prefixes for backward compatibility
@@ -91,3 +306,136 @@ inline bool load_config(const std::string& filename, Config& config) {
 
     return true;
 }
+
+// Checks settings that load_config accepts syntactically but the server
+// cannot run with; error says which
+inline bool validate_config(const Config& config, std::string& error) {
+    if (config.FLEX_POWER < 2 || config.FLEX_POWER > 20) {
+        error = "Invalid FLEX_POWER: " + std::to_string(config.FLEX_POWER) + " (must be 2-20)";
+        return false;
+    }
+    if (config.HTTP_KEEPALIVE_TIMEOUT < 1 || config.HTTP_KEEPALIVE_MAX_REQUESTS < 1) {
+        error = "Invalid HTTP keep-alive settings: HTTP_KEEPALIVE_TIMEOUT and "
+                "HTTP_KEEPALIVE_MAX_REQUESTS must be at least 1";
+        return false;
+    }
+    if (config.HTTP_WORKER_THREADS < 1 || config.ENCODER_THREADS < 1) {
+        error = "Invalid thread settings: HTTP_WORKER_THREADS and "
+                "ENCODER_THREADS must be at least 1";
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Copies the settings that take effect without a restart from loaded
+ * into config and returns the names of those that changed.
+ *
+ * These are read each time they are used (per page, per request or per
+ * connection). Everything else sizes or opens something at startup
+ * (listeners, threads, files, rate limits, admission) and keeps its
+ * startup value until the next restart.
+ */
+inline std::vector<std::string> config_apply_reloadable(Config& config, const Config& loaded) {
+    std::vector<std::string> changed;
+#define CONFIG_RELOAD(key) \
+    if (config.key != loaded.key) { \
+        config.key = loaded.key; \
+        changed.push_back(#key); \
+    }
+    CONFIG_RELOAD(FLEX_DEVICE)
+    CONFIG_RELOAD(FLEX_BAUDRATE)
+    CONFIG_RELOAD(FLEX_POWER)
+    CONFIG_RELOAD(DEFAULT_FREQUENCY)
+    CONFIG_RELOAD(HTTP_KEEPALIVE_TIMEOUT)
+    CONFIG_RELOAD(HTTP_KEEPALIVE_MAX_REQUESTS)
+    CONFIG_RELOAD(HTTP_HEADER_TIMEOUT)
+    CONFIG_RELOAD(HTTP_BODY_TIMEOUT)
+    CONFIG_RELOAD(HTTP_MAX_HEADER_SIZE)
+    CONFIG_RELOAD(HTTP_MAX_BODY_SIZE)
+    CONFIG_RELOAD(LOG_LEVELS)
+    CONFIG_RELOAD(READY_QUEUE_THRESHOLD)
+    CONFIG_RELOAD(SHUTDOWN_DRAIN_SECONDS)
+#undef CONFIG_RELOAD
+    return changed;
+}
+
+/**
+ * @brief Names the settings that differ between the running config and
+ * loaded but only take effect after a restart (everything not handled by
+ * config_apply_reloadable()).
+ */
+inline std::vector<std::string> config_restart_changes(const Config& config, const Config& loaded) {
+    std::vector<std::string> changed;
+#define CONFIG_RESTART(key) \
+    if (config.key != loaded.key) { \
+        changed.push_back(#key); \
+    }
+    CONFIG_RESTART(BIND_ADDRESS)
+    CONFIG_RESTART(SERIAL_LISTEN_PORT)
+    CONFIG_RESTART(HTTP_LISTEN_PORT)
+    CONFIG_RESTART(BINARY_LISTEN_PORT)
+    CONFIG_RESTART(HTTP_AUTH_CREDENTIALS)
+    CONFIG_RESTART(HTTP_AUTH_CACHE_TTL)
+    CONFIG_RESTART(HTTP_AUTH_CACHE_SIZE)
+    CONFIG_RESTART(HTTP_API_TOKENS)
+    CONFIG_RESTART(HTTP_WORKER_THREADS)
+    CONFIG_RESTART(ENCODER_THREADS)
+    CONFIG_RESTART(LISTEN_BACKLOG)
+    CONFIG_RESTART(LISTEN_REUSEPORT)
+    CONFIG_RESTART(LISTEN_DEFER_ACCEPT)
+    CONFIG_RESTART(LISTEN_FASTOPEN)
+    CONFIG_RESTART(HTTP_UNIX_SOCKET)
+    CONFIG_RESTART(SERIAL_UNIX_SOCKET)
+    CONFIG_RESTART(UNIX_SOCKET_MODE)
+    CONFIG_RESTART(UNIX_SOCKET_ALLOW)
+    CONFIG_RESTART(MAX_CONNECTIONS_PER_IP)
+    CONFIG_RESTART(PRIORITY_AGING_SECONDS)
+    CONFIG_RESTART(DEDUP_WINDOW_SECONDS)
+    CONFIG_RESTART(RATE_LIMIT_PER_USER)
+    CONFIG_RESTART(RATE_LIMIT_PER_IP)
+    CONFIG_RESTART(RATE_LIMIT_PER_CAPCODE)
+    CONFIG_RESTART(RATE_LIMIT_BURST)
+    CONFIG_RESTART(FLEX_BITRATE)
+    CONFIG_RESTART(TRANSMIT_OVERHEAD_MS)
+    CONFIG_RESTART(QUEUE_SLA_SECONDS)
+    CONFIG_RESTART(MAX_QUEUED_PAGES)
+    CONFIG_RESTART(TRACE_FILE)
+    CONFIG_RESTART(WAL_FILE)
+    CONFIG_RESTART(HANDOFF_SOCKET)
+#undef CONFIG_RESTART
+    return changed;
+}
+
+/**
+ * @brief The current settings, replaced as a whole when config.ini is
+ * reloaded.
+ *
+ * Readers take the snapshot with a single atomic load and never lock, so a
+ * reload never holds up a request or a transmission. Replaced snapshots are
+ * retired but not freed while the server runs, so a reader may keep using
+ * the one it loaded for as long as its work takes; a reload costs one
+ * Config. Only one thread (the main loop) publishes.
+ */
+class ConfigStore {
+public:
+    explicit ConfigStore(const Config& initial) : live(nullptr) {
+        publish(initial);
+    }
+
+    const Config& current() const {
+        return *live.load(std::memory_order_acquire);
+    }
+
+    void publish(const Config& next) {
+        snapshots.push_back(std::unique_ptr<const Config>(new Config(next)));
+        live.store(snapshots.back().get(), std::memory_order_release);
+    }
+
+    ConfigStore(const ConfigStore&) = delete;
+    ConfigStore& operator=(const ConfigStore&) = delete;
+
+private:
+    std::atomic<const Config*> live;
+    std::vector<std::unique_ptr<const Config>> snapshots;
+};
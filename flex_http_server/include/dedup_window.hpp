@@ -0,0 +1,125 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// What makes two pages the same transmission
+struct DedupKey {
+    uint64_t capcode;
+    uint64_t frequency;
+    size_t message_hash;
+
+    DedupKey(uint64_t capcode_, uint64_t frequency_, const std::string& message)
+        : capcode(capcode_), frequency(frequency_), message_hash(std::hash<std::string>()(message)) {}
+
+    bool operator==(const DedupKey& other) const {
+        return capcode == other.capcode && frequency == other.frequency &&
+               message_hash == other.message_hash;
+    }
+};
+
+struct DedupKeyHash {
+    size_t operator()(const DedupKey& key) const {
+        size_t h = key.message_hash;
+        h ^= std::hash<uint64_t>()(key.capcode) + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2);
+        h ^= std::hash<uint64_t>()(key.frequency) + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2);
+        return h;
+    }
+};
+
+/**
+ * @brief Hash set of recently seen pages with expiry on a timing wheel.
+ *
+ * Each entry remembers the second it was inserted in, and its key is also
+ * filed in the wheel slot for that second. Advancing the clock empties only
+ * the slots that have fallen out of the window, so expiry costs O(expired
+ * entries) rather than a scan of the whole set. The window is measured from
+ * the first sighting; duplicates do not extend it. Not thread-safe.
+ */
+template <typename V>
+class DedupWindow {
+public:
+    typedef std::chrono::steady_clock clock;
+
+    // window_seconds = 0 disables deduplication
+    explicit DedupWindow(uint32_t window_seconds = 0) {
+        set_window(window_seconds);
+    }
+
+    // Forgets everything seen so far
+    void set_window(uint32_t window_seconds) {
+        window = window_seconds;
+        entries.clear();
+        slots.assign(window_seconds ? window_seconds + 1 : 0, std::vector<DedupKey>());
+        current_tick = -1;
+    }
+
+    bool enabled() const {
+        return window > 0;
+    }
+
+    // Drops every entry older than the window
+    void expire(clock::time_point now) {
+        long long tick = tick_of(now);
+        if (current_tick < 0) {
+            current_tick = tick;
+            return;
+        }
+
+        long long n = (long long)slots.size();
+        long long first = (tick - current_tick > n) ? tick - n + 1 : current_tick + 1;
+        for (long long t = first; t <= tick; ++t) {
+            std::vector<DedupKey>& slot = slots[t % n];
+            for (const DedupKey& key : slot) {
+                auto it = entries.find(key);
+                if (it != entries.end() && it->second.tick <= t - n) {
+                    entries.erase(it);
+                }
+            }
+            slot.clear();
+        }
+        if (tick > current_tick) {
+            current_tick = tick;
+        }
+    }
+
+    // Returns the value stored for key, or nullptr; call expire() first
+    V* find(const DedupKey& key) {
+        auto it = entries.find(key);
+        return it == entries.end() ? nullptr : &it->second.value;
+    }
+
+    // Adds or replaces key, starting a new window for it
+    void insert(const DedupKey& key, V value, clock::time_point now) {
+        long long tick = tick_of(now);
+        entries[key] = Entry{std::move(value), tick};
+        slots[tick % (long long)slots.size()].push_back(key);
+    }
+
+    void erase(const DedupKey& key) {
+        entries.erase(key);
+    }
+
+    size_t size() const {
+        return entries.size();
+    }
+
+private:
+    struct Entry {
+        V value;
+        long long tick;
+    };
+
+    static long long tick_of(clock::time_point now) {
+        return std::chrono::duration_cast<std::chrono::seconds>(now.time_since_epoch()).count();
+    }
+
+    uint32_t window;
+    long long current_tick;
+    std::unordered_map<DedupKey, Entry, DedupKeyHash> entries;
+    std::vector<std::vector<DedupKey>> slots;
+};
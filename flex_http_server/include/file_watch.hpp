@@ -0,0 +1,68 @@
+#pragma once
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <cerrno>
+#include <string>
+#include <vector>
+
+// Directory events that may mean a watched file was written or replaced
+#define FILE_WATCH_EVENTS (IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE | IN_ATTRIB)
+
+/**
+ * @brief Tells the main loop when files it rereads may have changed.
+ *
+ * The directories holding the files are watched rather than the files, so
+ * an editor or deploy tool that renames a new file over the old one is
+ * noticed as well. An event only means "look again": the caller compares
+ * FileStamps to find out what actually changed. If inotify is unavailable
+ * descriptor() is -1 and the caller falls back to polling.
+ */
+class FileWatch {
+public:
+    FileWatch() : fd(-1) {}
+
+    ~FileWatch() {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+
+    FileWatch(const FileWatch&) = delete;
+    FileWatch& operator=(const FileWatch&) = delete;
+
+    // Watches the directory of every path; false if inotify cannot be used
+    bool watch(const std::vector<std::string>& paths) {
+        fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (fd < 0) {
+            return false;
+        }
+        for (const std::string& path : paths) {
+            size_t slash = path.rfind('/');
+            std::string dir = slash == std::string::npos ? "." : (slash == 0 ? "/" : path.substr(0, slash));
+            if (inotify_add_watch(fd, dir.c_str(), FILE_WATCH_EVENTS) < 0) {
+                close(fd);
+                fd = -1;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    int descriptor() const {
+        return fd;
+    }
+
+    // Consumes the pending events; true if there were any
+    bool drain() {
+        alignas(struct inotify_event) char buffer[4096];
+        bool any = false;
+        ssize_t n;
+        while ((n = read(fd, buffer, sizeof(buffer))) > 0 || (n < 0 && errno == EINTR)) {
+            any = any || n > 0;
+        }
+        return any;
+    }
+
+private:
+    int fd;
+};
@@ -4,17 +4,26 @@
 #include <termios.h>
 #include <unistd.h>
 #include <cstring>
-#include <iostream>
 #include <poll.h>
 #include <errno.h>
-#include <iomanip>
 #include <ctime>
+#include <chrono>
+#include "async_log.hpp"
+#include "metrics.hpp"
+#include "trace.hpp"
 
 struct FlexATConfig {
     double frequency;  // Frequency in MHz
     int power;         // TX power 2-20
 };
 
+// When each phase of a successful send ended
+struct FlexATTimings {
+    std::chrono::steady_clock::time_point configured;   // frequency and power set
+    std::chrono::steady_clock::time_point data_sent;    // frame handed to the device
+    std::chrono::steady_clock::time_point completed;    // device reported the transmission done
+};
+
 // AT Protocol constants
 #define AT_BUFFER_SIZE    1024
 #define AT_TIMEOUT_MS     8000
@@ -118,13 +127,11 @@ inline void flush_flex_at_buffers(int fd) {
 /**
  * @brief Send AT command with proper flushing.
  */
-inline int at_send_flex_command(int fd, const char *command, bool verbose_mode = false) {
-    if (verbose_mode) {
-        std::cout << "  Sending AT: " << std::string(command, strlen(command) - 2) << std::endl;
-    }
+inline int at_send_flex_command(int fd, const char *command) {
+    log_trace(LOG_AT, "at_send").s("command", std::string_view(command, strlen(command) - 2));
 
     if (write(fd, command, strlen(command)) < 0) {
-        perror("write");
+        log_error(LOG_AT, "write_failed").s("error", strerror(errno));
         return -1;
     }
     tcdrain(fd);
@@ -137,7 +144,7 @@ inline int at_send_flex_command(int fd, const char *command, bool verbose_mode =
  * @brief Read AT response with improved parsing and timeout handling.
  * Based on at_read_response from flex-fsk-tx.cpp
  */
-inline at_response_t at_read_flex_response(int fd, char *buffer, size_t buffer_size, bool verbose_mode = false) {
+inline at_response_t at_read_flex_response(int fd, char *buffer, size_t buffer_size) {
     char line_buffer[AT_BUFFER_SIZE];
     size_t line_pos = 0;
     int total_timeout = AT_TIMEOUT_MS;
@@ -154,7 +161,7 @@ inline at_response_t at_read_flex_response(int fd, char *buffer, size_t buffer_s
         int poll_result = poll(&pfd, 1, 50); // Shorter poll interval
 
         if (poll_result < 0) {
-            perror("poll");
+            log_error(LOG_AT, "poll_failed").s("error", strerror(errno));
             return AT_RESP_INVALID;
         }
 
@@ -173,7 +180,7 @@ inline at_response_t at_read_flex_response(int fd, char *buffer, size_t buffer_s
         ssize_t bytes_read = read(fd, &c, 1);
 
         if (bytes_read < 0) {
-            perror("read");
+            log_error(LOG_AT, "read_failed").s("error", strerror(errno));
             return AT_RESP_INVALID;
         }
 
@@ -199,9 +206,7 @@ inline at_response_t at_read_flex_response(int fd, char *buffer, size_t buffer_s
                 continue;
             }
 
-            if (verbose_mode) {
-                std::cout << "  Received AT: '" << line_buffer << "'" << std::endl;
-            }
+            log_trace(LOG_AT, "at_received").s("line", line_buffer);
 
             // Check for responses
             if (strcmp(line_buffer, "OK") == 0) {
@@ -220,15 +225,11 @@ inline at_response_t at_read_flex_response(int fd, char *buffer, size_t buffer_s
             }
             else if (strstr(line_buffer, "DEBUG:") != NULL) {
                 // Debug message from device
-                if (verbose_mode) {
-                    std::cout << "  Device debug: " << line_buffer << std::endl;
-                }
+                log_trace(LOG_AT, "device_debug").s("line", line_buffer);
             }
             else if (strstr(line_buffer, "AT READY") != NULL) {
                 // Device ready message
-                if (verbose_mode) {
-                    std::cout << "  Device ready: " << line_buffer << std::endl;
-                }
+                log_debug(LOG_AT, "device_ready").s("line", line_buffer);
             }
 
             // Reset line buffer
@@ -241,10 +242,7 @@ inline at_response_t at_read_flex_response(int fd, char *buffer, size_t buffer_s
         else if (c < 32 && c != '\r' && c != '\n') {
             // Non-printable character (except CR/LF) - reset line
             if (line_pos > 0) {
-                if (verbose_mode) {
-                    std::cout << "  Warning: Non-printable character 0x" << std::hex << (unsigned char)c
-                              << std::dec << " in response, resetting line" << std::endl;
-                }
+                log_debug(LOG_AT, "line_reset").u("byte", static_cast<unsigned char>(c));
                 line_pos = 0;
             }
         }
@@ -263,60 +261,52 @@ inline at_response_t at_read_flex_response(int fd, char *buffer, size_t buffer_s
 /**
  * @brief Send AT command and wait for response with enhanced retry logic.
  */
-inline int at_execute_flex_command(int fd, const char *command, char *response,
-                                   size_t response_size, bool verbose_mode = false) {
+inline int at_execute_flex_command(int fd, const char *command, char *response, size_t response_size) {
     int retries = AT_MAX_RETRIES;
+    std::string_view shown(command, strlen(command) - 2);
+    TraceSpan span("at_command", shown);
 
     while (retries-- > 0) {
         // Clear buffers before sending command
         flush_flex_at_buffers(fd);
 
-        if (at_send_flex_command(fd, command, verbose_mode) < 0) {
+        if (at_send_flex_command(fd, command) < 0) {
             return -1;
         }
 
-        at_response_t result = at_read_flex_response(fd, response, response_size, verbose_mode);
+        at_response_t result = at_read_flex_response(fd, response, response_size);
 
         switch (result) {
         case AT_RESP_OK:
             return 0;
         case AT_RESP_ERROR:
-            if (verbose_mode) {
-                std::cerr << "  AT command failed: " << std::string(command, strlen(command) - 2) << std::endl;
-            }
+            log_warn(LOG_AT, "command_failed").s("command", shown).i("retries_left", retries);
             if (retries > 0) {
-                if (verbose_mode) {
-                    std::cout << "  Retrying command (" << retries << " attempts left)..." << std::endl;
-                }
+                TraceSpan backoff("at_retry", shown);
+                metrics_count(METRIC_AT_RETRIES);
                 usleep(500000); // 500ms delay between retries
                 continue;
             }
             return -1;
         case AT_RESP_TIMEOUT:
-            if (verbose_mode) {
-                std::cerr << "  AT command timeout: " << std::string(command, strlen(command) - 2) << std::endl;
-            }
+            log_warn(LOG_AT, "command_timeout").s("command", shown).i("retries_left", retries);
             if (retries > 0) {
-                if (verbose_mode) {
-                    std::cout << "  Retrying command due to timeout (" << retries << " attempts left)..." << std::endl;
-                }
+                TraceSpan backoff("at_retry", shown);
+                metrics_count(METRIC_AT_RETRIES);
                 // Send AT command to reset device state
                 flush_flex_at_buffers(fd);
-                at_send_flex_command(fd, "AT\r\n", verbose_mode);
+                at_send_flex_command(fd, "AT\r\n");
                 usleep(200000);
-                at_read_flex_response(fd, response, response_size, verbose_mode);
+                at_read_flex_response(fd, response, response_size);
                 usleep(500000);
                 continue;
             }
             return -1;
         case AT_RESP_INVALID:
-            if (verbose_mode) {
-                std::cerr << "  AT communication error: " << std::string(command, strlen(command) - 2) << std::endl;
-            }
+            log_warn(LOG_AT, "communication_error").s("command", shown).i("retries_left", retries);
             if (retries > 0) {
-                if (verbose_mode) {
-                    std::cout << "  Retrying command due to communication error (" << retries << " attempts left)..." << std::endl;
-                }
+                TraceSpan backoff("at_retry", shown);
+                metrics_count(METRIC_AT_RETRIES);
                 usleep(1000000); // 1 second delay for communication errors
                 continue;
             }
@@ -332,12 +322,10 @@ inline int at_execute_flex_command(int fd, const char *command, char *response,
 /**
  * @brief Initialize device with AT commands and enhanced error recovery.
  */
-inline int at_initialize_flex_device(int fd, bool verbose_mode = false) {
+inline int at_initialize_flex_device(int fd) {
     char response[AT_BUFFER_SIZE];
 
-    if (verbose_mode) {
-        std::cout << "  Testing device communication..." << std::endl;
-    }
+    log_debug(LOG_AT, "device_init");
 
     // Give device time to boot up
     flush_flex_at_buffers(fd);
@@ -345,26 +333,18 @@ inline int at_initialize_flex_device(int fd, bool verbose_mode = false) {
 
     // Try to establish communication
     for (int i = 0; i < 10; i++) {
-        if (verbose_mode) {
-            std::cout << "  Communication attempt " << (i + 1) << "/10..." << std::endl;
-        }
+        log_trace(LOG_AT, "device_init_attempt").i("attempt", i + 1).i("of", 10);
 
         // Clear buffers thoroughly
         flush_flex_at_buffers(fd);
         usleep(200000); // 200ms
 
         // Send basic AT command
-        if (at_execute_flex_command(fd, "AT\r\n", response, sizeof(response), verbose_mode) == 0) {
-            if (verbose_mode) {
-                std::cout << "  Device communication established" << std::endl;
-            }
-
+        if (at_execute_flex_command(fd, "AT\r\n", response, sizeof(response)) == 0) {
             // Send one more AT command to ensure stability
             usleep(200000);
-            if (at_execute_flex_command(fd, "AT\r\n", response, sizeof(response), verbose_mode) == 0) {
-                if (verbose_mode) {
-                    std::cout << "  Device communication confirmed stable" << std::endl;
-                }
+            if (at_execute_flex_command(fd, "AT\r\n", response, sizeof(response)) == 0) {
+                log_debug(LOG_AT, "device_init_done").i("attempts", i + 1);
                 return 0;
             }
         }
@@ -373,7 +353,7 @@ inline int at_initialize_flex_device(int fd, bool verbose_mode = false) {
         usleep(500000 * (i + 1)); // 500ms, 1s, 1.5s, etc.
     }
 
-    std::cerr << "Failed to establish communication after 10 attempts" << std::endl;
+    log_error(LOG_AT, "device_init_failed").i("attempts", 10);
     return -1;
 }
 
@@ -409,69 +389,60 @@ inline void close_flex_at_serial(int fd) {
  * Based on at_send_flex_message from flex-fsk-tx.cpp
  */
 inline int send_flex_via_at_commands(int fd, const FlexATConfig& config,
-                                    const uint8_t *data, size_t size, bool verbose_mode = false) {
+                                    const uint8_t *data, size_t size,
+                                    FlexATTimings* timings = nullptr) {
     char command[128];
     char response[AT_BUFFER_SIZE];
     int send_retries = 3; // Retry sending the entire message up to 3 times
 
-    if (verbose_mode) {
-        std::cout << "AT Command Transmission Details:" << std::endl;
-        std::cout << "  Frequency: " << std::fixed << std::setprecision(4) << config.frequency << " MHz" << std::endl;
-        std::cout << "  Power: " << config.power << std::endl;
-        std::cout << "  Data size: " << size << " bytes" << std::endl;
-        std::cout << "  Configuring radio parameters..." << std::endl;
-    }
+    log_debug(LOG_AT, "send_start").f("frequency_mhz", config.frequency).i("power", config.power).u("bytes", size);
+
+    TraceSpan configure("radio_config");
 
     // Set frequency with retries
     snprintf(command, sizeof(command), "AT+FREQ=%.4f\r\n", config.frequency);
-    if (at_execute_flex_command(fd, command, response, sizeof(response), verbose_mode) < 0) {
-        std::cerr << "Failed to set frequency after all retries" << std::endl;
+    if (at_execute_flex_command(fd, command, response, sizeof(response)) < 0) {
+        log_error(LOG_AT, "set_frequency_failed").f("frequency_mhz", config.frequency);
         return -1;
     }
 
     // Set power with retries
     snprintf(command, sizeof(command), "AT+POWER=%d\r\n", config.power);
-    if (at_execute_flex_command(fd, command, response, sizeof(response), verbose_mode) < 0) {
-        std::cerr << "Failed to set power after all retries" << std::endl;
+    if (at_execute_flex_command(fd, command, response, sizeof(response)) < 0) {
+        log_error(LOG_AT, "set_power_failed").i("power", config.power);
         return -1;
     }
 
-    if (verbose_mode) {
-        std::cout << "  Radio configured successfully." << std::endl;
+    configure.end();
+    log_debug(LOG_AT, "radio_configured");
+    if (timings) {
+        timings->configured = std::chrono::steady_clock::now();
     }
 
     // Try to send the message with retries
     while (send_retries-- > 0) {
-        if (verbose_mode) {
-            std::cout << "  Attempting to send data (attempt " << (3 - send_retries) << "/3)..." << std::endl;
+        log_debug(LOG_AT, "send_attempt").i("attempt", 3 - send_retries).i("of", 3);
+        TraceSpan attempt("send_attempt");
+        if (send_retries < 2) {
+            metrics_count(METRIC_AT_RETRIES);
         }
 
         // Reset device state before attempting to send
-        if (verbose_mode) {
-            std::cout << "  Resetting device state..." << std::endl;
-        }
         flush_flex_at_buffers(fd);
-        if (at_execute_flex_command(fd, "AT\r\n", response, sizeof(response), verbose_mode) < 0) {
-            if (verbose_mode) {
-                std::cout << "  Failed to reset device state, continuing anyway..." << std::endl;
-            }
+        if (at_execute_flex_command(fd, "AT\r\n", response, sizeof(response)) < 0) {
+            log_warn(LOG_AT, "device_reset_failed");
         }
 
         // Send the SEND command
         snprintf(command, sizeof(command), "AT+SEND=%zu\r\n", size);
-        if (verbose_mode) {
-            std::cout << "  Sending command: " << std::string(command, strlen(command) - 2) << std::endl;
-        }
+        log_trace(LOG_AT, "at_send").s("command", std::string_view(command, strlen(command) - 2));
 
         // Clear buffers before sending
         flush_flex_at_buffers(fd);
 
         if (write(fd, command, strlen(command)) < 0) {
-            perror("write");
+            log_warn(LOG_AT, "write_failed").s("error", strerror(errno)).i("retries_left", send_retries);
             if (send_retries > 0) {
-                if (verbose_mode) {
-                    std::cout << "  Write failed, retrying..." << std::endl;
-                }
                 usleep(1000000);
                 continue;
             }
@@ -480,30 +451,22 @@ inline int send_flex_via_at_commands(int fd, const FlexATConfig& config,
         tcdrain(fd);
 
         // Wait for device to be ready for data
-        if (verbose_mode) {
-            std::cout << "  Waiting for device to be ready for data..." << std::endl;
-        }
-        at_response_t result = at_read_flex_response(fd, response, sizeof(response), verbose_mode);
+        at_response_t result = at_read_flex_response(fd, response, sizeof(response));
 
         if (result != AT_RESP_DATA || strstr(response, "+SEND: READY") == NULL) {
-            if (verbose_mode) {
-                std::cerr << "  Device not ready for data. Got response type " << result << ": '" << response << "'" << std::endl;
-            }
+            log_warn(LOG_AT, "device_not_ready").i("response_type", result).s("response", response)
+                .i("retries_left", send_retries);
             if (send_retries > 0) {
-                if (verbose_mode) {
-                    std::cout << "  Device not ready, retrying entire send operation..." << std::endl;
-                }
                 usleep(2000000); // 2 second delay before retry
                 continue;
             }
             return -1;
         }
 
-        if (verbose_mode) {
-            std::cout << "  Device ready! Sending " << size << " bytes of binary data..." << std::endl;
-        }
+        log_debug(LOG_AT, "data_send").u("bytes", size);
 
         // Send binary data in smaller chunks with progress tracking
+        TraceSpan data_span("data_write");
         size_t bytes_sent = 0;
         const size_t CHUNK_SIZE = 32; // Smaller chunks for more reliable transmission
         bool send_success = true;
@@ -514,22 +477,17 @@ inline int send_flex_via_at_commands(int fd, const FlexATConfig& config,
 
             ssize_t written = write(fd, data + bytes_sent, chunk_size);
             if (written < 0) {
-                perror("write binary data");
+                log_warn(LOG_AT, "data_write_failed").s("error", strerror(errno)).u("sent", bytes_sent);
                 send_success = false;
                 break;
             }
 
             bytes_sent += written;
-            if (verbose_mode) {
-                std::cout << "  Sent " << bytes_sent << "/" << size << " bytes ("
-                          << std::fixed << std::setprecision(1) << (float)bytes_sent * 100.0 / size << "%)" << std::endl;
-            }
+            log_trace(LOG_AT, "data_progress").u("sent", bytes_sent).u("bytes", size);
 
             // Check for timeout
             if ((time(NULL) - send_start_time) > (AT_DATA_SEND_TIMEOUT / 1000)) {
-                if (verbose_mode) {
-                    std::cout << "  Binary data send timeout" << std::endl;
-                }
+                log_warn(LOG_AT, "data_send_timeout").u("sent", bytes_sent).u("bytes", size);
                 send_success = false;
                 break;
             }
@@ -540,45 +498,41 @@ inline int send_flex_via_at_commands(int fd, const FlexATConfig& config,
 
         if (!send_success) {
             if (send_retries > 0) {
-                if (verbose_mode) {
-                    std::cout << "  Binary data send failed, retrying entire operation..." << std::endl;
-                }
                 usleep(2000000);
                 continue;
             }
             return -1;
         }
 
-        if (verbose_mode) {
-            std::cout << "  Binary data sent successfully. Waiting for transmission completion..." << std::endl;
-        }
-
         // Ensure all data is transmitted
         tcdrain(fd);
+        data_span.end();
+        TraceSpan on_air("on_air");
+        if (timings) {
+            timings->data_sent = std::chrono::steady_clock::now();
+        }
+        log_debug(LOG_AT, "data_sent").u("bytes", size);
         sleep(5);
 
         // Wait for final response
-        result = at_read_flex_response(fd, response, sizeof(response), verbose_mode);
+        result = at_read_flex_response(fd, response, sizeof(response));
         if (result != AT_RESP_OK) {
-            if (verbose_mode) {
-                std::cerr << "  Transmission failed. Response type " << result << ": '" << response << "'" << std::endl;
-            }
+            log_warn(LOG_AT, "transmission_failed").i("response_type", result).s("response", response)
+                .i("retries_left", send_retries);
             if (send_retries > 0) {
-                if (verbose_mode) {
-                    std::cout << "  Transmission failed, retrying entire operation..." << std::endl;
-                }
                 usleep(2000000);
                 continue;
             }
             return -1;
         }
 
-        if (verbose_mode) {
-            std::cout << "  Transmission completed successfully!" << std::endl;
+        log_debug(LOG_AT, "transmission_done");
+        if (timings) {
+            timings->completed = std::chrono::steady_clock::now();
         }
         return 0;
     }
 
-    std::cerr << "Failed to send message after all retry attempts" << std::endl;
+    log_error(LOG_AT, "send_failed").i("attempts", 3);
     return -1;
 }
@@ -0,0 +1,502 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstring>
+#include <cstdint>
+#include <charconv>
+#include <algorithm>
+
+// Request limits enforced while parsing (the byte limits are defaults, see set_limits())
+#define HTTP_MAX_HEADERS      32
+#define HTTP_MAX_HEADER_BYTES 8192
+#define HTTP_MAX_BODY_BYTES   (1024 * 1024)
+
+typedef enum {
+    HTTP_PARSE_INCOMPLETE,
+    HTTP_PARSE_COMPLETE,
+    HTTP_PARSE_ERROR
+} http_parse_result_t;
+
+struct HttpHeaderView {
+    std::string_view name;
+    std::string_view value;
+};
+
+/**
+ * @brief A parsed request. Every view points into the connection buffer and
+ * stays valid until the request is consumed from that buffer.
+ */
+struct HttpRequestView {
+    std::string_view method;
+    std::string_view path;
+    std::string_view version;
+    HttpHeaderView headers[HTTP_MAX_HEADERS];
+    size_t header_count = 0;
+    std::string_view body;
+
+    // Case-insensitive header lookup, empty view when absent
+    std::string_view header(std::string_view name) const {
+        for (size_t i = 0; i < header_count; ++i) {
+            const std::string_view& key = headers[i].name;
+            if (key.size() == name.size() && strncasecmp(key.data(), name.data(), key.size()) == 0) {
+                return headers[i].value;
+            }
+        }
+        return std::string_view();
+    }
+
+    bool has_header(std::string_view name) const {
+        return header(name).data() != nullptr;
+    }
+};
+
+// True when a comma separated header value (e.g. Connection) lists token
+inline bool http_header_has_token(std::string_view value, std::string_view token) {
+    while (!value.empty()) {
+        size_t comma = value.find(',');
+        std::string_view item = value.substr(0, comma);
+        while (!item.empty() && (item.front() == ' ' || item.front() == '\t')) item.remove_prefix(1);
+        while (!item.empty() && (item.back() == ' ' || item.back() == '\t')) item.remove_suffix(1);
+        if (item.size() == token.size() && strncasecmp(item.data(), token.data(), token.size()) == 0) {
+            return true;
+        }
+        if (comma == std::string_view::npos) break;
+        value.remove_prefix(comma + 1);
+    }
+    return false;
+}
+
+/**
+ * @brief Growable byte buffer owned by one connection.
+ *
+ * Data is appended at the tail with write_ptr()/commit() and dropped from the
+ * head with consume(), so several pipelined requests can sit in the buffer at
+ * once. Bytes are only moved when the free tail space runs out.
+ */
+class ConnBuffer {
+public:
+    explicit ConnBuffer(size_t initial_capacity = 8192)
+        : storage(initial_capacity), head(0), tail(0) {}
+
+    char* data() { return storage.data() + head; }
+    const char* data() const { return storage.data() + head; }
+    size_t size() const { return tail - head; }
+    bool empty() const { return head == tail; }
+
+    // Returns a pointer to at least min_space writable bytes
+    char* write_ptr(size_t min_space = 4096) {
+        if (storage.size() - tail < min_space) {
+            if (head > 0) {
+                memmove(storage.data(), storage.data() + head, tail - head);
+                tail -= head;
+                head = 0;
+            }
+            if (storage.size() - tail < min_space) {
+                storage.resize(tail + min_space);
+            }
+        }
+        return storage.data() + tail;
+    }
+
+    size_t write_space() const { return storage.size() - tail; }
+    void commit(size_t n) { tail += n; }
+
+    void consume(size_t n) {
+        head += n;
+        if (head >= tail) {
+            head = tail = 0;
+        }
+    }
+
+private:
+    std::vector<char> storage;
+    size_t head;
+    size_t tail;
+};
+
+/**
+ * @brief Incremental HTTP/1.1 request parser.
+ *
+ * parse() can be called again every time more bytes arrive; it resumes at
+ * the line it stopped on instead of rescanning the request. Header fields are
+ * recorded as offsets from the start of the request, so the caller may compact
+ * its buffer between calls. No memory is allocated per request.
+ *
+ * Chunked request bodies are decoded in place: chunk payloads are moved down
+ * over the chunk framing so the body ends up contiguous right after the
+ * headers and can still be handed out as a single view.
+ */
+class HttpParser {
+public:
+    HttpParser() : max_header_bytes(HTTP_MAX_HEADER_BYTES), max_body_bytes(HTTP_MAX_BODY_BYTES) {
+        reset();
+    }
+
+    void set_limits(size_t header_bytes, size_t body_bytes) {
+        max_header_bytes = header_bytes;
+        max_body_bytes = body_bytes;
+    }
+
+    void reset() {
+        state = STATE_REQUEST_LINE;
+        line_start = 0;
+        scan_pos = 0;
+        body_start = 0;
+        body_length = 0;
+        request_end = 0;
+        content_length = 0;
+        chunk_remaining = 0;
+        chunked = false;
+        expect_continue = false;
+        header_count = 0;
+        error_status = 0;
+        error_text = nullptr;
+    }
+
+    /**
+     * @brief Parses the request at the start of data[0..len).
+     * On HTTP_PARSE_COMPLETE req is filled in and consumed() gives the number
+     * of bytes the request occupies; anything after that belongs to the next
+     * pipelined request. On HTTP_PARSE_ERROR see status()/reason().
+     */
+    http_parse_result_t parse(char* data, size_t len, HttpRequestView& req) {
+        while (state != STATE_DONE) {
+            http_parse_result_t result;
+            switch (state) {
+            case STATE_REQUEST_LINE:
+            case STATE_HEADERS:
+                result = parse_head(data, len);
+                break;
+            case STATE_BODY:
+                if (len - body_start < content_length) {
+                    return HTTP_PARSE_INCOMPLETE;
+                }
+                body_length = content_length;
+                request_end = body_start + content_length;
+                state = STATE_DONE;
+                result = HTTP_PARSE_COMPLETE;
+                break;
+            default:
+                result = parse_chunked(data, len);
+                break;
+            }
+            if (result != HTTP_PARSE_COMPLETE) {
+                return result;
+            }
+        }
+
+        fill(data, req);
+        return HTTP_PARSE_COMPLETE;
+    }
+
+    size_t consumed() const { return request_end; }
+    int status() const { return error_status; }
+    const char* reason() const { return error_text; }
+
+    // True once the request line and headers have been read
+    bool headers_complete() const {
+        return state != STATE_REQUEST_LINE && state != STATE_HEADERS;
+    }
+
+    // True once the headers of a request carrying "Expect: 100-continue"
+    // are in but its body is not
+    bool awaiting_continue() const {
+        return expect_continue && state != STATE_REQUEST_LINE && state != STATE_HEADERS &&
+               state != STATE_DONE;
+    }
+
+private:
+    enum {
+        STATE_REQUEST_LINE,
+        STATE_HEADERS,
+        STATE_BODY,
+        STATE_CHUNK_SIZE,
+        STATE_CHUNK_DATA,
+        STATE_CHUNK_DATA_END,
+        STATE_CHUNK_TRAILER,
+        STATE_DONE
+    } state;
+
+    struct Span {
+        uint32_t offset;
+        uint32_t length;
+    };
+
+    Span method, path, version;
+    Span header_names[HTTP_MAX_HEADERS];
+    Span header_values[HTTP_MAX_HEADERS];
+    size_t header_count;
+    size_t line_start;
+    size_t scan_pos;         // next byte to examine
+    size_t body_start;
+    size_t body_length;      // decoded body bytes so far
+    size_t request_end;
+    size_t content_length;
+    size_t chunk_remaining;
+    bool chunked;
+    bool expect_continue;
+    int error_status;
+    const char* error_text;
+    size_t max_header_bytes;
+    size_t max_body_bytes;
+
+    http_parse_result_t fail(int status_code, const char* text) {
+        error_status = status_code;
+        error_text = text;
+        return HTTP_PARSE_ERROR;
+    }
+
+    static Span span(size_t from, size_t to) {
+        return Span{static_cast<uint32_t>(from), static_cast<uint32_t>(to - from)};
+    }
+
+    static std::string_view view(const char* data, Span s) {
+        return std::string_view(data + s.offset, s.length);
+    }
+
+    static bool is_space(char c) { return c == ' ' || c == '\t'; }
+
+    static bool name_is(std::string_view name, const char* expected) {
+        size_t n = strlen(expected);
+        return name.size() == n && strncasecmp(name.data(), expected, n) == 0;
+    }
+
+    // Finds the next line starting at scan_pos; returns false if it is not complete yet.
+    // content_end excludes the line terminator (CRLF or bare LF).
+    bool next_line(const char* data, size_t len, size_t& content_end) {
+        const char* nl = static_cast<const char*>(memchr(data + scan_pos, '\n', len - scan_pos));
+        if (!nl) {
+            scan_pos = len;
+            return false;
+        }
+        size_t line_end = nl - data;
+        content_end = line_end;
+        if (content_end > line_start && data[content_end - 1] == '\r') {
+            content_end--;
+        }
+        scan_pos = line_end + 1;
+        return true;
+    }
+
+    http_parse_result_t parse_head(const char* data, size_t len) {
+        while (state == STATE_REQUEST_LINE || state == STATE_HEADERS) {
+            size_t content_end;
+            if (!next_line(data, len, content_end)) {
+                if (len > max_header_bytes) {
+                    return fail(431, "Request Header Fields Too Large");
+                }
+                return HTTP_PARSE_INCOMPLETE;
+            }
+            if (scan_pos > max_header_bytes) {
+                return fail(431, "Request Header Fields Too Large");
+            }
+
+            http_parse_result_t result = (state == STATE_REQUEST_LINE)
+                ? parse_request_line(data, line_start, content_end)
+                : parse_header_line(data, line_start, content_end);
+            if (result == HTTP_PARSE_ERROR) {
+                return result;
+            }
+            line_start = scan_pos;
+        }
+        return HTTP_PARSE_COMPLETE;
+    }
+
+    http_parse_result_t parse_request_line(const char* data, size_t from, size_t to) {
+        // Tolerate empty lines before the request line (RFC 7230 3.5)
+        if (from == to) {
+            return HTTP_PARSE_INCOMPLETE;
+        }
+
+        size_t sp1 = from;
+        while (sp1 < to && data[sp1] != ' ') sp1++;
+        size_t sp2 = sp1 + 1;
+        while (sp2 < to && data[sp2] != ' ') sp2++;
+        if (sp1 == from || sp1 >= to || sp2 >= to || sp2 == sp1 + 1 || sp2 + 1 >= to) {
+            return fail(400, "Malformed request line");
+        }
+
+        method = span(from, sp1);
+        path = span(sp1 + 1, sp2);
+        version = span(sp2 + 1, to);
+        if (view(data, version).compare(0, 5, "HTTP/") != 0) {
+            return fail(400, "Malformed request line");
+        }
+
+        state = STATE_HEADERS;
+        return HTTP_PARSE_INCOMPLETE;
+    }
+
+    http_parse_result_t parse_header_line(const char* data, size_t from, size_t to) {
+        if (from == to) {
+            // Blank line: end of headers
+            body_start = scan_pos;
+            return apply_framing(data);
+        }
+
+        if (header_count >= HTTP_MAX_HEADERS) {
+            return fail(431, "Too many header fields");
+        }
+
+        const char* colon = static_cast<const char*>(memchr(data + from, ':', to - from));
+        if (!colon || colon == data + from) {
+            return fail(400, "Malformed header field");
+        }
+
+        size_t name_end = colon - data;
+        size_t value_start = name_end + 1;
+        size_t value_end = to;
+        while (value_start < value_end && is_space(data[value_start])) value_start++;
+        while (value_end > value_start && is_space(data[value_end - 1])) value_end--;
+
+        header_names[header_count] = span(from, name_end);
+        header_values[header_count] = span(value_start, value_end);
+        header_count++;
+        return HTTP_PARSE_INCOMPLETE;
+    }
+
+    // Works out how the body is framed once all headers are known
+    http_parse_result_t apply_framing(const char* data) {
+        bool has_length = false;
+
+        for (size_t i = 0; i < header_count; ++i) {
+            std::string_view name = view(data, header_names[i]);
+            std::string_view value = view(data, header_values[i]);
+
+            if (name_is(name, "transfer-encoding")) {
+                // Only a bare "chunked" is decoded; any other coding, or chunked
+                // applied twice, would leave the body unreadable
+                if (!name_is(value, "chunked") || chunked) {
+                    return fail(501, "Transfer-Encoding not supported");
+                }
+                chunked = true;
+            } else if (name_is(name, "content-length")) {
+                size_t length = 0;
+                auto res = std::from_chars(value.data(), value.data() + value.size(), length);
+                if (res.ec != std::errc() || res.ptr != value.data() + value.size()) {
+                    return fail(400, "Invalid Content-Length");
+                }
+                // Repeats must agree, or sender and server could split the body differently
+                if (has_length && length != content_length) {
+                    return fail(400, "Conflicting Content-Length");
+                }
+                if (length > max_body_bytes) {
+                    return fail(413, "Payload Too Large");
+                }
+                content_length = length;
+                has_length = true;
+            } else if (name_is(name, "expect")) {
+                expect_continue = http_header_has_token(value, "100-continue");
+            }
+        }
+
+        // Both framings at once is a request smuggling vector (RFC 7230 3.3.3)
+        if (chunked && has_length) {
+            return fail(400, "Conflicting Content-Length and Transfer-Encoding");
+        }
+
+        state = chunked ? STATE_CHUNK_SIZE : STATE_BODY;
+        return HTTP_PARSE_INCOMPLETE;
+    }
+
+    http_parse_result_t parse_chunked(char* data, size_t len) {
+        while (true) {
+            switch (state) {
+            case STATE_CHUNK_SIZE: {
+                size_t content_end;
+                line_start = scan_pos;
+                if (!next_line(data, len, content_end)) {
+                    scan_pos = line_start;
+                    if (len - line_start > 1024) {
+                        return fail(400, "Malformed chunk size");
+                    }
+                    return HTTP_PARSE_INCOMPLETE;
+                }
+
+                size_t size = 0;
+                auto res = std::from_chars(data + line_start, data + content_end, size, 16);
+                if (res.ec != std::errc() || res.ptr == data + line_start ||
+                    (res.ptr != data + content_end && *res.ptr != ';' && !is_space(*res.ptr))) {
+                    return fail(400, "Malformed chunk size");
+                }
+                if (size > max_body_bytes - body_length) {
+                    return fail(413, "Payload Too Large");
+                }
+
+                chunk_remaining = size;
+                state = (size == 0) ? STATE_CHUNK_TRAILER : STATE_CHUNK_DATA;
+                line_start = scan_pos;
+                break;
+            }
+            case STATE_CHUNK_DATA: {
+                // Move whatever part of the chunk has arrived down to the end of the body
+                size_t available = std::min(len - scan_pos, chunk_remaining);
+                if (available > 0) {
+                    memmove(data + body_start + body_length, data + scan_pos, available);
+                    body_length += available;
+                    scan_pos += available;
+                    chunk_remaining -= available;
+                }
+                if (chunk_remaining > 0) {
+                    return HTTP_PARSE_INCOMPLETE;
+                }
+                state = STATE_CHUNK_DATA_END;
+                break;
+            }
+            case STATE_CHUNK_DATA_END: {
+                if (scan_pos >= len) {
+                    return HTTP_PARSE_INCOMPLETE;
+                }
+                if (data[scan_pos] == '\r') {
+                    if (scan_pos + 1 >= len) {
+                        return HTTP_PARSE_INCOMPLETE;
+                    }
+                    if (data[scan_pos + 1] != '\n') {
+                        return fail(400, "Malformed chunk");
+                    }
+                    scan_pos += 2;
+                } else if (data[scan_pos] == '\n') {
+                    scan_pos += 1;
+                } else {
+                    return fail(400, "Malformed chunk");
+                }
+                state = STATE_CHUNK_SIZE;
+                break;
+            }
+            case STATE_CHUNK_TRAILER: {
+                // Trailer fields are read and ignored up to the final blank line
+                size_t content_end;
+                if (!next_line(data, len, content_end)) {
+                    scan_pos = line_start;
+                    if (len - line_start > max_header_bytes) {
+                        return fail(431, "Request Header Fields Too Large");
+                    }
+                    return HTTP_PARSE_INCOMPLETE;
+                }
+                if (content_end == line_start) {
+                    request_end = scan_pos;
+                    state = STATE_DONE;
+                    return HTTP_PARSE_COMPLETE;
+                }
+                line_start = scan_pos;
+                break;
+            }
+            default:
+                return fail(500, "Internal parser error");
+            }
+        }
+    }
+
+    void fill(const char* data, HttpRequestView& req) const {
+        req.method = view(data, method);
+        req.path = view(data, path);
+        req.version = view(data, version);
+        req.header_count = header_count;
+        for (size_t i = 0; i < header_count; ++i) {
+            req.headers[i].name = view(data, header_names[i]);
+            req.headers[i].value = view(data, header_values[i]);
+        }
+        req.body = std::string_view(data + body_start, body_length);
+    }
+};
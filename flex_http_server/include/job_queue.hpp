@@ -0,0 +1,543 @@
+#pragma once
+#include <algorithm>
+#include <string>
+#include <deque>
+#include <map>
+#include <unordered_map>
+#include <vector>
+#include <mutex>
+#include <functional>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <sstream>
+#include <cstdint>
+#include "priority_lanes.hpp"
+#include "dedup_window.hpp"
+#include "airtime.hpp"
+#include "metrics.hpp"
+#include "trace.hpp"
+#include "page_wal.hpp"
+
+// Number of finished jobs kept around for GET /messages/{id}
+#define JOB_HISTORY_LIMIT 4096
+
+typedef enum {
+    JOB_QUEUED,
+    JOB_TRANSMITTING,
+    JOB_SENT,
+    JOB_FAILED
+} job_state_t;
+
+struct Job;
+
+// Called once from the thread that finishes a job
+typedef std::function<void(const Job&)> job_finish_fn;
+
+// A validated page waiting to be queued
+struct PageRequest {
+    uint64_t capcode;
+    std::string message;
+    uint64_t frequency;
+    unsigned priority;          // PRIORITY_*
+    job_finish_fn on_finish;    // optional
+    TraceId trace;              // request the page came in with
+};
+
+struct Job {
+    uint64_t id;
+    uint64_t capcode;
+    std::string message;
+    uint64_t frequency;
+    unsigned priority;
+    job_state_t state;
+    TraceId trace;
+
+    // Wall clock for reporting, steady clock for durations
+    std::chrono::system_clock::time_point queued_wall;
+    std::chrono::steady_clock::time_point queued_at;
+    std::chrono::steady_clock::time_point started_at;
+    std::chrono::steady_clock::time_point finished_at;
+
+    job_finish_fn on_finish;    // optional
+    std::vector<job_finish_fn> duplicate_waiters;   // on_finish of pages merged into this one
+
+    uint32_t airtime_ms;        // estimated transmitter time, counted in the backlog
+    size_t frame_bytes;         // encoded size, 0 until encoded
+};
+
+typedef enum {
+    SUBMIT_QUEUED,
+    SUBMIT_DUPLICATE,           // merged into an earlier identical job
+    SUBMIT_BUSY,                // refused: the transmitter is saturated
+    SUBMIT_FAILED               // refused: the page could not be written to the page log
+} submit_status_t;
+
+struct SubmitResult {
+    uint64_t id;                // 0 when refused
+    submit_status_t status;
+    uint32_t retry_after;       // SUBMIT_BUSY: seconds until the page would be accepted
+    uint32_t drain_seconds;     // SUBMIT_BUSY: estimated time to send everything queued
+};
+
+inline long long job_elapsed_ms(std::chrono::steady_clock::time_point from,
+                                std::chrono::steady_clock::time_point to) {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(to - from).count();
+}
+
+inline const char* job_state_name(job_state_t state) {
+    switch (state) {
+    case JOB_QUEUED:       return "queued";
+    case JOB_TRANSMITTING: return "transmitting";
+    case JOB_SENT:         return "sent";
+    case JOB_FAILED:       return "failed";
+    }
+    return "unknown";
+}
+
+/**
+ * @brief Registry of pages from submission until they leave the history.
+ *
+ * Producers (the network handlers) call submit() and get a job ID back
+ * immediately; every new job is handed to the dispatch hook, which feeds the
+ * encoder pool and, from there, the radio thread. The radio thread reports
+ * progress with start() and finish(). Finished jobs stay queryable until
+ * they fall out of the JOB_HISTORY_LIMIT window. Submitters that need the
+ * outcome pass a callback to submit() instead of polling.
+ *
+ * With a dedup window set, a page identical to one submitted within the
+ * window (same capcode, frequency and message) is not transmitted again:
+ * it is merged into the earlier job, whose ID is returned, and its callback
+ * fires when that job finishes. A page more urgent than the job it matches
+ * is queued anyway, and a failed job no longer absorbs retries.
+ *
+ * Every waiting job also counts its estimated airtime in a backlog per
+ * priority. A page is refused (SUBMIT_BUSY) when the pages ahead of it, at
+ * its priority or above, would keep the transmitter busy past the SLA, or
+ * when the queue already holds its maximum number of pages.
+ *
+ * With a page log set, every accepted page is on disk before submit()
+ * returns, and its start and outcome are logged as they happen. Pages the
+ * log cannot take are refused (SUBMIT_FAILED) rather than acknowledged. The
+ * log is written outside the queue lock, and a job is only registered (and
+ * open to duplicates from other submitters) once its page is on disk;
+ * until then it already counts against the queue limits.
+ */
+class JobQueue {
+public:
+    typedef std::function<void(const std::shared_ptr<Job>&)> dispatch_fn;
+
+    JobQueue() : next_id(1), queued(0), unfinished(0), merged(0), airtime(1600, 0), sla_ms(0), max_queued(0), backlog_ms(),
+                 wal(nullptr) {}
+
+    // Must be set before the first submit()
+    void set_dispatch(dispatch_fn fn) {
+        dispatch = std::move(fn);
+    }
+
+    // Seconds an identical page is merged into the earlier job (0 = off)
+    void set_dedup_window(uint32_t seconds) {
+        std::lock_guard<std::mutex> lock(mutex);
+        recent.set_window(seconds);
+    }
+
+    // Journal accepted pages and their outcomes, so a restart can requeue them.
+    // submit() then returns only once its pages are on disk.
+    void set_wal(PageWal* log) {
+        wal = log;
+    }
+
+    /**
+     * @brief Queues pages recovered from the log under their original IDs,
+     * bypassing admission; they were accepted before the restart. New jobs
+     * are numbered from first_free_id on.
+     */
+    void restore(const std::vector<WalPage>& pages, uint64_t first_free_id) {
+        std::vector<std::shared_ptr<Job>> batch;
+        auto queued_at = std::chrono::steady_clock::now();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            next_id = std::max(next_id, first_free_id);
+            for (const WalPage& page : pages) {
+                auto job = std::make_shared<Job>();
+                job->id = page.job_id;
+                job->capcode = page.capcode;
+                job->message = page.message;
+                job->frequency = page.frequency;
+                job->priority = page.priority;
+                job->trace = page.trace;
+                job->state = JOB_QUEUED;
+                job->queued_wall = page.queued_wall;
+                job->queued_at = queued_at;
+                job->airtime_ms = airtime.estimate_ms();
+                job->frame_bytes = 0;
+                backlog_ms[lane_of(*job)] += job->airtime_ms;
+                jobs[job->id] = job;
+                batch.push_back(job);
+            }
+        }
+        queued += batch.size();
+        unfinished += batch.size();
+        for (const auto& job : batch) {
+            dispatch(job);
+        }
+    }
+
+    // Refuse pages that would wait longer than sla_seconds, or beyond
+    // max_pages waiting (0 = no limit)
+    void set_admission(const AirtimeModel& model, uint32_t sla_seconds, size_t max_pages) {
+        std::lock_guard<std::mutex> lock(mutex);
+        airtime = model;
+        sla_ms = static_cast<uint64_t>(sla_seconds) * 1000;
+        max_queued = max_pages;
+    }
+
+    SubmitResult submit(PageRequest page) {
+        std::vector<PageRequest> pages;
+        pages.push_back(std::move(page));
+        return submit_batch(pages)[0];
+    }
+
+    // Registers several pages under a single lock; results are returned in order
+    std::vector<SubmitResult> submit_batch(const std::vector<PageRequest>& pages) {
+        std::vector<std::shared_ptr<Job>> batch;
+        std::vector<std::pair<job_finish_fn, std::shared_ptr<Job>>> already_finished;
+        std::vector<SubmitResult> results;
+        batch.reserve(pages.size());
+        results.reserve(pages.size());
+        auto queued_wall = std::chrono::system_clock::now();
+        auto queued_at = std::chrono::steady_clock::now();
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (recent.enabled()) {
+                recent.expire(queued_at);
+            }
+            // Identical pages within the batch share a job, which is not in
+            // recent until it has been logged
+            std::unordered_map<DedupKey, std::shared_ptr<Job>, DedupKeyHash> batch_keys;
+            for (size_t i = 0; i < pages.size(); ++i) {
+                const PageRequest& page = pages[i];
+                DedupKey key(page.capcode, page.frequency, page.message);
+
+                if (recent.enabled()) {
+                    std::shared_ptr<Job>* earlier = recent.find(key);
+                    if (!earlier) {
+                        auto it = batch_keys.find(key);
+                        earlier = it != batch_keys.end() ? &it->second : nullptr;
+                    }
+                    if (earlier && (*earlier)->message == page.message &&
+                        (*earlier)->priority >= page.priority) {
+                        const std::shared_ptr<Job>& job = *earlier;
+                        if (page.on_finish) {
+                            if (job->state == JOB_SENT) {
+                                already_finished.emplace_back(page.on_finish, job);
+                            } else {
+                                job->duplicate_waiters.push_back(page.on_finish);
+                            }
+                        }
+                        results.push_back(SubmitResult{job->id, SUBMIT_DUPLICATE, 0, 0});
+                        merged++;
+                        metrics_count(METRIC_PAGES_DUPLICATE);
+                        continue;
+                    }
+                }
+
+                // queued already counts pages other submitters are still logging
+                unsigned lane = page.priority < PRIORITY_LEVELS ? page.priority : PRIORITY_LEVELS - 1;
+                uint32_t cost = airtime.estimate_ms();
+                SubmitResult refused{0, SUBMIT_BUSY, 0, 0};
+                if (!admit_locked(lane, cost, queued.load(), queued_at, refused)) {
+                    results.push_back(refused);
+                    metrics_count(METRIC_PAGES_BUSY);
+                    continue;
+                }
+
+                auto job = std::make_shared<Job>();
+                job->id = next_id++;
+                job->capcode = page.capcode;
+                job->message = page.message;
+                job->frequency = page.frequency;
+                job->priority = page.priority;
+                job->on_finish = page.on_finish;
+                job->trace = page.trace;
+                job->state = JOB_QUEUED;
+                job->queued_wall = queued_wall;
+                job->queued_at = queued_at;
+                job->airtime_ms = cost;
+                job->frame_bytes = 0;
+                backlog_ms[lane] += cost;
+                queued++;
+                results.push_back(SubmitResult{job->id, SUBMIT_QUEUED, 0, 0});
+                batch.push_back(job);
+                if (recent.enabled()) {
+                    batch_keys[key] = job;
+                }
+            }
+        }
+
+        // Acknowledged pages must survive a restart. The log is written and
+        // waited for without the lock held.
+        if (wal && !batch.empty()) {
+            std::vector<std::shared_ptr<Job>> unlogged;
+            uint64_t logged = 0;
+            for (const auto& job : batch) {
+                uint64_t seq = wal->append_submit(job->id, job->capcode, job->message, job->frequency,
+                                                  job->priority, job->trace, queued_wall);
+                if (seq == 0) {
+                    unlogged.push_back(job);
+                } else {
+                    logged = seq;
+                }
+            }
+            if (logged && !wal->wait_durable(logged)) {
+                unlogged = batch;
+            }
+            if (!unlogged.empty()) {
+                refuse_unlogged(unlogged, results);
+                batch.erase(std::remove_if(batch.begin(), batch.end(),
+                                           [](const std::shared_ptr<Job>& job) { return job->state == JOB_FAILED; }),
+                            batch.end());
+            }
+        }
+
+        // Only logged jobs can be looked up or absorb later duplicates
+        if (!batch.empty()) {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (const auto& job : batch) {
+                jobs[job->id] = job;
+                if (recent.enabled()) {
+                    recent.insert(DedupKey(job->capcode, job->frequency, job->message), job, queued_at);
+                }
+            }
+        }
+        unfinished += batch.size();
+        for (const auto& job : batch) {
+            dispatch(job);
+        }
+        for (const auto& waiter : already_finished) {
+            waiter.first(*waiter.second);
+        }
+        return results;
+    }
+
+    // Called by an encoder once the frame size, and so the airtime, is known
+    void encoded(const std::shared_ptr<Job>& job, size_t frame_bytes) {
+        std::lock_guard<std::mutex> lock(mutex);
+        airtime.observe_frame(frame_bytes);
+        uint32_t cost = airtime.page_ms(frame_bytes);
+        if (job->state == JOB_QUEUED) {
+            backlog_ms[lane_of(*job)] += cost;
+            backlog_ms[lane_of(*job)] -= job->airtime_ms;
+        }
+        job->airtime_ms = cost;
+        job->frame_bytes = frame_bytes;
+    }
+
+    // Called by the radio thread when it begins transmitting a job
+    void start(const std::shared_ptr<Job>& job) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            job->state = JOB_TRANSMITTING;
+            job->started_at = std::chrono::steady_clock::now();
+            backlog_ms[lane_of(*job)] -= job->airtime_ms;
+            if (job->frame_bytes > 0) {
+                transmitting_until = job->started_at + std::chrono::milliseconds(job->airtime_ms);
+            }
+            queued--;
+        }
+        if (wal) {
+            wal->append_state(job->id, WAL_START);
+        }
+    }
+
+    void finish(const std::shared_ptr<Job>& job, bool success) {
+        std::vector<job_finish_fn> waiters;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            job->state = success ? JOB_SENT : JOB_FAILED;
+            job->finished_at = std::chrono::steady_clock::now();
+            waiters.swap(job->duplicate_waiters);
+            if (job->frame_bytes > 0) {
+                // Encoder failures never reached the radio
+                transmitting_until = job->finished_at;
+                if (success) {
+                    airtime.observe_transmit(job->frame_bytes,
+                        static_cast<uint32_t>(job_elapsed_ms(job->started_at, job->finished_at)));
+                }
+            }
+            finished.push_back(job->id);
+            while (finished.size() > JOB_HISTORY_LIMIT) {
+                jobs.erase(finished.front());
+                finished.pop_front();
+            }
+
+            // Let a retry of a failed page go out again
+            if (!success && recent.enabled()) {
+                DedupKey key(job->capcode, job->frequency, job->message);
+                std::shared_ptr<Job>* earlier = recent.find(key);
+                if (earlier && *earlier == job) {
+                    recent.erase(key);
+                }
+            }
+        }
+        if (wal) {
+            wal->append_state(job->id, success ? WAL_SENT : WAL_FAILED);
+        }
+        unfinished--;
+        metrics_count(success ? METRIC_PAGES_SENT : METRIC_PAGES_FAILED);
+        if (job->on_finish) {
+            job->on_finish(*job);
+        }
+        for (const job_finish_fn& waiter : waiters) {
+            waiter(*job);
+        }
+    }
+
+    // Copies the current state of a job; returns false for unknown IDs
+    bool lookup(uint64_t id, Job& out) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = jobs.find(id);
+        if (it == jobs.end()) {
+            return false;
+        }
+        out = *it->second;
+        return true;
+    }
+
+    // Jobs submitted (or still being logged) but not yet picked up by the radio
+    size_t depth() const {
+        return queued.load();
+    }
+
+    // Jobs submitted and not yet sent or failed, including the one on the air
+    size_t outstanding() const {
+        return unfinished.load();
+    }
+
+    // Pages merged into an earlier identical job since startup
+    uint64_t duplicates_merged() const {
+        return merged.load();
+    }
+
+    // Estimated milliseconds until everything queued has been sent
+    uint64_t drain_ms() {
+        std::lock_guard<std::mutex> lock(mutex);
+        uint64_t total = in_flight_ms(std::chrono::steady_clock::now());
+        for (unsigned lane = 0; lane < PRIORITY_LEVELS; ++lane) {
+            total += backlog_ms[lane];
+        }
+        return total;
+    }
+
+private:
+    /**
+     * @brief Takes back pages the log could not take or whose commit failed:
+     * they are refused instead of queued, and marked failed in the log so a
+     * restart does not send them. Identical pages of the same batch that were
+     * merged into them are refused with them.
+     */
+    void refuse_unlogged(const std::vector<std::shared_ptr<Job>>& refused, std::vector<SubmitResult>& results) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (const auto& job : refused) {
+                job->state = JOB_FAILED;
+                job->finished_at = std::chrono::steady_clock::now();
+                job->duplicate_waiters.clear();
+                backlog_ms[lane_of(*job)] -= job->airtime_ms;
+                queued--;
+                for (SubmitResult& result : results) {
+                    if (result.id == job->id) {
+                        result = SubmitResult{0, SUBMIT_FAILED, 0, 0};
+                    }
+                }
+            }
+        }
+        for (const auto& job : refused) {
+            wal->append_state(job->id, WAL_FAILED);
+        }
+    }
+
+    static unsigned lane_of(const Job& job) {
+        return job.priority < PRIORITY_LEVELS ? job.priority : PRIORITY_LEVELS - 1;
+    }
+
+    // What is left of the page on the air now, by its estimate
+    uint64_t in_flight_ms(std::chrono::steady_clock::time_point now) const {
+        return transmitting_until > now ? static_cast<uint64_t>(job_elapsed_ms(now, transmitting_until)) : 0;
+    }
+
+    // Checks a new page against the SLA and the queue limit. Caller holds the mutex.
+    bool admit_locked(unsigned lane, uint32_t cost, size_t waiting, std::chrono::steady_clock::time_point now,
+                      SubmitResult& refused) const {
+        uint64_t ahead = in_flight_ms(now);
+        uint64_t total = ahead;
+        for (unsigned level = 0; level < PRIORITY_LEVELS; ++level) {
+            total += backlog_ms[level];
+            if (level >= lane) {
+                ahead += backlog_ms[level];
+            }
+        }
+
+        bool full = max_queued > 0 && waiting >= max_queued;
+        bool late = sla_ms > 0 && ahead + cost > sla_ms;
+        if (!full && !late) {
+            return true;
+        }
+
+        // Late pages fit once enough has drained; a full queue frees a slot per page sent
+        uint64_t wait = late ? ahead + cost - sla_ms : cost;
+        refused.retry_after = static_cast<uint32_t>(wait / 1000 + 1);
+        refused.drain_seconds = static_cast<uint32_t>((total + 999) / 1000);
+        return false;
+    }
+
+    std::mutex mutex;
+    std::deque<uint64_t> finished;
+    std::map<uint64_t, std::shared_ptr<Job>> jobs;
+    dispatch_fn dispatch;
+    uint64_t next_id;
+    std::atomic<size_t> queued;
+    std::atomic<size_t> unfinished;
+    std::atomic<uint64_t> merged;
+    DedupWindow<std::shared_ptr<Job>> recent;
+
+    AirtimeModel airtime;
+    uint64_t sla_ms;
+    size_t max_queued;
+    uint64_t backlog_ms[PRIORITY_LEVELS];   // airtime of the jobs waiting in each lane
+    std::chrono::steady_clock::time_point transmitting_until;
+    PageWal* wal;
+};
+
+/**
+ * @brief Renders a job as the JSON body returned by GET /messages/{id}.
+ */
+inline std::string job_status_json(const Job& job) {
+    auto now = std::chrono::steady_clock::now();
+    long long queued_epoch_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+        job.queued_wall.time_since_epoch()).count();
+
+    std::ostringstream json;
+    json << "{\"id\":" << job.id
+         << ",\"status\":\"" << job_state_name(job.state) << "\""
+         << ",\"capcode\":" << job.capcode
+         << ",\"frequency\":" << job.frequency
+         << ",\"priority\":" << job.priority
+         << ",\"trace_id\":\"" << job.trace.str() << "\""
+         << ",\"queued_at\":" << queued_epoch_ms;
+
+    if (job.state == JOB_QUEUED) {
+        json << ",\"queue_ms\":" << job_elapsed_ms(job.queued_at, now);
+    } else {
+        json << ",\"queue_ms\":" << job_elapsed_ms(job.queued_at, job.started_at);
+        if (job.state == JOB_TRANSMITTING) {
+            json << ",\"transmit_ms\":" << job_elapsed_ms(job.started_at, now);
+        } else {
+            json << ",\"transmit_ms\":" << job_elapsed_ms(job.started_at, job.finished_at)
+                 << ",\"total_ms\":" << job_elapsed_ms(job.queued_at, job.finished_at);
+        }
+    }
+    json << "}";
+    return json.str();
+}
@@ -0,0 +1,578 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstring>
+#include <cstdint>
+#include <charconv>
+
+// Deepest object/array nesting the tokenizer accepts
+#define JSON_MAX_DEPTH 64
+
+struct JsonMessage {
+    uint64_t capcode;
+    std::string message;
+    uint64_t frequency;
+    uint64_t priority;
+    bool has_priority;
+    bool valid;
+    std::string error;  // why valid is false, if known
+};
+
+typedef enum {
+    JSON_TOKEN_OBJECT_BEGIN,
+    JSON_TOKEN_OBJECT_END,
+    JSON_TOKEN_ARRAY_BEGIN,
+    JSON_TOKEN_ARRAY_END,
+    JSON_TOKEN_STRING,
+    JSON_TOKEN_NUMBER,
+    JSON_TOKEN_TRUE,
+    JSON_TOKEN_FALSE,
+    JSON_TOKEN_NULL,
+    JSON_TOKEN_END,
+    JSON_TOKEN_ERROR
+} json_token_t;
+
+/**
+ * @brief Single-pass, pull-style JSON tokenizer.
+ *
+ * Each call to next() returns one token and validates the grammar as it goes
+ * (separators, nesting, literals, number syntax). Nothing is built up in
+ * memory: strings are decoded into one reusable buffer (string()) and numbers
+ * are exposed as the raw text (number()). Several top-level values may follow
+ * each other, which is how NDJSON input is read.
+ */
+class JsonTokenizer {
+public:
+    explicit JsonTokenizer(std::string_view text)
+        : input(text), pos(0), depth(0), object_bits(0), expect(EXPECT_VALUE),
+          key(false), error_text(nullptr) {}
+
+    json_token_t next() {
+        key = false;
+        skip_whitespace();
+
+        if (pos >= input.size()) {
+            if (depth == 0 && expect == EXPECT_VALUE) {
+                return JSON_TOKEN_END;
+            }
+            return fail("Unexpected end of JSON input");
+        }
+
+        if (expect == EXPECT_COMMA_OR_END) {
+            char c = input[pos];
+            if (c == '}' || c == ']') {
+                return close(c);
+            }
+            if (c != ',') {
+                return fail("Expected ',' or closing bracket");
+            }
+            pos++;
+            expect = in_object() ? EXPECT_KEY : EXPECT_VALUE;
+            if (!skip_whitespace()) {
+                return fail("Unexpected end of JSON input");
+            }
+        }
+
+        if (expect == EXPECT_COLON) {
+            if (input[pos] != ':') {
+                return fail("Expected ':' after object key");
+            }
+            pos++;
+            expect = EXPECT_VALUE;
+            if (!skip_whitespace()) {
+                return fail("Unexpected end of JSON input");
+            }
+        }
+
+        char c = input[pos];
+
+        if (expect == EXPECT_KEY_OR_END) {
+            if (c == '}') {
+                return close(c);
+            }
+            expect = EXPECT_KEY;
+        } else if (expect == EXPECT_VALUE_OR_END) {
+            if (c == ']') {
+                return close(c);
+            }
+            expect = EXPECT_VALUE;
+        }
+
+        if (expect == EXPECT_KEY) {
+            if (c != '"' || !read_string()) {
+                return fail(error_text ? error_text : "Expected object key");
+            }
+            key = true;
+            expect = EXPECT_COLON;
+            return JSON_TOKEN_STRING;
+        }
+
+        switch (c) {
+        case '{':
+        case '[':
+            if (depth >= JSON_MAX_DEPTH) {
+                return fail("JSON nested too deeply");
+            }
+            if (c == '{') {
+                object_bits |= (1ULL << depth);
+            } else {
+                object_bits &= ~(1ULL << depth);
+            }
+            depth++;
+            pos++;
+            expect = (c == '{') ? EXPECT_KEY_OR_END : EXPECT_VALUE_OR_END;
+            return (c == '{') ? JSON_TOKEN_OBJECT_BEGIN : JSON_TOKEN_ARRAY_BEGIN;
+        case '"':
+            if (!read_string()) {
+                return fail(error_text);
+            }
+            after_value();
+            return JSON_TOKEN_STRING;
+        case 't':
+            return literal("true", JSON_TOKEN_TRUE);
+        case 'f':
+            return literal("false", JSON_TOKEN_FALSE);
+        case 'n':
+            return literal("null", JSON_TOKEN_NULL);
+        default:
+            if (c == '-' || (c >= '0' && c <= '9')) {
+                if (!read_number()) {
+                    return fail("Invalid number");
+                }
+                after_value();
+                return JSON_TOKEN_NUMBER;
+            }
+            return fail("Unexpected character in JSON");
+        }
+    }
+
+    /**
+     * @brief Skips the value whose first token was just returned.
+     * For objects and arrays this consumes everything up to the matching
+     * closing bracket. Returns false on a syntax error.
+     */
+    bool skip(json_token_t first) {
+        if (first == JSON_TOKEN_ERROR) {
+            return false;
+        }
+        if (first != JSON_TOKEN_OBJECT_BEGIN && first != JSON_TOKEN_ARRAY_BEGIN) {
+            return true;
+        }
+        size_t target = depth - 1;
+        while (depth > target) {
+            if (next() == JSON_TOKEN_ERROR) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Decoded contents of the last string token
+    const std::string& string() const { return text; }
+    // Raw text of the last number token
+    std::string_view number() const { return number_text; }
+    // True if the last string token was an object key
+    bool is_key() const { return key; }
+    size_t offset() const { return pos; }
+    const char* error() const { return error_text; }
+
+private:
+    typedef enum {
+        EXPECT_VALUE,
+        EXPECT_VALUE_OR_END,   // just after '['
+        EXPECT_KEY,
+        EXPECT_KEY_OR_END,     // just after '{'
+        EXPECT_COLON,
+        EXPECT_COMMA_OR_END
+    } expect_t;
+
+    std::string_view input;
+    size_t pos;
+    size_t depth;
+    uint64_t object_bits;      // bit n set when nesting level n is an object
+    expect_t expect;
+    bool key;
+    const char* error_text;
+    std::string text;
+    std::string_view number_text;
+
+    bool in_object() const {
+        return depth > 0 && (object_bits & (1ULL << (depth - 1)));
+    }
+
+    // Returns false if the end of input was reached
+    bool skip_whitespace() {
+        while (pos < input.size()) {
+            char c = input[pos];
+            if (c != ' ' && c != '\t' && c != '\n' && c != '\r') {
+                return true;
+            }
+            pos++;
+        }
+        return false;
+    }
+
+    json_token_t fail(const char* message) {
+        error_text = message;
+        pos = input.size();
+        expect = EXPECT_COMMA_OR_END;  // every later call keeps failing
+        depth = 1;
+        return JSON_TOKEN_ERROR;
+    }
+
+    void after_value() {
+        expect = (depth > 0) ? EXPECT_COMMA_OR_END : EXPECT_VALUE;
+    }
+
+    json_token_t close(char c) {
+        bool object = in_object();
+        if (depth == 0 || (c == '}') != object) {
+            return fail("Mismatched closing bracket");
+        }
+        depth--;
+        pos++;
+        after_value();
+        return object ? JSON_TOKEN_OBJECT_END : JSON_TOKEN_ARRAY_END;
+    }
+
+    json_token_t literal(const char* word, json_token_t token) {
+        size_t n = strlen(word);
+        if (input.compare(pos, n, word) != 0) {
+            return fail("Invalid literal");
+        }
+        pos += n;
+        after_value();
+        return token;
+    }
+
+    bool read_number() {
+        size_t start = pos;
+        if (input[pos] == '-') pos++;
+
+        if (pos < input.size() && input[pos] == '0') {
+            pos++;
+        } else if (!read_digits()) {
+            return false;
+        }
+        if (pos < input.size() && input[pos] == '.') {
+            pos++;
+            if (!read_digits()) return false;
+        }
+        if (pos < input.size() && (input[pos] == 'e' || input[pos] == 'E')) {
+            pos++;
+            if (pos < input.size() && (input[pos] == '+' || input[pos] == '-')) pos++;
+            if (!read_digits()) return false;
+        }
+
+        number_text = input.substr(start, pos - start);
+        return true;
+    }
+
+    bool read_digits() {
+        size_t start = pos;
+        while (pos < input.size() && input[pos] >= '0' && input[pos] <= '9') pos++;
+        return pos > start;
+    }
+
+    static int hex_value(char c) {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        return -1;
+    }
+
+    bool read_hex4(uint32_t& value) {
+        if (input.size() - pos < 4) return false;
+        value = 0;
+        for (int i = 0; i < 4; ++i) {
+            int digit = hex_value(input[pos + i]);
+            if (digit < 0) return false;
+            value = (value << 4) | digit;
+        }
+        pos += 4;
+        return true;
+    }
+
+    void append_utf8(uint32_t cp) {
+        if (cp < 0x80) {
+            text += static_cast<char>(cp);
+        } else if (cp < 0x800) {
+            text += static_cast<char>(0xC0 | (cp >> 6));
+            text += static_cast<char>(0x80 | (cp & 0x3F));
+        } else if (cp < 0x10000) {
+            text += static_cast<char>(0xE0 | (cp >> 12));
+            text += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+            text += static_cast<char>(0x80 | (cp & 0x3F));
+        } else {
+            text += static_cast<char>(0xF0 | (cp >> 18));
+            text += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+            text += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+            text += static_cast<char>(0x80 | (cp & 0x3F));
+        }
+    }
+
+    // Decodes the string starting at the opening quote into text
+    bool read_string() {
+        text.clear();
+        pos++;
+
+        while (pos < input.size()) {
+            // Copy the run up to the next quote, escape or control character in one go
+            size_t run = pos;
+            while (run < input.size() && input[run] != '"' && input[run] != '\\' &&
+                   static_cast<unsigned char>(input[run]) >= 0x20) {
+                run++;
+            }
+            text.append(input.data() + pos, run - pos);
+            pos = run;
+
+            if (pos >= input.size()) {
+                break;
+            }
+
+            char c = input[pos++];
+            if (c == '"') {
+                return true;
+            }
+            if (c != '\\') {
+                error_text = "Unescaped control character in string";
+                return false;
+            }
+            if (pos >= input.size()) {
+                break;
+            }
+
+            char escape = input[pos++];
+            switch (escape) {
+            case '"':  text += '"';  break;
+            case '\\': text += '\\'; break;
+            case '/':  text += '/';  break;
+            case 'b':  text += '\b'; break;
+            case 'f':  text += '\f'; break;
+            case 'n':  text += '\n'; break;
+            case 'r':  text += '\r'; break;
+            case 't':  text += '\t'; break;
+            case 'u': {
+                uint32_t cp;
+                if (!read_hex4(cp)) {
+                    error_text = "Invalid unicode escape";
+                    return false;
+                }
+                // Combine UTF-16 surrogate pairs
+                if (cp >= 0xD800 && cp <= 0xDBFF) {
+                    uint32_t low;
+                    if (input.compare(pos, 2, "\\u") != 0 || (pos += 2, !read_hex4(low)) ||
+                        low < 0xDC00 || low > 0xDFFF) {
+                        error_text = "Invalid surrogate pair";
+                        return false;
+                    }
+                    cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                } else if (cp >= 0xDC00 && cp <= 0xDFFF) {
+                    error_text = "Invalid surrogate pair";
+                    return false;
+                }
+                append_utf8(cp);
+                break;
+            }
+            default:
+                error_text = "Invalid escape sequence";
+                return false;
+            }
+        }
+
+        error_text = "Unterminated string";
+        return false;
+    }
+};
+
+/**
+ * @brief Reads an unsigned integer field, given as a JSON number or a string
+ * of digits. Fractions, exponents and negative values are rejected.
+ */
+inline bool json_read_uint64(JsonTokenizer& json, json_token_t token, uint64_t& value) {
+    std::string_view digits;
+    if (token == JSON_TOKEN_NUMBER) {
+        digits = json.number();
+    } else if (token == JSON_TOKEN_STRING) {
+        digits = json.string();
+    } else {
+        json.skip(token);
+        return false;
+    }
+
+    auto res = std::from_chars(digits.data(), digits.data() + digits.size(), value);
+    return !digits.empty() && res.ec == std::errc() && res.ptr == digits.data() + digits.size();
+}
+
+/**
+ * @brief Reads the fields of a message object whose '{' was just returned.
+ * Unknown fields, including nested objects and arrays, are skipped. Returns
+ * false on a JSON syntax error (the tokenizer cannot continue after that).
+ */
+inline bool json_read_message_object(JsonTokenizer& json, JsonMessage& msg) {
+    msg.capcode = 0;
+    msg.frequency = 0;  // Will use default if not provided
+    msg.priority = 0;
+    msg.has_priority = false;
+    msg.message.clear();
+    msg.valid = false;
+    msg.error.clear();
+
+    while (true) {
+        json_token_t token = json.next();
+        if (token == JSON_TOKEN_OBJECT_END) {
+            break;
+        }
+        if (token != JSON_TOKEN_STRING) {
+            msg.error = json.error() ? json.error() : "Invalid JSON object";
+            return false;
+        }
+
+        const std::string& field = json.string();
+        int which = (field == "capcode") ? 1 : (field == "message") ? 2 : (field == "frequency") ? 3 :
+                    (field == "priority") ? 4 : 0;
+
+        token = json.next();
+        if (token == JSON_TOKEN_ERROR) {
+            msg.error = json.error();
+            return false;
+        }
+
+        switch (which) {
+        case 1:
+            if (!json_read_uint64(json, token, msg.capcode) && msg.error.empty()) {
+                msg.error = "capcode must be an unsigned integer";
+            }
+            break;
+        case 2:
+            if (token == JSON_TOKEN_STRING) {
+                msg.message.assign(json.string());
+            } else {
+                json.skip(token);
+                if (msg.error.empty()) {
+                    msg.error = "message must be a string";
+                }
+            }
+            break;
+        case 3:
+            if (token == JSON_TOKEN_NULL) {
+                break;
+            }
+            if (!json_read_uint64(json, token, msg.frequency) && msg.error.empty()) {
+                msg.error = "frequency must be an unsigned integer";
+            }
+            break;
+        case 4:
+            if (token == JSON_TOKEN_NULL) {
+                break;
+            }
+            msg.has_priority = json_read_uint64(json, token, msg.priority);
+            if (!msg.has_priority && msg.error.empty()) {
+                msg.error = "priority must be an unsigned integer";
+            }
+            break;
+        default:
+            if (!json.skip(token)) {
+                msg.error = json.error();
+                return false;
+            }
+            break;
+        }
+
+        if (json.error()) {
+            msg.error = json.error();
+            return false;
+        }
+    }
+
+    msg.valid = msg.error.empty();
+    return true;
+}
+
+/**
+ * @brief Parses the body of a single-message request.
+ */
+inline JsonMessage parse_json_message(std::string_view body) {
+    JsonMessage msg;
+    msg.capcode = 0;
+    msg.frequency = 0;
+    msg.valid = false;
+
+    JsonTokenizer json(body);
+    json_token_t token = json.next();
+    if (token != JSON_TOKEN_OBJECT_BEGIN) {
+        msg.error = (token == JSON_TOKEN_ERROR) ? json.error() : "Expected a JSON object";
+        return msg;
+    }
+
+    if (json_read_message_object(json, msg) && json.next() != JSON_TOKEN_END) {
+        msg.valid = false;
+        msg.error = json.error() ? json.error() : "Unexpected data after JSON object";
+    }
+    return msg;
+}
+
+/**
+ * @brief Parses a batch body: a JSON array of message objects, or NDJSON
+ * with one object per line. Each entry gets its own JsonMessage, including
+ * entries that fail validation. NDJSON lines are parsed independently so a
+ * malformed line only affects itself. Returns false (with error set) when a
+ * JSON array is syntactically broken.
+ */
+inline bool parse_json_batch(std::string_view body, std::vector<JsonMessage>& messages, std::string& error) {
+    size_t start = body.find_first_not_of(" \t\r\n");
+    if (start == std::string_view::npos) {
+        return true;
+    }
+
+    if (body[start] != '[') {
+        while (start < body.size()) {
+            size_t end = body.find('\n', start);
+            if (end == std::string_view::npos) {
+                end = body.size();
+            }
+            std::string_view line = body.substr(start, end - start);
+            if (line.find_first_not_of(" \t\r") != std::string_view::npos) {
+                messages.push_back(parse_json_message(line));
+            }
+            start = end + 1;
+        }
+        return true;
+    }
+
+    JsonTokenizer json(body);
+    json.next();  // '['
+
+    while (true) {
+        json_token_t token = json.next();
+        if (token == JSON_TOKEN_ARRAY_END) {
+            break;
+        }
+
+        JsonMessage msg;
+        msg.capcode = 0;
+        msg.frequency = 0;
+        msg.valid = false;
+
+        if (token == JSON_TOKEN_OBJECT_BEGIN) {
+            if (!json_read_message_object(json, msg)) {
+                error = msg.error;
+                return false;
+            }
+        } else {
+            if (!json.skip(token)) {
+                error = json.error();
+                return false;
+            }
+            msg.error = "Batch entries must be JSON objects";
+        }
+        messages.push_back(std::move(msg));
+    }
+
+    if (json.next() != JSON_TOKEN_END) {
+        error = json.error() ? json.error() : "Unexpected data after JSON array";
+        return false;
+    }
+    return true;
+}
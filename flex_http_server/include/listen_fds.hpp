@@ -0,0 +1,273 @@
+#pragma once
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// First descriptor passed by systemd socket activation (SD_LISTEN_FDS_START)
+#define LISTEN_FDS_START 3
+
+// Most listening sockets handed from one server process to the next
+#define HANDOFF_MAX_FDS 16
+
+// Sent by the new process to ask for the listeners, and back with them
+#define HANDOFF_MAGIC "FLXHANDOFF1"
+
+// How long the running server waits for a takeover request once connected
+#define HANDOFF_REQUEST_TIMEOUT_MS 1000
+
+/**
+ * @brief Listening sockets the process did not create itself: passed by
+ * systemd socket activation or handed over by the server being replaced.
+ *
+ * Each is claimed by address, not by position or name, so the socket units
+ * and the configuration only have to agree on ports and paths. Sockets
+ * nobody claims are closed by close_rest().
+ */
+class InheritedListeners {
+public:
+    InheritedListeners() : from_systemd(false) {}
+
+    ~InheritedListeners() {
+        close_rest();
+    }
+
+    InheritedListeners(const InheritedListeners&) = delete;
+    InheritedListeners& operator=(const InheritedListeners&) = delete;
+
+    /**
+     * @brief Takes the sockets systemd passed (sd_listen_fds(3) protocol,
+     * implemented here to avoid a libsystemd dependency). The variables are
+     * cleared so child processes do not see them.
+     */
+    size_t load_systemd() {
+        const char* pid = getenv("LISTEN_PID");
+        const char* count = getenv("LISTEN_FDS");
+        if (pid && count && strtol(pid, nullptr, 10) == static_cast<long>(getpid())) {
+            long n = strtol(count, nullptr, 10);
+            for (long i = 0; i < n && i < HANDOFF_MAX_FDS; ++i) {
+                add(LISTEN_FDS_START + static_cast<int>(i));
+            }
+            from_systemd = !fds.empty();
+        }
+        unsetenv("LISTEN_PID");
+        unsetenv("LISTEN_FDS");
+        unsetenv("LISTEN_FDNAMES");
+        return fds.size();
+    }
+
+    // Adopts a listening socket: made non-blocking and close-on-exec
+    void add(int fd) {
+        int flags = fcntl(fd, F_GETFL);
+        if (flags < 0) {
+            return;
+        }
+        fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+        fds.push_back(fd);
+    }
+
+    bool empty() const {
+        return fds.empty();
+    }
+
+    size_t size() const {
+        return fds.size();
+    }
+
+    // Whether the sockets came from systemd, which then owns any unix paths
+    bool systemd() const {
+        return from_systemd;
+    }
+
+    // The TCP listener on port, or -1
+    int take_tcp(int port) {
+        return take([port](const struct sockaddr_storage& address) {
+            if (address.ss_family == AF_INET) {
+                return ntohs(((const struct sockaddr_in*)&address)->sin_port) == port;
+            }
+            if (address.ss_family == AF_INET6) {
+                return ntohs(((const struct sockaddr_in6*)&address)->sin6_port) == port;
+            }
+            return false;
+        });
+    }
+
+    // The unix listener bound to path, or -1
+    int take_unix(const std::string& path) {
+        return take([&path](const struct sockaddr_storage& address) {
+            return address.ss_family == AF_UNIX &&
+                   path == ((const struct sockaddr_un*)&address)->sun_path;
+        });
+    }
+
+    void close_rest() {
+        for (int fd : fds) {
+            close(fd);
+        }
+        fds.clear();
+    }
+
+private:
+    template <typename Match>
+    int take(Match match) {
+        for (size_t i = 0; i < fds.size(); ++i) {
+            struct sockaddr_storage address;
+            memset(&address, 0, sizeof(address));
+            socklen_t length = sizeof(address);
+            int listening = 0;
+            socklen_t option_length = sizeof(listening);
+            if (getsockname(fds[i], (struct sockaddr*)&address, &length) == 0 &&
+                getsockopt(fds[i], SOL_SOCKET, SO_ACCEPTCONN, &listening, &option_length) == 0 &&
+                listening && match(address)) {
+                int fd = fds[i];
+                fds.erase(fds.begin() + i);
+                return fd;
+            }
+        }
+        return -1;
+    }
+
+    std::vector<int> fds;
+    bool from_systemd;
+};
+
+/*
+ * Listener handoff between an old and a new server process.
+ *
+ * The running server listens on HANDOFF_SOCKET. A new process connects and
+ * sends HANDOFF_MAGIC; the old one answers with HANDOFF_MAGIC and its
+ * listening sockets as SCM_RIGHTS, then shuts down. It keeps the handoff
+ * connection open until it has fully stopped, so the new process waits for
+ * end-of-file before touching the FLEX device or the page log. Clients that
+ * connect in between wait in the listen backlog instead of being refused.
+ */
+
+// Asks the server listening at path for its sockets. Returns the handoff
+// connection (wait on it with handoff_wait_release()) or -1 when no server
+// is running there or it refused.
+inline int handoff_request(const std::string& path, InheritedListeners& listeners, std::string& error) {
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) {
+        error = "path too long";
+        return -1;
+    }
+    strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        error = strerror(errno);
+        return -1;
+    }
+    if (connect(fd, (struct sockaddr*)&address, sizeof(address)) < 0) {
+        // Nothing to take over: first start, or the old server is gone
+        error.clear();
+        close(fd);
+        return -1;
+    }
+    if (send(fd, HANDOFF_MAGIC, sizeof(HANDOFF_MAGIC), MSG_NOSIGNAL) != (ssize_t)sizeof(HANDOFF_MAGIC)) {
+        error = "request not sent";
+        close(fd);
+        return -1;
+    }
+
+    char magic[sizeof(HANDOFF_MAGIC)];
+    char control[CMSG_SPACE(sizeof(int) * HANDOFF_MAX_FDS)];
+    struct iovec iov = {magic, sizeof(magic)};
+    struct msghdr message;
+    memset(&message, 0, sizeof(message));
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+    ssize_t n;
+    do {
+        n = recvmsg(fd, &message, MSG_CMSG_CLOEXEC);
+    } while (n < 0 && errno == EINTR);
+
+    for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&message); cmsg; cmsg = CMSG_NXTHDR(&message, cmsg)) {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+            size_t count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+            const int* received = (const int*)CMSG_DATA(cmsg);
+            for (size_t i = 0; i < count; ++i) {
+                listeners.add(received[i]);
+            }
+        }
+    }
+    if (n != (ssize_t)sizeof(magic) || memcmp(magic, HANDOFF_MAGIC, sizeof(magic)) != 0) {
+        error = "no answer from the running server";
+        listeners.close_rest();
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Blocks until the old server closes the handoff connection, which it does
+// only when it has stopped
+inline void handoff_wait_release(int fd) {
+    char byte;
+    ssize_t n;
+    do {
+        n = read(fd, &byte, 1);
+    } while (n > 0 || (n < 0 && errno == EINTR));
+    close(fd);
+}
+
+/**
+ * @brief Old server side: reads the takeover request from a non-blocking
+ * handoff connection into received. Returns 1 once a valid request is
+ * complete, 0 while more is expected and -1 if the peer closed the
+ * connection or sent something else.
+ */
+inline int handoff_read_request(int fd, std::string& received) {
+    char buffer[sizeof(HANDOFF_MAGIC)];
+    while (received.size() < sizeof(HANDOFF_MAGIC)) {
+        ssize_t n = recv(fd, buffer, sizeof(HANDOFF_MAGIC) - received.size(), 0);
+        if (n > 0) {
+            received.append(buffer, n);
+        } else if (n < 0 && errno == EINTR) {
+            continue;
+        } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return 0;
+        } else {
+            return -1;
+        }
+    }
+    return memcmp(received.data(), HANDOFF_MAGIC, sizeof(HANDOFF_MAGIC)) == 0 ? 1 : -1;
+}
+
+// Old server side: answers a valid request with the listening sockets.
+// The reply is a single small message, so it never waits on the peer.
+inline bool handoff_send(int fd, const std::vector<int>& listeners) {
+    if (listeners.size() > HANDOFF_MAX_FDS) {
+        return false;
+    }
+    char magic[sizeof(HANDOFF_MAGIC)];
+    memcpy(magic, HANDOFF_MAGIC, sizeof(magic));
+    char control[CMSG_SPACE(sizeof(int) * HANDOFF_MAX_FDS)];
+    memset(control, 0, sizeof(control));
+    struct iovec iov = {magic, sizeof(magic)};
+    struct msghdr message;
+    memset(&message, 0, sizeof(message));
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+    if (!listeners.empty()) {
+        message.msg_control = control;
+        message.msg_controllen = CMSG_SPACE(sizeof(int) * listeners.size());
+        struct cmsghdr* cmsg = CMSG_FIRSTHDR(&message);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int) * listeners.size());
+        memcpy(CMSG_DATA(cmsg), listeners.data(), sizeof(int) * listeners.size());
+    }
+    return sendmsg(fd, &message, MSG_NOSIGNAL) == (ssize_t)sizeof(magic);
+}
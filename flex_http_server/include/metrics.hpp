@@ -0,0 +1,246 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+typedef enum {
+    METRIC_HTTP_REQUESTS,
+    METRIC_PAGES_SENT,
+    METRIC_PAGES_FAILED,
+    METRIC_PAGES_DUPLICATE,
+    METRIC_PAGES_RATE_LIMITED,
+    METRIC_PAGES_BUSY,
+    METRIC_DEVICE_ERRORS,
+    METRIC_AT_RETRIES,
+    METRIC_BYTES_TRANSMITTED,
+    METRIC_LOG_DROPPED,
+    METRIC_TRACE_DROPPED,
+    METRIC_COUNTER_COUNT
+} metric_counter_t;
+
+typedef enum {
+    STAGE_ACCEPT_TO_PARSE,      // connection accepted (or request begun) until fully parsed
+    STAGE_AUTH,
+    STAGE_JSON_PARSE,
+    STAGE_ENCODE,               // tinyflex encoding
+    STAGE_DEVICE_SETUP,         // opening and initializing the device, radio parameters
+    STAGE_MODULATION,           // handing the frame to the device's modulator
+    STAGE_ON_AIR,               // until the device reports the transmission done
+    STAGE_REQUEST_TOTAL,        // HTTP request begun until its response is ready
+    STAGE_WAL_SYNC,             // one group commit of the page log
+    STAGE_COUNT
+} metric_stage_t;
+
+inline const char* metric_counter_name(metric_counter_t counter) {
+    switch (counter) {
+    case METRIC_HTTP_REQUESTS:      return "flex_http_requests_total";
+    case METRIC_PAGES_SENT:         return "flex_pages_sent_total";
+    case METRIC_PAGES_FAILED:       return "flex_pages_failed_total";
+    case METRIC_PAGES_DUPLICATE:    return "flex_pages_duplicate_total";
+    case METRIC_PAGES_RATE_LIMITED: return "flex_pages_rate_limited_total";
+    case METRIC_PAGES_BUSY:         return "flex_pages_refused_busy_total";
+    case METRIC_DEVICE_ERRORS:      return "flex_device_errors_total";
+    case METRIC_AT_RETRIES:         return "flex_at_retries_total";
+    case METRIC_BYTES_TRANSMITTED:  return "flex_transmitted_bytes_total";
+    case METRIC_LOG_DROPPED:        return "flex_log_records_dropped_total";
+    case METRIC_TRACE_DROPPED:      return "flex_trace_spans_dropped_total";
+    case METRIC_COUNTER_COUNT:      break;
+    }
+    return "unknown";
+}
+
+inline const char* metric_counter_help(metric_counter_t counter) {
+    switch (counter) {
+    case METRIC_HTTP_REQUESTS:      return "HTTP requests handled";
+    case METRIC_PAGES_SENT:         return "Pages transmitted";
+    case METRIC_PAGES_FAILED:       return "Pages that could not be encoded or transmitted";
+    case METRIC_PAGES_DUPLICATE:    return "Pages merged into an identical queued page";
+    case METRIC_PAGES_RATE_LIMITED: return "Pages refused by a rate limit";
+    case METRIC_PAGES_BUSY:         return "Pages refused because the transmitter was saturated";
+    case METRIC_DEVICE_ERRORS:      return "Failures opening, initializing or sending to the FLEX device";
+    case METRIC_AT_RETRIES:         return "AT commands and sends retried";
+    case METRIC_BYTES_TRANSMITTED:  return "Encoded FLEX bytes transmitted";
+    case METRIC_LOG_DROPPED:        return "Log records dropped because a thread's log buffer was full";
+    case METRIC_TRACE_DROPPED:      return "Trace spans dropped because a thread's trace buffer was full";
+    case METRIC_COUNTER_COUNT:      break;
+    }
+    return "";
+}
+
+inline const char* metric_stage_name(metric_stage_t stage) {
+    switch (stage) {
+    case STAGE_ACCEPT_TO_PARSE: return "accept_to_parse";
+    case STAGE_AUTH:            return "auth";
+    case STAGE_JSON_PARSE:      return "json_parse";
+    case STAGE_ENCODE:          return "encode";
+    case STAGE_DEVICE_SETUP:    return "device_setup";
+    case STAGE_MODULATION:      return "modulation";
+    case STAGE_ON_AIR:          return "on_air";
+    case STAGE_REQUEST_TOTAL:   return "request_total";
+    case STAGE_WAL_SYNC:        return "wal_sync";
+    case STAGE_COUNT:           break;
+    }
+    return "unknown";
+}
+
+// Histogram buckets: two per power of two, from 1 us up to about 4.5 minutes
+#define HISTOGRAM_OCTAVES 28
+#define HISTOGRAM_BUCKETS (2 * HISTOGRAM_OCTAVES)
+
+/**
+ * @brief Log-linear bucket for a duration in microseconds, HDR style:
+ * the power of two plus one bit of mantissa, so every bucket is at most
+ * 50% wider than the values in it. Values past the last bucket return
+ * HISTOGRAM_BUCKETS and only show up in +Inf.
+ */
+inline size_t histogram_bucket(uint64_t us) {
+    if (us < 2) {
+        return static_cast<size_t>(us);
+    }
+    unsigned octave = 63 - __builtin_clzll(us);
+    size_t index = 2 * octave + ((us >> (octave - 1)) & 1);
+    return index < HISTOGRAM_BUCKETS ? index : HISTOGRAM_BUCKETS;
+}
+
+// Largest value in microseconds that lands in bucket index
+inline uint64_t histogram_bucket_limit(size_t index) {
+    if (index < 2) {
+        return index;
+    }
+    unsigned octave = static_cast<unsigned>(index / 2);
+    return (1ULL << octave) + ((index % 2) + 1) * (1ULL << (octave - 1)) - 1;
+}
+
+/**
+ * @brief One thread's counters and histograms.
+ *
+ * Only the owning thread writes, so updates are a relaxed load and store
+ * with no locked instruction or shared cache line; a scrape reads every
+ * shard and adds them up, possibly a moment behind the writers.
+ */
+struct MetricsShard {
+    std::atomic<uint64_t> counters[METRIC_COUNTER_COUNT];
+    std::atomic<uint64_t> buckets[STAGE_COUNT][HISTOGRAM_BUCKETS + 1];
+    std::atomic<uint64_t> sum_us[STAGE_COUNT];
+
+    MetricsShard() {
+        for (auto& counter : counters) {
+            counter.store(0, std::memory_order_relaxed);
+        }
+        for (auto& stage : buckets) {
+            for (auto& bucket : stage) {
+                bucket.store(0, std::memory_order_relaxed);
+            }
+        }
+        for (auto& sum : sum_us) {
+            sum.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    static void bump(std::atomic<uint64_t>& value, uint64_t n) {
+        value.store(value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+};
+
+/**
+ * @brief Process-wide registry of per-thread shards. A thread gets its shard
+ * on first use; the lock is taken only then and while rendering. Shards
+ * outlive their threads so totals never go backwards.
+ */
+class Metrics {
+public:
+    MetricsShard& local() {
+        thread_local MetricsShard* shard = nullptr;
+        if (!shard) {
+            std::lock_guard<std::mutex> lock(mutex);
+            shards.push_back(std::unique_ptr<MetricsShard>(new MetricsShard()));
+            shard = shards.back().get();
+        }
+        return *shard;
+    }
+
+    // Counters and histograms in the Prometheus text format
+    std::string render() {
+        uint64_t counters[METRIC_COUNTER_COUNT] = {0};
+        std::vector<uint64_t> buckets(STAGE_COUNT * (HISTOGRAM_BUCKETS + 1), 0);
+        uint64_t sum_us[STAGE_COUNT] = {0};
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (const auto& shard : shards) {
+                for (size_t c = 0; c < METRIC_COUNTER_COUNT; ++c) {
+                    counters[c] += shard->counters[c].load(std::memory_order_relaxed);
+                }
+                for (size_t s = 0; s < STAGE_COUNT; ++s) {
+                    for (size_t b = 0; b <= HISTOGRAM_BUCKETS; ++b) {
+                        buckets[s * (HISTOGRAM_BUCKETS + 1) + b] +=
+                            shard->buckets[s][b].load(std::memory_order_relaxed);
+                    }
+                    sum_us[s] += shard->sum_us[s].load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+        std::string out;
+        char line[256];
+        for (size_t c = 0; c < METRIC_COUNTER_COUNT; ++c) {
+            metric_counter_t counter = static_cast<metric_counter_t>(c);
+            out += std::string("# HELP ") + metric_counter_name(counter) + " " + metric_counter_help(counter) + "\n";
+            out += std::string("# TYPE ") + metric_counter_name(counter) + " counter\n";
+            snprintf(line, sizeof(line), "%s %llu\n", metric_counter_name(counter), (unsigned long long)counters[c]);
+            out += line;
+        }
+
+        out += "# HELP flex_stage_duration_seconds Time spent in each stage of handling a page\n";
+        out += "# TYPE flex_stage_duration_seconds histogram\n";
+        for (size_t s = 0; s < STAGE_COUNT; ++s) {
+            const char* stage = metric_stage_name(static_cast<metric_stage_t>(s));
+            uint64_t cumulative = 0;
+            for (size_t b = 0; b < HISTOGRAM_BUCKETS; ++b) {
+                cumulative += buckets[s * (HISTOGRAM_BUCKETS + 1) + b];
+                snprintf(line, sizeof(line), "flex_stage_duration_seconds_bucket{stage=\"%s\",le=\"%.9g\"} %llu\n",
+                         stage, histogram_bucket_limit(b) / 1e6, (unsigned long long)cumulative);
+                out += line;
+            }
+            cumulative += buckets[s * (HISTOGRAM_BUCKETS + 1) + HISTOGRAM_BUCKETS];
+            snprintf(line, sizeof(line),
+                     "flex_stage_duration_seconds_bucket{stage=\"%s\",le=\"+Inf\"} %llu\n"
+                     "flex_stage_duration_seconds_sum{stage=\"%s\"} %.6f\n"
+                     "flex_stage_duration_seconds_count{stage=\"%s\"} %llu\n",
+                     stage, (unsigned long long)cumulative, stage, sum_us[s] / 1e6,
+                     stage, (unsigned long long)cumulative);
+            out += line;
+        }
+        return out;
+    }
+
+private:
+    std::mutex mutex;
+    std::vector<std::unique_ptr<MetricsShard>> shards;
+};
+
+inline Metrics& metrics() {
+    static Metrics instance;
+    return instance;
+}
+
+inline void metrics_count(metric_counter_t counter, uint64_t n = 1) {
+    MetricsShard::bump(metrics().local().counters[counter], n);
+}
+
+inline void metrics_observe(metric_stage_t stage, std::chrono::steady_clock::duration elapsed) {
+    long long us = std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+    uint64_t value = us > 0 ? static_cast<uint64_t>(us) : 0;
+    MetricsShard& shard = metrics().local();
+    MetricsShard::bump(shard.buckets[stage][histogram_bucket(value)], 1);
+    MetricsShard::bump(shard.sum_us[stage], value);
+}
+
+// Records the time since started for stage
+inline void metrics_observe_since(metric_stage_t stage, std::chrono::steady_clock::time_point started) {
+    metrics_observe(stage, std::chrono::steady_clock::now() - started);
+}
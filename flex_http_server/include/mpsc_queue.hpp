@@ -0,0 +1,99 @@
+#pragma once
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <utility>
+
+/**
+ * @brief Unbounded lock-free multi-producer, single-consumer queue.
+ *
+ * Producers link a node with a single atomic exchange and never block each
+ * other; only the owning consumer thread may pop. The mutex and condition
+ * variable are used solely to park the consumer while the queue is empty,
+ * and producers only touch them when the consumer is actually asleep.
+ */
+template <typename T>
+class MpscQueue {
+public:
+    MpscQueue() : sleeping(false), stopping(false) {
+        tail = new Node();
+        head.store(tail);
+    }
+
+    ~MpscQueue() {
+        T discard;
+        while (try_pop(discard)) {
+        }
+        delete tail;
+    }
+
+    MpscQueue(const MpscQueue&) = delete;
+    MpscQueue& operator=(const MpscQueue&) = delete;
+
+    void push(T value) {
+        Node* node = new Node();
+        node->value = std::move(value);
+        Node* prev = head.exchange(node);
+        prev->next.store(node);
+
+        if (sleeping.load()) {
+            std::lock_guard<std::mutex> lock(mutex);
+            cv.notify_one();
+        }
+    }
+
+    // Consumer only. Returns false when the queue is empty.
+    bool try_pop(T& out) {
+        Node* next = tail->next.load();
+        if (!next) {
+            return false;
+        }
+        out = std::move(next->value);
+        delete tail;
+        tail = next;
+        return true;
+    }
+
+    // Consumer only. Blocks until an item arrives; returns false once stop()
+    // has been called. Items still queued at that point are discarded.
+    bool pop_wait(T& out) {
+        while (true) {
+            if (stopping.load()) {
+                return false;
+            }
+            if (try_pop(out)) {
+                return true;
+            }
+
+            std::unique_lock<std::mutex> lock(mutex);
+            sleeping.store(true);
+            cv.wait(lock, [this] { return stopping.load() || tail->next.load() != nullptr; });
+            sleeping.store(false);
+        }
+    }
+
+    bool stopped() const {
+        return stopping.load();
+    }
+
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping.store(true);
+        }
+        cv.notify_all();
+    }
+
+private:
+    struct Node {
+        std::atomic<Node*> next{nullptr};
+        T value;
+    };
+
+    std::atomic<Node*> head;    // most recently pushed node (producers)
+    Node* tail;                 // already-consumed node before the next item (consumer)
+    std::atomic<bool> sleeping;
+    std::atomic<bool> stopping;
+    std::mutex mutex;
+    std::condition_variable cv;
+};
@@ -0,0 +1,545 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "async_log.hpp"
+#include "metrics.hpp"
+#include "trace.hpp"
+
+// Size a new log file is given; it doubles when compaction cannot make room
+#define WAL_FILE_BYTES (4 * 1024 * 1024)
+
+#define WAL_MAGIC "FLEXWAL1"
+
+typedef enum {
+    WAL_SUBMIT = 1,     // page accepted; the record carries the whole page
+    WAL_START = 2,      // the radio began transmitting it
+    WAL_SENT = 3,
+    WAL_FAILED = 4
+} wal_record_t;
+
+struct WalFileHeader {
+    char magic[8];
+    uint64_t next_job_id;       // lowest ID never handed out, as of the last compaction
+};
+
+/*
+ * Record layout, 8-byte aligned. State records (start, sent, failed) only
+ * use the header with job_id set; a submit is followed by the message. The
+ * CRC covers everything after the crc field, so a record torn by a crash
+ * ends the replay instead of being read back.
+ */
+struct WalRecord {
+    uint32_t length;            // whole record; 0 marks the unused end of the file
+    uint32_t crc;
+    uint32_t type;              // wal_record_t
+    uint32_t priority;
+    uint64_t job_id;
+    uint64_t capcode;
+    uint64_t frequency;
+    int64_t queued_ms;          // Unix milliseconds
+    uint64_t trace_hi;
+    uint64_t trace_lo;
+    uint32_t message_length;
+    uint32_t reserved;
+};
+
+// A page found in the log with no outcome recorded
+struct WalPage {
+    uint64_t job_id;
+    uint64_t capcode;
+    std::string message;
+    uint64_t frequency;
+    unsigned priority;
+    TraceId trace;
+    std::chrono::system_clock::time_point queued_wall;
+    bool started;               // the radio had begun sending it when the log ended
+};
+
+inline uint32_t wal_crc32(const char* data, size_t length) {
+    static uint32_t table[256];
+    static bool table_ready = [] {
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; ++k) {
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            table[i] = c;
+        }
+        return true;
+    }();
+    (void)table_ready;
+
+    uint32_t crc = 0xFFFFFFFFu;
+    for (size_t i = 0; i < length; ++i) {
+        crc = table[(crc ^ static_cast<unsigned char>(data[i])) & 0xFF] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFFu;
+}
+
+inline size_t wal_align(size_t n) {
+    return (n + 7) & ~static_cast<size_t>(7);
+}
+
+/**
+ * @brief Append-only, memory-mapped write-ahead log of accepted pages and
+ * their state changes.
+ *
+ * Appending copies the record into the mapped file under a short lock and
+ * returns a sequence number. A committer thread makes everything appended
+ * so far durable with one fdatasync while new records keep arriving, so
+ * concurrent submitters share a commit instead of paying for one each.
+ * Submitters wait for their page's commit before acknowledging it; state
+ * records ride along with the next commit. If a commit fails, its waiters
+ * are told so and the committer rewrites the log from memory before the
+ * next one, so records whose pages the failed sync may have dropped are
+ * written again.
+ *
+ * The log keeps a copy of every page still waiting for an outcome. When the
+ * file fills up, the committer writes those pages to a fresh file, which
+ * atomically replaces the old one. Appends never wait for this: a record
+ * that no longer fits is covered by the copy, and records appended while
+ * the new file is being written are kept aside and added behind it. Opening
+ * a log replays it and compacts it the same way, handing back the pages
+ * that were never sent.
+ */
+class PageWal {
+    struct LivePage {
+        std::string record;     // its submit record, as written
+        bool started;
+    };
+
+public:
+    PageWal() : fd(-1), map(nullptr), capacity(0), used(0), next_job_id(1), appended(0), durable(0),
+                failed_through(0), compact_due(false), compacting(false), running(false), stopping(false),
+                live_bytes(0) {}
+
+    ~PageWal() {
+        close_log();
+    }
+
+    bool enabled() const {
+        return map != nullptr;
+    }
+
+    /**
+     * @brief Replays path (creating it if missing), compacts it and starts
+     * the committer. Fills pending with the pages that have no outcome yet
+     * and first_free_id with the lowest job ID never used.
+     */
+    bool open(const std::string& log_path, std::vector<WalPage>& pending, uint64_t& first_free_id,
+              std::string& error) {
+        path = log_path;
+        int old_fd = ::open(path.c_str(), O_RDONLY | O_CREAT | O_CLOEXEC, 0644);
+        if (old_fd < 0) {
+            error = strerror(errno);
+            return false;
+        }
+        struct stat st;
+        if (fstat(old_fd, &st) < 0) {
+            error = strerror(errno);
+            ::close(old_fd);
+            return false;
+        }
+
+        size_t size = static_cast<size_t>(st.st_size);
+        if (size > 0) {
+            void* old_map = mmap(nullptr, size, PROT_READ, MAP_SHARED, old_fd, 0);
+            if (old_map == MAP_FAILED) {
+                error = strerror(errno);
+                ::close(old_fd);
+                return false;
+            }
+            bool ok = replay(static_cast<const char*>(old_map), size, error);
+            munmap(old_map, size);
+            if (!ok) {
+                ::close(old_fd);
+                return false;
+            }
+        }
+        ::close(old_fd);
+
+        std::unique_lock<std::mutex> lock(mutex);
+        if (!compact(lock, error)) {
+            return false;
+        }
+
+        for (const auto& entry : live) {
+            WalRecord record;
+            memcpy(&record, entry.second.record.data(), sizeof(record));
+            WalPage page;
+            page.job_id = record.job_id;
+            page.capcode = record.capcode;
+            page.message.assign(entry.second.record.data() + sizeof(record), record.message_length);
+            page.frequency = record.frequency;
+            page.priority = record.priority;
+            page.trace.hi = record.trace_hi;
+            page.trace.lo = record.trace_lo;
+            page.queued_wall = std::chrono::system_clock::time_point(std::chrono::milliseconds(record.queued_ms));
+            page.started = entry.second.started;
+            pending.push_back(std::move(page));
+        }
+        first_free_id = next_job_id;
+
+        stopping = false;
+        running = true;
+        committer = std::thread(&PageWal::run, this);
+        return true;
+    }
+
+    // Commits whatever is still pending and closes the file
+    void close_log() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (running) {
+                stopping = true;
+            }
+        }
+        if (committer.joinable()) {
+            commit_wake.notify_one();
+            committer.join();
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        running = false;
+        unmap_locked();
+    }
+
+    // Logs an accepted page; returns the sequence number to wait for, 0 if it
+    // could not be written
+    uint64_t append_submit(uint64_t job_id, uint64_t capcode, const std::string& message, uint64_t frequency,
+                           unsigned priority, const TraceId& trace, std::chrono::system_clock::time_point queued_wall) {
+        WalRecord record;
+        memset(&record, 0, sizeof(record));
+        record.type = WAL_SUBMIT;
+        record.priority = priority;
+        record.job_id = job_id;
+        record.capcode = capcode;
+        record.frequency = frequency;
+        record.queued_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+            queued_wall.time_since_epoch()).count();
+        record.trace_hi = trace.hi;
+        record.trace_lo = trace.lo;
+        record.message_length = static_cast<uint32_t>(message.size());
+
+        std::lock_guard<std::mutex> lock(mutex);
+        return append_locked(record, message.data());
+    }
+
+    // Logs a state change; it becomes durable with the next commit
+    void append_state(uint64_t job_id, wal_record_t type) {
+        WalRecord record;
+        memset(&record, 0, sizeof(record));
+        record.type = type;
+        record.job_id = job_id;
+
+        std::lock_guard<std::mutex> lock(mutex);
+        append_locked(record, nullptr);
+    }
+
+    // Blocks until the record with sequence number seq has been committed.
+    // False if it was not written or the commit covering it failed.
+    bool wait_durable(uint64_t seq) {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (seq == 0) {
+            return false;
+        }
+        if (running) {
+            commit_wake.notify_one();
+            committed.wait(lock, [&] { return durable >= seq || !running; });
+        }
+        return durable >= seq && seq > failed_through;
+    }
+
+private:
+    // Reads every intact record; a torn or corrupt record ends the log
+    bool replay(const char* data, size_t size, std::string& error) {
+        WalFileHeader header;
+        if (size < sizeof(header) || memcmp(data, WAL_MAGIC, sizeof(header.magic)) != 0) {
+            error = "not a page log";
+            return false;
+        }
+        memcpy(&header, data, sizeof(header));
+        next_job_id = std::max<uint64_t>(next_job_id, header.next_job_id);
+
+        size_t offset = sizeof(header);
+        size_t records = 0;
+        while (offset + sizeof(WalRecord) <= size) {
+            WalRecord record;
+            memcpy(&record, data + offset, sizeof(record));
+            if (record.length == 0) {
+                break;
+            }
+            if (record.length < sizeof(record) || record.length > size - offset ||
+                sizeof(record) + record.message_length > record.length ||
+                wal_crc32(data + offset + 8, record.length - 8) != record.crc) {
+                log_warn(LOG_QUEUE, "wal_truncated").u("offset", offset).u("records", records);
+                break;
+            }
+
+            switch (record.type) {
+            case WAL_SUBMIT:
+                live[record.job_id] = LivePage{std::string(data + offset, record.length), false};
+                live_bytes += record.length;
+                next_job_id = std::max<uint64_t>(next_job_id, record.job_id + 1);
+                break;
+            case WAL_START: {
+                auto it = live.find(record.job_id);
+                if (it != live.end()) {
+                    it->second.started = true;
+                }
+                break;
+            }
+            default:
+                forget(record.job_id);
+                break;
+            }
+            offset += record.length;
+            records++;
+        }
+        return true;
+    }
+
+    uint64_t append_locked(WalRecord& record, const char* message) {
+        if (!map) {
+            return 0;
+        }
+        // State changes count even if the record is not written: the next
+        // compaction rewrites the log from the live pages
+        if (record.type == WAL_START) {
+            auto it = live.find(record.job_id);
+            if (it != live.end()) {
+                it->second.started = true;
+            }
+        } else if (record.type != WAL_SUBMIT) {
+            forget(record.job_id);
+        }
+
+        record.length = static_cast<uint32_t>(wal_align(sizeof(record) + record.message_length));
+        std::string bytes(record.length, '\0');
+        memcpy(&bytes[0], &record, sizeof(record));
+        if (record.message_length) {
+            memcpy(&bytes[sizeof(record)], message, record.message_length);
+        }
+        record.crc = wal_crc32(bytes.data() + 8, record.length - 8);
+        memcpy(&bytes[4], &record.crc, sizeof(record.crc));
+
+        if (compacting) {
+            tail += bytes;
+        } else if (used + record.length > capacity || compact_due) {
+            compact_due = true;
+        } else {
+            memcpy(map + used, bytes.data(), bytes.size());
+            used += record.length;
+        }
+
+        if (record.type == WAL_SUBMIT) {
+            live_bytes += record.length;
+            live[record.job_id] = LivePage{std::move(bytes), false};
+            next_job_id = std::max<uint64_t>(next_job_id, record.job_id + 1);
+        }
+        commit_wake.notify_one();
+        return ++appended;
+    }
+
+    void forget(uint64_t job_id) {
+        auto it = live.find(job_id);
+        if (it != live.end()) {
+            live_bytes -= it->second.record.size();
+            live.erase(it);
+        }
+    }
+
+    /**
+     * @brief Writes the pages still waiting for an outcome to a new file, syncs
+     * it and renames it over the log. The file work is done without the lock;
+     * records appended meanwhile go to tail and are copied in behind the pages
+     * once the new file is in place, to be synced by the next commit.
+     * Everything appended before the compaction started is durable afterwards.
+     */
+    bool compact(std::unique_lock<std::mutex>& lock, std::string& error) {
+        WalRecord start_record;
+        memset(&start_record, 0, sizeof(start_record));
+        start_record.length = sizeof(start_record);
+        start_record.type = WAL_START;
+
+        WalFileHeader header;
+        memcpy(header.magic, WAL_MAGIC, sizeof(header.magic));
+        header.next_job_id = next_job_id;
+        std::string pages;
+        pages.reserve(sizeof(header) + live_bytes + live.size() * sizeof(WalRecord));
+        pages.append(reinterpret_cast<const char*>(&header), sizeof(header));
+        for (const auto& entry : live) {
+            pages += entry.second.record;
+            if (entry.second.started) {
+                start_record.job_id = entry.first;
+                start_record.crc = wal_crc32(reinterpret_cast<const char*>(&start_record) + 8, sizeof(start_record) - 8);
+                pages.append(reinterpret_cast<const char*>(&start_record), sizeof(start_record));
+            }
+        }
+        uint64_t covered = appended;
+        size_t pages_count = live.size();
+        compacting = true;
+        tail.clear();
+        lock.unlock();
+
+        size_t new_capacity = WAL_FILE_BYTES;
+        while (new_capacity < 2 * pages.size()) {
+            new_capacity *= 2;
+        }
+
+        std::string temp_path = path + ".tmp";
+        void* new_map = MAP_FAILED;
+        int new_fd = ::open(temp_path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (new_fd < 0) {
+            error = strerror(errno);
+        } else {
+            // Reserve the blocks now, so a full disk fails here rather than as SIGBUS on a later write
+            int rc = posix_fallocate(new_fd, 0, static_cast<off_t>(new_capacity));
+            new_map = rc == 0 ? mmap(nullptr, new_capacity, PROT_READ | PROT_WRITE, MAP_SHARED, new_fd, 0)
+                              : MAP_FAILED;
+            if (new_map == MAP_FAILED) {
+                error = strerror(rc ? rc : errno);
+            } else {
+                memcpy(new_map, pages.data(), pages.size());
+                if (fdatasync(new_fd) < 0 || rename(temp_path.c_str(), path.c_str()) < 0) {
+                    error = strerror(errno);
+                    munmap(new_map, new_capacity);
+                    new_map = MAP_FAILED;
+                }
+            }
+            if (new_map == MAP_FAILED) {
+                ::close(new_fd);
+                unlink(temp_path.c_str());
+            }
+        }
+        if (new_map != MAP_FAILED) {
+            sync_directory();
+        }
+
+        lock.lock();
+        compacting = false;
+        if (new_map == MAP_FAILED) {
+            tail.clear();
+            return false;
+        }
+
+        unmap_locked();
+        fd = new_fd;
+        map = static_cast<char*>(new_map);
+        capacity = new_capacity;
+        used = pages.size();
+        // Without room for the tail its records are left to the next compaction
+        compact_due = used + tail.size() > capacity;
+        if (!compact_due) {
+            memcpy(map + used, tail.data(), tail.size());
+            used += tail.size();
+        }
+        tail.clear();
+        durable = std::max(durable, covered);
+        committed.notify_all();
+        log_debug(LOG_QUEUE, "wal_compacted").u("pages", pages_count).u("bytes", used).u("capacity", capacity);
+        return true;
+    }
+
+    // Makes the rename itself durable
+    void sync_directory() {
+        size_t slash = path.rfind('/');
+        std::string dir = slash == std::string::npos ? "." : (slash == 0 ? "/" : path.substr(0, slash));
+        int dir_fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (dir_fd >= 0) {
+            fsync(dir_fd);
+            ::close(dir_fd);
+        }
+    }
+
+    void unmap_locked() {
+        if (map) {
+            munmap(map, capacity);
+            map = nullptr;
+        }
+        if (fd >= 0) {
+            ::close(fd);
+            fd = -1;
+        }
+    }
+
+    // Group commit: one fdatasync covers every record appended before it started.
+    // A log that filled up or failed to sync is compacted instead.
+    void run() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            commit_wake.wait(lock, [&] { return stopping || appended > durable; });
+            if (appended == durable) {
+                break;
+            }
+
+            if (compact_due) {
+                std::string error;
+                if (!compact(lock, error)) {
+                    // Nothing appended so far is on disk; new records try again
+                    log_error(LOG_QUEUE, "wal_write_failed").s("path", path).s("error", error);
+                    failed_through = appended;
+                    durable = appended;
+                }
+                committed.notify_all();
+                continue;
+            }
+
+            uint64_t target = appended;
+            int sync_fd = fd;
+            lock.unlock();
+            auto started = std::chrono::steady_clock::now();
+            int rc = fdatasync(sync_fd);
+            int sync_errno = errno;
+            metrics_observe_since(STAGE_WAL_SYNC, started);
+            lock.lock();
+
+            if (rc < 0) {
+                // The kernel may have dropped the unsynced pages, so nothing
+                // up to target can be trusted to be on disk
+                log_error(LOG_QUEUE, "wal_sync_failed").s("path", path).s("error", strerror(sync_errno));
+                failed_through = std::max(failed_through, target);
+                compact_due = true;
+            }
+            if (durable < target) {
+                durable = target;
+            }
+            committed.notify_all();
+        }
+    }
+
+    std::string path;
+    int fd;
+    char* map;
+    size_t capacity;
+    size_t used;
+    uint64_t next_job_id;
+
+    std::mutex mutex;
+    std::condition_variable commit_wake;    // records waiting for the committer
+    std::condition_variable committed;      // a commit or compaction finished
+    uint64_t appended;                      // sequence number of the last record written
+    uint64_t durable;                       // last sequence number the committer is done with
+    uint64_t failed_through;                // last sequence number of a failed commit
+    bool compact_due;                       // the log filled up or a commit failed: rewrite it next
+    bool compacting;                        // the committer is writing a new file
+    std::string tail;                       // records appended while it does
+    bool running;
+    bool stopping;
+    std::thread committer;
+
+    std::map<uint64_t, LivePage> live;      // pages with no outcome yet, by job ID
+    size_t live_bytes;
+};
@@ -0,0 +1,100 @@
+#pragma once
+#include <deque>
+#include <chrono>
+#include <cstdint>
+#include <utility>
+
+// Page priorities; a larger number is more urgent
+#define PRIORITY_LOW        0
+#define PRIORITY_NORMAL     1
+#define PRIORITY_HIGH       2
+#define PRIORITY_EMERGENCY  3
+#define PRIORITY_LEVELS     4
+#define PRIORITY_DEFAULT    PRIORITY_NORMAL
+
+inline const char* priority_name(unsigned priority) {
+    switch (priority) {
+    case PRIORITY_LOW:       return "low";
+    case PRIORITY_NORMAL:    return "normal";
+    case PRIORITY_HIGH:      return "high";
+    case PRIORITY_EMERGENCY: return "emergency";
+    }
+    return "unknown";
+}
+
+/**
+ * @brief One FIFO lane per priority level, served by strict priority with aging.
+ *
+ * pop() returns the head of the most urgent lane. To keep a steady stream of
+ * urgent pages from starving the rest, a waiting item counts one level higher
+ * for every aging interval it has spent queued, up to PRIORITY_HIGH, so only
+ * genuine emergency pages ever outrank everything else. Ties go to the item
+ * that has waited longest. Every lane is in arrival order, so only the lane
+ * heads need to be compared. Single-threaded.
+ */
+template <typename T>
+class PriorityLanes {
+public:
+    typedef std::chrono::steady_clock clock;
+
+    // aging_seconds = 0 disables aging (pure strict priority)
+    explicit PriorityLanes(uint32_t aging_seconds) : aging(aging_seconds), count(0) {}
+
+    void push(T item, unsigned priority, clock::time_point queued_at) {
+        if (priority >= PRIORITY_LEVELS) {
+            priority = PRIORITY_LEVELS - 1;
+        }
+        lanes[priority].push_back(Entry{std::move(item), queued_at});
+        count++;
+    }
+
+    bool empty() const {
+        return count == 0;
+    }
+
+    size_t size() const {
+        return count;
+    }
+
+    // Must not be called when empty()
+    T pop(clock::time_point now) {
+        int best = -1;
+        unsigned best_level = 0;
+        for (int lane = PRIORITY_LEVELS - 1; lane >= 0; --lane) {
+            if (lanes[lane].empty()) {
+                continue;
+            }
+            const Entry& head = lanes[lane].front();
+            unsigned level = effective_level(lane, head.queued_at, now);
+            if (best < 0 || level > best_level ||
+                (level == best_level && head.queued_at < lanes[best].front().queued_at)) {
+                best = lane;
+                best_level = level;
+            }
+        }
+
+        T item = std::move(lanes[best].front().item);
+        lanes[best].pop_front();
+        count--;
+        return item;
+    }
+
+private:
+    struct Entry {
+        T item;
+        clock::time_point queued_at;
+    };
+
+    unsigned effective_level(unsigned lane, clock::time_point queued_at, clock::time_point now) const {
+        if (aging == 0 || now <= queued_at || lane >= PRIORITY_HIGH) {
+            return lane;
+        }
+        auto waited = std::chrono::duration_cast<std::chrono::seconds>(now - queued_at).count();
+        unsigned boost = static_cast<unsigned>(waited / aging);
+        return (lane + boost > PRIORITY_HIGH) ? PRIORITY_HIGH : lane + boost;
+    }
+
+    std::deque<Entry> lanes[PRIORITY_LEVELS];
+    uint32_t aging;
+    size_t count;
+};
@@ -0,0 +1,222 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include "metrics.hpp"
+
+// Buckets per limited dimension; the least indebted one is recycled when full
+#define RATE_LIMIT_TABLE_SLOTS 65536
+
+// Slots examined for a key before one is recycled
+#define RATE_LIMIT_PROBE 8
+
+inline uint64_t rate_limit_mix(uint64_t x) {
+    // splitmix64 finalizer, so tag and index bits are independent
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+/**
+ * @brief Fixed-size, lock-free table of token buckets for one dimension
+ * (users, client addresses or capcodes).
+ *
+ * Each bucket is kept as a GCRA "theoretical arrival time": the moment the
+ * bucket would be full again. A bucket with a TAT in the past is full, so it
+ * is indistinguishable from an unused slot and may be handed to another key.
+ * The key's tag and its TAT share one 64-bit word (24-bit tag, 40-bit
+ * milliseconds since the table was created), so every update is a single
+ * compare-and-swap and lookups never take a lock. Two keys with the same
+ * index and tag share a bucket; with 2^40 combinations that is negligible.
+ */
+class TokenBucketTable {
+public:
+    // per_minute = 0 disables the dimension
+    TokenBucketTable(uint32_t per_minute, uint32_t burst)
+        : interval_ms(per_minute ? 60000 / per_minute : 0),
+          tolerance_ms(0),
+          slots(per_minute ? new std::atomic<uint64_t>[RATE_LIMIT_TABLE_SLOTS] : nullptr) {
+        if (interval_ms == 0 && per_minute) {
+            interval_ms = 1;
+        }
+        tolerance_ms = interval_ms * (burst > 1 ? burst - 1 : 0);
+        for (size_t i = 0; slots && i < RATE_LIMIT_TABLE_SLOTS; ++i) {
+            slots[i].store(0, std::memory_order_relaxed);
+        }
+    }
+
+    bool enabled() const {
+        return interval_ms > 0;
+    }
+
+    // Milliseconds until key may send again; 0 if a token is available now
+    uint64_t wait_ms(uint64_t key, uint64_t now_ms) const {
+        uint64_t tag = tag_of(key);
+        size_t base = index_of(key);
+        for (size_t i = 0; i < RATE_LIMIT_PROBE; ++i) {
+            uint64_t word = slots[(base + i) % RATE_LIMIT_TABLE_SLOTS].load(std::memory_order_acquire);
+            if (word != 0 && (word >> TAT_BITS) == tag) {
+                uint64_t tat = word & TAT_MASK;
+                return (tat > now_ms + tolerance_ms) ? tat - now_ms - tolerance_ms : 0;
+            }
+        }
+        return 0;
+    }
+
+    // Spends one token of key's bucket
+    void take(uint64_t key, uint64_t now_ms) {
+        uint64_t tag = tag_of(key);
+        size_t base = index_of(key);
+
+        while (true) {
+            std::atomic<uint64_t>* own = nullptr;
+            std::atomic<uint64_t>* spare = nullptr;
+            uint64_t own_word = 0;
+            uint64_t spare_word = 0;
+
+            for (size_t i = 0; i < RATE_LIMIT_PROBE; ++i) {
+                std::atomic<uint64_t>& slot = slots[(base + i) % RATE_LIMIT_TABLE_SLOTS];
+                uint64_t word = slot.load(std::memory_order_acquire);
+                if (word != 0 && (word >> TAT_BITS) == tag) {
+                    own = &slot;
+                    own_word = word;
+                    break;
+                }
+                // Prefer an empty or full bucket, otherwise the one closest to full
+                if (!spare || (word & TAT_MASK) < (spare_word & TAT_MASK)) {
+                    spare = &slot;
+                    spare_word = word;
+                }
+            }
+
+            std::atomic<uint64_t>* slot = own ? own : spare;
+            uint64_t expected = own ? own_word : spare_word;
+            uint64_t tat = own ? (own_word & TAT_MASK) : 0;
+            if (tat < now_ms) {
+                tat = now_ms;
+            }
+            uint64_t word = (tag << TAT_BITS) | ((tat + interval_ms) & TAT_MASK);
+            if (slot->compare_exchange_weak(expected, word, std::memory_order_acq_rel)) {
+                return;
+            }
+        }
+    }
+
+    // Gives back a token taken for a page that was then refused
+    void give_back(uint64_t key) {
+        uint64_t tag = tag_of(key);
+        size_t base = index_of(key);
+        for (size_t i = 0; i < RATE_LIMIT_PROBE; ++i) {
+            std::atomic<uint64_t>& slot = slots[(base + i) % RATE_LIMIT_TABLE_SLOTS];
+            uint64_t word = slot.load(std::memory_order_acquire);
+            while (word != 0 && (word >> TAT_BITS) == tag) {
+                uint64_t tat = word & TAT_MASK;
+                uint64_t earlier = (tag << TAT_BITS) | (tat > interval_ms ? tat - interval_ms : 0);
+                if (slot.compare_exchange_weak(word, earlier, std::memory_order_acq_rel)) {
+                    return;
+                }
+            }
+        }
+    }
+
+private:
+    static const unsigned TAT_BITS = 40;
+    static const uint64_t TAT_MASK = (1ULL << TAT_BITS) - 1;
+
+    static uint64_t tag_of(uint64_t key) {
+        return (key >> TAT_BITS) | 1;   // never 0, so a used slot is never all zero
+    }
+
+    static size_t index_of(uint64_t key) {
+        return key % RATE_LIMIT_TABLE_SLOTS;
+    }
+
+    uint64_t interval_ms;       // time to earn one token
+    uint64_t tolerance_ms;      // burst allowance beyond one token
+    std::unique_ptr<std::atomic<uint64_t>[]> slots;
+};
+
+/**
+ * @brief Admission control for pages: one token bucket per authenticated
+ * user, per client address and per target capcode.
+ *
+ * A page is admitted only when every bucket that applies to it has a token,
+ * and then takes one from each; otherwise nothing is charged and the caller
+ * is told how long the emptiest bucket needs to refill. Pages the queue then
+ * refuses or merges into an earlier one are handed back with refund(), so
+ * only pages that are actually queued use up the budget. Safe to call from
+ * any thread. Check and charge are separate atomic steps, so clients racing
+ * on the same bucket may briefly get a page or two past the limit.
+ */
+class RateLimiter {
+public:
+    RateLimiter(uint32_t per_user, uint32_t per_ip, uint32_t per_capcode, uint32_t burst)
+        : users(per_user, burst), clients(per_ip, burst), capcodes(per_capcode, burst),
+          epoch(std::chrono::steady_clock::now()) {}
+
+    // Returns 0 when the page is admitted, otherwise the seconds to wait.
+    // An empty user (unauthenticated protocols) skips the per-user bucket.
+    uint32_t admit(const std::string& user, const std::string& client, uint64_t capcode) {
+        uint64_t now = now_ms();
+        uint64_t user_key = rate_limit_mix(std::hash<std::string>()(user));
+        uint64_t client_key = rate_limit_mix(std::hash<std::string>()(client));
+        uint64_t capcode_key = rate_limit_mix(capcode);
+        bool check_user = users.enabled() && !user.empty();
+
+        uint64_t wait = 0;
+        if (check_user) {
+            wait = std::max(wait, users.wait_ms(user_key, now));
+        }
+        if (clients.enabled()) {
+            wait = std::max(wait, clients.wait_ms(client_key, now));
+        }
+        if (capcodes.enabled()) {
+            wait = std::max(wait, capcodes.wait_ms(capcode_key, now));
+        }
+        if (wait > 0) {
+            metrics_count(METRIC_PAGES_RATE_LIMITED);
+            return static_cast<uint32_t>((wait + 999) / 1000);
+        }
+
+        if (check_user) {
+            users.take(user_key, now);
+        }
+        if (clients.enabled()) {
+            clients.take(client_key, now);
+        }
+        if (capcodes.enabled()) {
+            capcodes.take(capcode_key, now);
+        }
+        return 0;
+    }
+
+    // Returns the tokens admit() took for a page that was not queued after
+    // all (transmitter busy, or a duplicate of a page already queued)
+    void refund(const std::string& user, const std::string& client, uint64_t capcode) {
+        if (users.enabled() && !user.empty()) {
+            users.give_back(rate_limit_mix(std::hash<std::string>()(user)));
+        }
+        if (clients.enabled()) {
+            clients.give_back(rate_limit_mix(std::hash<std::string>()(client)));
+        }
+        if (capcodes.enabled()) {
+            capcodes.give_back(rate_limit_mix(capcode));
+        }
+    }
+
+private:
+    uint64_t now_ms() const {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - epoch).count();
+    }
+
+    TokenBucketTable users;
+    TokenBucketTable clients;
+    TokenBucketTable capcodes;
+    std::chrono::steady_clock::time_point epoch;
+};
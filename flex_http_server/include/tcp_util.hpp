@@ -1,31 +1,62 @@
 #pragma once
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <arpa/inet.h>
 #include <cstdio>
 #include <cstring>
+#include <fcntl.h>
 #include <sys/socket.h>
 #include <unistd.h>
 #include <string>
+#include <unordered_map>
+#include <cstdint>
 
-inline int setup_tcp_server(int port, struct sockaddr_in& address, const std::string& bind_address = "127.0.0.1") {
-    int server_fd;
+// Listener tuning shared by the HTTP and serial ports
+struct TcpListenOptions {
+    int backlog;            // pending connections the kernel queues for accept()
+    bool reuse_port;        // SO_REUSEPORT: let another process bind the same port
+    int defer_accept;       // TCP_DEFER_ACCEPT seconds; wake only once data arrived (0 = off)
+    int fastopen;           // TCP_FASTOPEN queue length (0 = off)
+
+    TcpListenOptions() : backlog(128), reuse_port(false), defer_accept(0), fastopen(0) {}
+};
+
+/**
+ * Creates a non-blocking listening socket.
+ * bind_address may be IPv4 ("127.0.0.1", "0.0.0.0") or IPv6 ("::1", "::").
+ * Binding to "::" accepts both IPv6 and IPv4 clients (dual-stack).
+ */
+inline int setup_tcp_server(int port, const std::string& bind_address = "127.0.0.1",
+                            const TcpListenOptions& options = TcpListenOptions()) {
+    struct sockaddr_storage address;
+    socklen_t address_len;
     int opt = 1;
 
     memset(&address, 0, sizeof(address));
-    address.sin_family = AF_INET;
-    address.sin_port = htons(port);
+    struct sockaddr_in* v4 = (struct sockaddr_in*)&address;
+    struct sockaddr_in6* v6 = (struct sockaddr_in6*)&address;
 
     // Convert bind address string to network format
     if (bind_address == "0.0.0.0" || bind_address.empty()) {
-        address.sin_addr.s_addr = INADDR_ANY;
+        v4->sin_family = AF_INET;
+        v4->sin_port = htons(port);
+        v4->sin_addr.s_addr = INADDR_ANY;
+        address_len = sizeof(*v4);
+    } else if (inet_pton(AF_INET, bind_address.c_str(), &v4->sin_addr) == 1) {
+        v4->sin_family = AF_INET;
+        v4->sin_port = htons(port);
+        address_len = sizeof(*v4);
+    } else if (inet_pton(AF_INET6, bind_address.c_str(), &v6->sin6_addr) == 1) {
+        v6->sin6_family = AF_INET6;
+        v6->sin6_port = htons(port);
+        address_len = sizeof(*v6);
     } else {
-        if (inet_pton(AF_INET, bind_address.c_str(), &address.sin_addr) <= 0) {
-            fprintf(stderr, "Invalid bind address: %s\n", bind_address.c_str());
-            return -1;
-        }
+        fprintf(stderr, "Invalid bind address: %s\n", bind_address.c_str());
+        return -1;
     }
 
-    if ((server_fd = socket(AF_INET, SOCK_STREAM, 0)) == 0) {
+    int server_fd = socket(address.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (server_fd < 0) {
         perror("socket failed");
         return -1;
     }
@@ -36,13 +67,35 @@ inline int setup_tcp_server(int port, struct sockaddr_in& address, const std::st
         return -1;
     }
 
-    if (bind(server_fd, (struct sockaddr *)&address, sizeof(address)) < 0) {
+    if (options.reuse_port && setsockopt(server_fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt))) {
+        perror("setsockopt SO_REUSEPORT");
+        close(server_fd);
+        return -1;
+    }
+
+    if (address.ss_family == AF_INET6) {
+        // "::" serves IPv4 clients too; any specific IPv6 address only itself
+        int v6only = IN6_IS_ADDR_UNSPECIFIED(&v6->sin6_addr) ? 0 : 1;
+        setsockopt(server_fd, IPPROTO_IPV6, IPV6_V6ONLY, &v6only, sizeof(v6only));
+    }
+
+    if (bind(server_fd, (struct sockaddr *)&address, address_len) < 0) {
         perror("bind failed");
         close(server_fd);
         return -1;
     }
 
-    if (listen(server_fd, 1) < 0) {
+    // Both are optimizations; carry on without them if the kernel refuses
+    if (options.defer_accept > 0 &&
+        setsockopt(server_fd, IPPROTO_TCP, TCP_DEFER_ACCEPT, &options.defer_accept, sizeof(options.defer_accept))) {
+        perror("setsockopt TCP_DEFER_ACCEPT");
+    }
+    if (options.fastopen > 0 &&
+        setsockopt(server_fd, IPPROTO_TCP, TCP_FASTOPEN, &options.fastopen, sizeof(options.fastopen))) {
+        perror("setsockopt TCP_FASTOPEN");
+    }
+
+    if (listen(server_fd, options.backlog) < 0) {
         perror("listen");
         close(server_fd);
         return -1;
@@ -50,3 +103,69 @@ inline int setup_tcp_server(int port, struct sockaddr_in& address, const std::st
 
     return server_fd;
 }
+
+/**
+ * Accepts one pending connection as a non-blocking socket and formats the
+ * peer address. IPv4 clients of a dual-stack listener are reported as plain
+ * IPv4. Returns -1 when nothing is pending (errno EAGAIN) or on error.
+ */
+inline int accept_tcp_client(int server_fd, std::string& client_ip, int& client_port) {
+    struct sockaddr_storage address;
+    socklen_t address_len = sizeof(address);
+
+    int client_fd = accept4(server_fd, (struct sockaddr *)&address, &address_len, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (client_fd < 0) {
+        return -1;
+    }
+
+    char ip[INET6_ADDRSTRLEN] = {0};
+    client_port = 0;
+    if (address.ss_family == AF_INET) {
+        struct sockaddr_in* v4 = (struct sockaddr_in*)&address;
+        inet_ntop(AF_INET, &v4->sin_addr, ip, sizeof(ip));
+        client_port = ntohs(v4->sin_port);
+    } else if (address.ss_family == AF_INET6) {
+        struct sockaddr_in6* v6 = (struct sockaddr_in6*)&address;
+        if (IN6_IS_ADDR_V4MAPPED(&v6->sin6_addr)) {
+            inet_ntop(AF_INET, &v6->sin6_addr.s6_addr[12], ip, sizeof(ip));
+        } else {
+            inet_ntop(AF_INET6, &v6->sin6_addr, ip, sizeof(ip));
+        }
+        client_port = ntohs(v6->sin6_port);
+    }
+    client_ip = ip;
+    return client_fd;
+}
+
+/**
+ * @brief Counts open connections per client so one address cannot take
+ * every slot. Used only by the poll() loop, so it needs no locking.
+ */
+class ConnectionLimiter {
+public:
+    explicit ConnectionLimiter(uint32_t per_client) : limit(per_client) {}
+
+    // Returns false if the client already holds its share (0 = unlimited)
+    bool acquire(const std::string& client) {
+        if (limit == 0) {
+            return true;
+        }
+        uint32_t& count = open[client];
+        if (count >= limit) {
+            return false;
+        }
+        count++;
+        return true;
+    }
+
+    void release(const std::string& client) {
+        auto it = open.find(client);
+        if (it != open.end() && --it->second == 0) {
+            open.erase(it);
+        }
+    }
+
+private:
+    uint32_t limit;
+    std::unordered_map<std::string, uint32_t> open;
+};
@@ -0,0 +1,139 @@
+#pragma once
+#include <deque>
+#include <vector>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <cstdint>
+#include <cstdio>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+/**
+ * @brief Fixed-size pool of threads running queued tasks in FIFO order.
+ *
+ * stop() lets the threads finish every task already queued, then joins them.
+ */
+class ThreadPool {
+public:
+    explicit ThreadPool(size_t threads) : stopping(false) {
+        if (threads == 0) {
+            threads = 1;
+        }
+        workers.reserve(threads);
+        for (size_t i = 0; i < threads; ++i) {
+            workers.emplace_back([this] { run(); });
+        }
+    }
+
+    ~ThreadPool() {
+        stop();
+    }
+
+    void submit(std::function<void()> task) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            tasks.push_back(std::move(task));
+        }
+        cv.notify_one();
+    }
+
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (stopping) {
+                return;
+            }
+            stopping = true;
+        }
+        cv.notify_all();
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+    }
+
+    size_t size() const {
+        return workers.size();
+    }
+
+private:
+    void run() {
+        while (true) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                cv.wait(lock, [this] { return stopping || !tasks.empty(); });
+                if (tasks.empty()) {
+                    return;
+                }
+                task = std::move(tasks.front());
+                tasks.pop_front();
+            }
+            task();
+        }
+    }
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<std::function<void()>> tasks;
+    std::vector<std::thread> workers;
+    bool stopping;
+};
+
+/**
+ * @brief Hands results from worker threads back to the poll() loop.
+ *
+ * push() may be called from any thread; it wakes the loop through an
+ * eventfd that is polled alongside the sockets. The loop calls drain() when
+ * fd() becomes readable.
+ */
+template <typename T>
+class EventQueue {
+public:
+    EventQueue() {
+        event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (event_fd < 0) {
+            perror("eventfd");
+        }
+    }
+
+    ~EventQueue() {
+        if (event_fd >= 0) {
+            close(event_fd);
+        }
+    }
+
+    EventQueue(const EventQueue&) = delete;
+    EventQueue& operator=(const EventQueue&) = delete;
+
+    int fd() const {
+        return event_fd;
+    }
+
+    void push(T item) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            items.push_back(std::move(item));
+        }
+        uint64_t one = 1;
+        ssize_t written = write(event_fd, &one, sizeof(one));
+        (void)written;
+    }
+
+    std::vector<T> drain() {
+        uint64_t count;
+        ssize_t bytes = read(event_fd, &count, sizeof(count));
+        (void)bytes;
+
+        std::vector<T> out;
+        std::lock_guard<std::mutex> lock(mutex);
+        out.swap(items);
+        return out;
+    }
+
+private:
+    int event_fd;
+    std::mutex mutex;
+    std::vector<T> items;
+};
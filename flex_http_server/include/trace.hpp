@@ -0,0 +1,384 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "async_log.hpp"
+#include "metrics.hpp"
+
+// Longest span detail kept (an AT command, an auth method); the rest is cut
+#define TRACE_DETAIL_MAX 96
+
+// How long the trace writer sleeps when every ring is empty
+#define TRACE_FLUSH_MS 100
+
+/**
+ * @brief 128-bit trace ID, printed as 32 lowercase hex digits like a W3C
+ * trace-id. All zero means "no trace".
+ */
+struct TraceId {
+    uint64_t hi = 0;
+    uint64_t lo = 0;
+
+    bool valid() const {
+        return hi != 0 || lo != 0;
+    }
+
+    std::string str() const {
+        char text[33];
+        snprintf(text, sizeof(text), "%016llx%016llx", (unsigned long long)hi, (unsigned long long)lo);
+        return text;
+    }
+};
+
+inline TraceId trace_id_new() {
+    thread_local std::mt19937_64 rng(std::random_device{}());
+    TraceId id;
+    while (!id.valid()) {
+        id.hi = rng();
+        id.lo = rng();
+    }
+    return id;
+}
+
+// Takes the trace-id from a W3C "traceparent" header
+// (version-traceid-parentid-flags); false if there is none or it is malformed
+inline bool trace_id_from_traceparent(std::string_view header, TraceId& id) {
+    if (header.size() < 55 || header[2] != '-' || header[35] != '-' || header.substr(0, 2) == "ff") {
+        return false;
+    }
+    TraceId parsed;
+    const char* p = header.data() + 3;
+    if (std::from_chars(p, p + 16, parsed.hi, 16).ptr != p + 16 ||
+        std::from_chars(p + 16, p + 32, parsed.lo, 16).ptr != p + 32 || !parsed.valid()) {
+        return false;
+    }
+    id = parsed;
+    return true;
+}
+
+/*
+ * Span record, pushed through the same per-thread rings as log records.
+ * The name is a pointer, so it must be a string literal; the detail is
+ * copied and only its used part is queued.
+ */
+struct TraceRecord {
+    uint32_t size;              // whole record, as LogRing expects
+    uint32_t detail_length;
+    const char* name;
+    uint64_t trace_hi;
+    uint64_t trace_lo;
+    uint64_t job;               // 0 before the page has been queued
+    int64_t start_us;           // system clock
+    int64_t duration_us;
+    char detail[TRACE_DETAIL_MAX];
+};
+
+/**
+ * @brief Writes timed spans to a trace file in the Chrome trace event format,
+ * which chrome://tracing and Perfetto open directly.
+ *
+ * Like the logger, callers only copy a span into a ring owned by their
+ * thread and a background thread formats and appends them. The file is a
+ * JSON array of complete ("X") events that is never closed, which the trace
+ * viewers accept; a restart keeps appending to it. Spans carry their trace
+ * ID and job in args, so one page can be followed across threads.
+ */
+class Tracer {
+public:
+    Tracer() : fd(-1), pid(0), running(false), stopping(false), thread_count(0), active(false) {
+        auto wall = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        auto steady = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+        wall_offset_us = wall - steady;
+    }
+
+    ~Tracer() {
+        stop();
+    }
+
+    bool enabled() const {
+        return active.load(std::memory_order_relaxed);
+    }
+
+    // Opens (or appends to) path and starts the writer thread
+    bool start(const std::string& path, std::string& error) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (running) {
+            return true;
+        }
+        fd = open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            error = strerror(errno);
+            return false;
+        }
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size == 0) {
+            write_all("[\n");
+        }
+        pid = getpid();
+        stopping = false;
+        running = true;
+        writer = std::thread(&Tracer::run, this);
+        active.store(true, std::memory_order_relaxed);
+        return true;
+    }
+
+    // Writes every queued span and closes the file
+    void stop() {
+        active.store(false, std::memory_order_relaxed);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!running) {
+                return;
+            }
+            stopping = true;
+        }
+        wake.notify_one();
+        writer.join();
+        std::lock_guard<std::mutex> lock(mutex);
+        running = false;
+        close(fd);
+        fd = -1;
+    }
+
+    void record(const TraceId& id, uint64_t job, const char* name,
+                std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end,
+                std::string_view detail) {
+        if (!enabled() || !id.valid()) {
+            return;
+        }
+        TraceRecord span;
+        span.detail_length = static_cast<uint32_t>(std::min(detail.size(), sizeof(span.detail)));
+        span.size = static_cast<uint32_t>(offsetof(TraceRecord, detail) + log_align(span.detail_length));
+        span.name = name;
+        span.trace_hi = id.hi;
+        span.trace_lo = id.lo;
+        span.job = job;
+        span.start_us = wall_us(start);
+        span.duration_us = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+        memcpy(span.detail, detail.data(), span.detail_length);
+        local().push(reinterpret_cast<const char*>(&span), span.size);
+    }
+
+private:
+    int64_t wall_us(std::chrono::steady_clock::time_point at) const {
+        return wall_offset_us + std::chrono::duration_cast<std::chrono::microseconds>(
+            at.time_since_epoch()).count();
+    }
+
+    LogRing& local() {
+        thread_local LogRing* ring = nullptr;
+        if (!ring) {
+            std::lock_guard<std::mutex> lock(rings_mutex);
+            rings.push_back(std::unique_ptr<LogRing>(new LogRing(thread_count++)));
+            ring = rings.back().get();
+        }
+        return *ring;
+    }
+
+    void run() {
+        std::string out;
+        while (true) {
+            out.clear();
+            size_t count = drain(out);
+            write_all(out);
+            if (count > 0) {
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(mutex);
+            if (stopping) {
+                break;
+            }
+            wake.wait_for(lock, std::chrono::milliseconds(TRACE_FLUSH_MS));
+        }
+    }
+
+    size_t drain(std::string& out) {
+        std::vector<LogRing*> snapshot;
+        {
+            std::lock_guard<std::mutex> lock(rings_mutex);
+            for (const auto& ring : rings) {
+                snapshot.push_back(ring.get());
+            }
+        }
+
+        size_t count = 0;
+        for (LogRing* ring : snapshot) {
+            count += ring->drain([&](const char* record) {
+                format(record, ring->thread, out);
+            });
+
+            uint64_t dropped = ring->dropped.load(std::memory_order_relaxed);
+            if (dropped > ring->dropped_reported) {
+                metrics_count(METRIC_TRACE_DROPPED, dropped - ring->dropped_reported);
+                ring->dropped_reported = dropped;
+            }
+        }
+        return count;
+    }
+
+    void format(const char* record, unsigned thread, std::string& out) const {
+        TraceRecord span;
+        memcpy(&span, record, offsetof(TraceRecord, detail));
+        const char* detail = record + offsetof(TraceRecord, detail);
+        TraceId id;
+        id.hi = span.trace_hi;
+        id.lo = span.trace_lo;
+
+        out += "{\"name\":\"";
+        log_json_escape(out, span.name);
+        out += "\",\"cat\":\"flex\",\"ph\":\"X\",\"ts\":" + std::to_string(span.start_us) +
+               ",\"dur\":" + std::to_string(span.duration_us) +
+               ",\"pid\":" + std::to_string(pid) +
+               ",\"tid\":" + std::to_string(thread) +
+               ",\"args\":{\"trace_id\":\"" + id.str() + "\"";
+        if (span.job) {
+            out += ",\"job\":" + std::to_string(span.job);
+        }
+        if (span.detail_length) {
+            out += ",\"detail\":\"";
+            log_json_escape(out, std::string_view(detail, span.detail_length));
+            out += "\"";
+        }
+        out += "}},\n";
+    }
+
+    void write_all(const std::string& out) {
+        size_t written = 0;
+        while (written < out.size()) {
+            ssize_t n = write(fd, out.data() + written, out.size() - written);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                return;
+            }
+            written += static_cast<size_t>(n);
+        }
+    }
+
+    int fd;
+    pid_t pid;
+    int64_t wall_offset_us;             // system clock minus steady clock
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::thread writer;
+    bool running;
+    bool stopping;
+
+    std::mutex rings_mutex;
+    std::vector<std::unique_ptr<LogRing>> rings;
+    unsigned thread_count;
+
+    std::atomic<bool> active;
+};
+
+inline Tracer& tracer() {
+    static Tracer instance;
+    return instance;
+}
+
+// The trace (and job, once known) that spans on this thread belong to
+struct TraceContext {
+    TraceId id;
+    uint64_t job = 0;
+};
+
+inline TraceContext& trace_context() {
+    thread_local TraceContext context;
+    return context;
+}
+
+/**
+ * @brief Makes a page's trace current on this thread until the scope ends,
+ * so the functions it calls can open spans without being passed the ID.
+ */
+class TraceScope {
+public:
+    TraceScope(const TraceId& id, uint64_t job) : saved(trace_context()) {
+        trace_context().id = id;
+        trace_context().job = job;
+    }
+
+    ~TraceScope() {
+        trace_context() = saved;
+    }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    TraceContext saved;
+};
+
+// Records a span whose start and end were measured elsewhere
+inline void trace_span(const TraceId& id, uint64_t job, const char* name,
+                       std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end,
+                       std::string_view detail = std::string_view()) {
+    tracer().record(id, job, name, start, end, detail);
+}
+
+/**
+ * @brief Times the enclosing block as a span of the current trace:
+ *
+ *     TraceSpan span("device_init");
+ *
+ * or until end() is called. Does nothing (beyond one flag check) when tracing is off or the thread
+ * has no current trace. The name must be a string literal.
+ */
+class TraceSpan {
+public:
+    explicit TraceSpan(const char* span_name, std::string_view span_detail = std::string_view())
+        : name(span_name), active(tracer().enabled() && trace_context().id.valid()), detail_length(0) {
+        if (!active) {
+            return;
+        }
+        detail_length = std::min(span_detail.size(), sizeof(detail));
+        memcpy(detail, span_detail.data(), detail_length);
+        started = std::chrono::steady_clock::now();
+    }
+
+    ~TraceSpan() {
+        end();
+    }
+
+    // Closes the span before the end of the block
+    void end() {
+        if (active) {
+            const TraceContext& context = trace_context();
+            tracer().record(context.id, context.job, name, started, std::chrono::steady_clock::now(),
+                            std::string_view(detail, detail_length));
+            active = false;
+        }
+    }
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+private:
+    const char* name;
+    bool active;
+    size_t detail_length;
+    char detail[TRACE_DETAIL_MAX];
+    std::chrono::steady_clock::time_point started;
+};
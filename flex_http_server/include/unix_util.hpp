@@ -0,0 +1,171 @@
+#pragma once
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <pwd.h>
+#include <grp.h>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <set>
+#include <vector>
+#include <sstream>
+#include <iostream>
+
+/**
+ * Creates a non-blocking AF_UNIX stream listener at path with the given
+ * file mode. A stale socket left by a previous run is removed first; any
+ * other kind of file at path is left alone and reported as an error.
+ */
+inline int setup_unix_server(const std::string& path, mode_t mode, int backlog) {
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(address.sun_path)) {
+        fprintf(stderr, "Invalid unix socket path: %s\n", path.c_str());
+        return -1;
+    }
+    strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+
+    struct stat st;
+    if (lstat(path.c_str(), &st) == 0) {
+        if (!S_ISSOCK(st.st_mode)) {
+            fprintf(stderr, "Refusing to replace non-socket file: %s\n", path.c_str());
+            return -1;
+        }
+        unlink(path.c_str());
+    }
+
+    int server_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (server_fd < 0) {
+        perror("socket failed");
+        return -1;
+    }
+
+    // Create the file with no access and open it up once it is configured
+    mode_t old_umask = umask(0777);
+    int rc = bind(server_fd, (struct sockaddr *)&address, sizeof(address));
+    umask(old_umask);
+    if (rc < 0) {
+        perror("bind failed");
+        close(server_fd);
+        return -1;
+    }
+
+    if (chmod(path.c_str(), mode) < 0) {
+        perror("chmod");
+        close(server_fd);
+        unlink(path.c_str());
+        return -1;
+    }
+
+    if (listen(server_fd, backlog) < 0) {
+        perror("listen");
+        close(server_fd);
+        unlink(path.c_str());
+        return -1;
+    }
+
+    return server_fd;
+}
+
+/**
+ * Accepts one pending local connection as a non-blocking socket and reads
+ * the peer's credentials. Returns -1 when nothing is pending or on error.
+ */
+inline int accept_unix_client(int server_fd, struct ucred& peer) {
+    int client_fd = accept4(server_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (client_fd < 0) {
+        return -1;
+    }
+
+    socklen_t len = sizeof(peer);
+    if (getsockopt(client_fd, SOL_SOCKET, SO_PEERCRED, &peer, &len) < 0) {
+        perror("getsockopt SO_PEERCRED");
+        close(client_fd);
+        return -1;
+    }
+    return client_fd;
+}
+
+inline std::string unix_user_name(uid_t uid) {
+    struct passwd* pw = getpwuid(uid);
+    return pw ? std::string(pw->pw_name) : std::to_string(uid);
+}
+
+/**
+ * Which local users may use the unix sockets, on top of the file mode.
+ * Built from a comma-separated list of user names and "@group" entries;
+ * an empty list admits everyone who can open the socket. root and the
+ * server's own user are always admitted.
+ */
+class UnixPeerPolicy {
+public:
+    bool load(const std::string& spec) {
+        uids.clear();
+        gids.clear();
+
+        std::istringstream list(spec);
+        std::string entry;
+        while (std::getline(list, entry, ',')) {
+            size_t start = entry.find_first_not_of(" \t");
+            size_t end = entry.find_last_not_of(" \t");
+            if (start == std::string::npos) {
+                continue;
+            }
+            entry = entry.substr(start, end - start + 1);
+
+            if (entry[0] == '@') {
+                struct group* gr = getgrnam(entry.c_str() + 1);
+                if (!gr) {
+                    std::cerr << "Unknown group in UNIX_SOCKET_ALLOW: " << entry << std::endl;
+                    return false;
+                }
+                gids.insert(gr->gr_gid);
+            } else {
+                struct passwd* pw = getpwnam(entry.c_str());
+                if (!pw) {
+                    std::cerr << "Unknown user in UNIX_SOCKET_ALLOW: " << entry << std::endl;
+                    return false;
+                }
+                uids.insert(pw->pw_uid);
+            }
+        }
+        return true;
+    }
+
+    bool allows(const struct ucred& peer) const {
+        if ((uids.empty() && gids.empty()) || peer.uid == 0 || peer.uid == getuid()) {
+            return true;
+        }
+        if (uids.count(peer.uid) || gids.count(peer.gid)) {
+            return true;
+        }
+        if (gids.empty()) {
+            return false;
+        }
+
+        // Supplementary groups of the peer's user
+        struct passwd* pw = getpwuid(peer.uid);
+        if (!pw) {
+            return false;
+        }
+        int count = 64;
+        std::vector<gid_t> groups(count);
+        if (getgrouplist(pw->pw_name, pw->pw_gid, groups.data(), &count) < 0) {
+            groups.resize(count);
+            getgrouplist(pw->pw_name, pw->pw_gid, groups.data(), &count);
+        }
+        for (int i = 0; i < count && i < (int)groups.size(); ++i) {
+            if (gids.count(groups[i])) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    std::set<uid_t> uids;
+    std::set<gid_t> gids;
+};
@@ -5,7 +5,11 @@
 #include <cstdlib>
 #include <chrono>
 #include <thread>
-#include <sys/select.h>
+#include <map>
+#include <memory>
+#include <algorithm>
+#include <atomic>
+#include <vector>
 #include <errno.h>
 #include <iomanip>
 #include <arpa/inet.h>
@@ -13,11 +17,26 @@
 #include <termios.h>
 #include <poll.h>
 #include <signal.h>
+#include <charconv>
 #include "../tinyflex/tinyflex.h"
 #include "include/config.hpp"
 #include "include/tcp_util.hpp"
+#include "include/unix_util.hpp"
 #include "include/http_util.hpp"
 #include "include/flex_at_util.hpp"
+#include "include/job_queue.hpp"
+#include "include/auth_cache.hpp"
+#include "include/api_tokens.hpp"
+#include "include/thread_pool.hpp"
+#include "include/mpsc_queue.hpp"
+#include "include/binary_protocol.hpp"
+#include "include/rate_limiter.hpp"
+#include "include/metrics.hpp"
+#include "include/async_log.hpp"
+#include "include/trace.hpp"
+#include "include/page_wal.hpp"
+#include "include/listen_fds.hpp"
+#include "include/file_watch.hpp"
 
 void print_help() {
     std::cout << "flex_http_server - FLEX paging HTTP/TCP server for FLEX-FSK-TX with AT commands\n";
@@ -47,11 +66,48 @@ void print_help() {
     std::cout << "    BIND_ADDRESS        - IP address to bind to (default: 127.0.0.1)\n";
     std::cout << "    SERIAL_LISTEN_PORT  - TCP port for serial protocol (default: 16175, 0 = disabled)\n";
     std::cout << "    HTTP_LISTEN_PORT    - HTTP port for JSON API (default: 16180, 0 = disabled)\n";
+    std::cout << "    BINARY_LISTEN_PORT  - TCP port for binary protocol (default: 0 = disabled)\n";
     std::cout << "    HTTP_AUTH_CREDENTIALS - Password file path (default: passwords)\n";
     std::cout << "    FLEX_DEVICE         - Serial device path (default: /dev/ttyUSB0)\n";
     std::cout << "    FLEX_BAUDRATE       - Serial baudrate (default: 115200)\n";
     std::cout << "    FLEX_POWER          - TX power level (default: 2, range: 2-20)\n";
-    std::cout << "    DEFAULT_FREQUENCY   - Default frequency Hz (default: 916000000)\n\n";
+    std::cout << "    DEFAULT_FREQUENCY   - Default frequency Hz (default: 916000000)\n";
+    std::cout << "    HTTP_KEEPALIVE_TIMEOUT - Idle seconds before a persistent HTTP connection is closed (default: 5)\n";
+    std::cout << "    HTTP_KEEPALIVE_MAX_REQUESTS - Requests served per HTTP connection (default: 100, 1 = no keep-alive)\n";
+    std::cout << "    HTTP_AUTH_CACHE_TTL - Seconds a verified login is cached (default: 300, 0 = disabled)\n";
+    std::cout << "    HTTP_AUTH_CACHE_SIZE - Maximum number of cached logins (default: 1024)\n";
+    std::cout << "    HTTP_API_TOKENS     - Bearer token file for machine clients (default: tokens)\n";
+    std::cout << "    HTTP_WORKER_THREADS - Threads for HTTP auth and parsing (default: 2)\n";
+    std::cout << "    ENCODER_THREADS     - Threads encoding FLEX frames for the radio (default: 1)\n";
+    std::cout << "    LISTEN_BACKLOG      - Pending connections queued by the kernel per port (default: 128)\n";
+    std::cout << "    LISTEN_REUSEPORT    - 1 = set SO_REUSEPORT so another instance can share the ports (default: 0)\n";
+    std::cout << "    LISTEN_DEFER_ACCEPT - TCP_DEFER_ACCEPT seconds, 0 = off (default: 0)\n";
+    std::cout << "    LISTEN_FASTOPEN     - TCP_FASTOPEN queue length, 0 = off (default: 0)\n";
+    std::cout << "    HTTP_UNIX_SOCKET    - Unix socket path for the HTTP API, empty = disabled (default: empty)\n";
+    std::cout << "    SERIAL_UNIX_SOCKET  - Unix socket path for the serial protocol, empty = disabled (default: empty)\n";
+    std::cout << "    UNIX_SOCKET_MODE    - File mode of the unix sockets, octal (default: 0660)\n";
+    std::cout << "    UNIX_SOCKET_ALLOW   - Local users/@groups allowed on the unix sockets (default: any)\n";
+    std::cout << "    HTTP_HEADER_TIMEOUT - Seconds a client has to send request headers (default: 10)\n";
+    std::cout << "    HTTP_BODY_TIMEOUT   - Seconds a client has to send a request body (default: 30)\n";
+    std::cout << "    HTTP_MAX_HEADER_SIZE - Largest request line plus headers in bytes (default: 8192)\n";
+    std::cout << "    HTTP_MAX_BODY_SIZE  - Largest request body in bytes (default: 1048576)\n";
+    std::cout << "    MAX_CONNECTIONS_PER_IP - Open connections per client IP, all ports, 0 = unlimited (default: 32)\n";
+    std::cout << "    PRIORITY_AGING_SECONDS - Seconds per priority level a waiting page gains, 0 = strict (default: 60)\n";
+    std::cout << "    DEDUP_WINDOW_SECONDS - Seconds an identical page is merged into the earlier job, 0 = off (default: 60)\n";
+    std::cout << "    RATE_LIMIT_PER_USER - Pages per minute per authenticated user, 0 = unlimited (default: 60)\n";
+    std::cout << "    RATE_LIMIT_PER_IP   - Pages per minute per client address, 0 = unlimited (default: 60)\n";
+    std::cout << "    RATE_LIMIT_PER_CAPCODE - Pages per minute per capcode, 0 = unlimited (default: 12)\n";
+    std::cout << "    RATE_LIMIT_BURST    - Pages a client may send at once before the rates apply (default: 20)\n";
+    std::cout << "    FLEX_BITRATE        - FLEX bitrate used to estimate airtime (default: 1600)\n";
+    std::cout << "    TRANSMIT_OVERHEAD_MS - Initial estimate of per-page device overhead, refined as pages are sent (default: 3000)\n";
+    std::cout << "    QUEUE_SLA_SECONDS   - Refuse pages that would wait longer than this, 0 = never (default: 300)\n";
+    std::cout << "    MAX_QUEUED_PAGES    - Most pages waiting for the transmitter, 0 = unlimited (default: 1000)\n";
+    std::cout << "    LOG_LEVELS          - Log level for all components and per component, e.g. info,radio=debug,at=trace (default: info)\n";
+    std::cout << "    TRACE_FILE          - Append per-page span timings to this file in Chrome trace format (default: off)\n";
+    std::cout << "    READY_QUEUE_THRESHOLD - GET /ready fails once this many pages are waiting, 0 = never (default: 100)\n";
+    std::cout << "    WAL_FILE            - Write-ahead log of accepted pages, requeued after a restart (default: off)\n";
+    std::cout << "    SHUTDOWN_DRAIN_SECONDS - Seconds to keep sending queued pages on SIGTERM (default: 20)\n";
+    std::cout << "    HANDOFF_SOCKET      - Unix socket a replacement process takes the listeners over from (default: off)\n\n";
 
     std::cout << "FLEX-FSK-TX HARDWARE:\n";
     std::cout << "  This server communicates with devices running flex-fsk-tx firmware using AT commands.\n";
@@ -71,7 +127,9 @@ void print_help() {
     std::cout << "  Example: echo '001122334|Hello World|916000000' | nc localhost 16175\n\n";
 
     std::cout << "HTTP PROTOCOL (JSON API) - Modern REST API:\n";
-    std::cout << "  Endpoint: POST http://localhost:16180/\n";
+    std::cout << "  Endpoint: POST http://localhost:16180/ (queues the page, returns a job ID)\n";
+    std::cout << "  Status:   GET  http://localhost:16180/messages/{id}\n";
+    std::cout << "  Batch:    POST http://localhost:16180/messages/batch (JSON array or NDJSON)\n";
     std::cout << "  Authentication: HTTP Basic Auth (required)\n";
     std::cout << "  Content-Type: application/json\n\n";
 
@@ -83,10 +141,12 @@ void print_help() {
     std::cout << "  }\n\n";
 
     std::cout << "  HTTP Response Codes (AWS Lambda Compatible):\n";
-    std::cout << "    200 OK                - Message transmitted successfully\n";
+    std::cout << "    202 Accepted          - Message queued for transmission (body carries job ID)\n";
+    std::cout << "    200 OK                - Job status returned (GET /messages/{id})\n";
     std::cout << "    400 Bad Request       - Invalid JSON or missing required fields\n";
     std::cout << "    401 Unauthorized      - Authentication required/failed\n";
-    std::cout << "    405 Method Not Allowed - Only POST requests supported\n";
+    std::cout << "    404 Not Found         - Unknown job ID or path\n";
+    std::cout << "    405 Method Not Allowed - Only POST and GET requests supported\n";
     std::cout << "    500 Internal Error    - Processing/transmission failure\n\n";
 
     std::cout << "EXAMPLES:\n";
@@ -99,7 +159,9 @@ void print_help() {
     std::cout << "  echo '1122334|Test Message|916000000' | nc localhost 16175\n\n";
 
     std::cout << "DEBUGGING:\n";
-    std::cout << "  --verbose: Shows all AT communication and FLEX encoding details\n";
+    std::cout << "  --verbose: Logs everything at trace level, including AT traffic and FLEX frames\n";
+    std::cout << "  Log levels can be changed while running:\n";
+    std::cout << "    curl -u admin:passw0rd -d 'radio=debug,at=trace' http://localhost:16180/log-levels\n";
     std::cout << "  --debug:   Shows commands but skips actual transmission\n\n";
 }
 
@@ -110,6 +172,15 @@ struct ConnectionState {
     ConnectionState() : first_message(true) {}
 };
 
+// What /ready reports, kept current by the radio thread and the main loop
+// so probes never wait on either
+struct ServerHealth {
+    std::atomic<bool> device_ok;    // last open and AT initialization succeeded
+    std::atomic<bool> draining;     // shutting down; no new connections
+
+    ServerHealth() : device_ok(true), draining(false) {}
+};
+
 bool should_send_emr(ConnectionState& state) {
     if (state.first_message) {
         return true;
@@ -122,126 +193,94 @@ bool should_send_emr(ConnectionState& state) {
     return duration.count() >= 10;
 }
 
-void send_emr_messages(int flex_fd, const FlexATConfig& config, bool debug_mode, bool verbose_mode) {
-    if (verbose_mode) {
-        std::cout << "EMR Transmission:" << std::endl;
-        std::cout << "  Status: STARTING EMR (Emergency Message Resynchronization)..." << std::endl;
-    }
-
+void send_emr_messages(int flex_fd, const FlexATConfig& config, bool debug_mode) {
     if (debug_mode) {
-        if (verbose_mode) {
-            std::cout << "  Status: SKIPPED (debug mode active)" << std::endl << std::endl;
-        }
+        log_debug(LOG_RADIO, "emr_skipped").s("reason", "debug mode");
         return;
     }
+    log_debug(LOG_RADIO, "emr_start");
+    TraceSpan span("emr");
 
     // EMR message is typically a short synchronization burst
     uint8_t emr_buffer[] = {0xA5, 0x5A, 0xA5, 0x5A}; // Simple sync pattern
 
-    if (send_flex_via_at_commands(flex_fd, config, emr_buffer, sizeof(emr_buffer), verbose_mode) == 0) {
-        if (verbose_mode) {
-            std::cout << "  Status: EMR COMPLETED" << std::endl << std::endl;
-        }
+    if (send_flex_via_at_commands(flex_fd, config, emr_buffer, sizeof(emr_buffer)) == 0) {
+        log_debug(LOG_RADIO, "emr_done");
     } else {
-        if (verbose_mode) {
-            std::cout << "  Status: EMR FAILED" << std::endl << std::endl;
-        }
+        log_warn(LOG_RADIO, "emr_failed");
     }
 }
 
-void log_message_processing_start(uint64_t capcode, const std::string& message, uint64_t frequency, bool verbose_mode) {
-    if (!verbose_mode) return;
-
-    std::cout << "=== Message Processing Started ===" << std::endl;
-    std::cout << "Input Parameters:" << std::endl;
-    std::cout << "  CAPCODE: " << capcode << std::endl;
-    std::cout << "  MESSAGE: '" << message << "' (" << message.length() << " characters)" << std::endl;
-    std::cout << "  FREQUENCY: " << frequency << " Hz (" << std::fixed << std::setprecision(6)
-              << (frequency / 1000000.0) << " MHz)" << std::endl << std::endl;
+void log_message_processing_start(uint64_t capcode, const std::string& message, uint64_t frequency) {
+    log_debug(LOG_ENCODER, "encode_start").u("capcode", capcode).u("frequency", frequency)
+        .u("length", message.length()).s("message", message);
 }
 
-void log_capcode_validation(uint64_t capcode, bool verbose_mode) {
-    if (!verbose_mode) return;
+void log_capcode_validation(uint64_t capcode) {
+    if (!log_enabled(LOG_ENCODER, LOG_LEVEL_TRACE)) return;
 
     int is_long;
     bool valid = is_capcode_valid(capcode, &is_long);
-
-    std::cout << "Capcode Validation:" << std::endl;
-    std::cout << "  Capcode: " << capcode << " is " << (is_long ? "LONG (32-bit)" : "SHORT (18-bit)") << std::endl;
-    std::cout << "  Status: " << (valid ? "VALID" : "INVALID") << std::endl << std::endl;
+    log_trace(LOG_ENCODER, "capcode_checked").u("capcode", capcode).b("long", is_long).b("valid", valid);
 }
 
-void log_flex_encoding(const uint8_t* flex_buffer, size_t flex_len, const std::string& message, bool verbose_mode) {
-    if (!verbose_mode) return;
-
-    std::cout << "FLEX Encoding:" << std::endl;
-    std::cout << "  Input message length: " << message.length() << " bytes" << std::endl;
-    std::cout << "  Buffer size: 1024 bytes" << std::endl;
-    std::cout << "  Encoded length: " << flex_len << " bytes" << std::endl;
-    std::cout << "  Encoding status: SUCCESS" << std::endl;
-    std::cout << "  Encoded FLEX data: ";
-
-    // Print ALL bytes in hex format
-    for (size_t i = 0; i < flex_len; ++i) {
-        if (i > 0 && i % 16 == 0) {
-            std::cout << std::endl << "                     ";
-        }
-        std::cout << std::hex << std::uppercase << std::setfill('0') << std::setw(2)
-                  << static_cast<int>(flex_buffer[i]) << " ";
-    }
-    std::cout << std::dec << std::endl << std::endl;
+void log_flex_encoding(const uint8_t* flex_buffer, size_t flex_len, const std::string& message) {
+    log_debug(LOG_ENCODER, "encoded").u("message_bytes", message.length()).u("frame_bytes", flex_len);
+    // The hex dump is only copied here; formatting happens on the log thread
+    log_trace(LOG_ENCODER, "frame").hex("data", flex_buffer, flex_len);
 }
 
-void log_flex_at_setup(uint64_t frequency, int power, const std::string& device, bool verbose_mode) {
-    if (!verbose_mode) return;
-
-    std::cout << "FLEX AT Setup:" << std::endl;
-    std::cout << "  Serial device: " << device << std::endl;
-    std::cout << "  Target frequency: " << frequency << " Hz (" << std::fixed << std::setprecision(6)
-              << (frequency / 1000000.0) << " MHz)" << std::endl;
-    std::cout << "  TX power: " << power << std::endl;
-    std::cout << "  FLEX device: READY" << std::endl << std::endl;
+void log_flex_at_setup(uint64_t frequency, int power, const std::string& device) {
+    log_debug(LOG_RADIO, "device_ready").s("device", device).u("frequency", frequency).i("power", power);
 }
 
-void log_flex_transmission_start(bool debug_mode, bool verbose_mode) {
-    if (!verbose_mode) return;
-
-    std::cout << "FLEX AT Transmission:" << std::endl;
+void log_flex_transmission_start(bool debug_mode) {
     if (debug_mode) {
-        std::cout << "  Status: SKIPPED (debug mode active)" << std::endl;
+        log_debug(LOG_RADIO, "transmit_skipped").s("reason", "debug mode");
     } else {
-        std::cout << "  Status: STARTING..." << std::endl;
+        log_debug(LOG_RADIO, "transmit_start");
     }
 }
 
-void log_flex_transmission_complete(bool debug_mode, bool verbose_mode) {
-    if (!verbose_mode) return;
-
+void log_flex_transmission_complete(bool debug_mode, bool success) {
     if (!debug_mode) {
-        std::cout << "  Status: COMPLETED" << std::endl;
+        log_debug(LOG_RADIO, "transmit_done").b("success", success);
     }
-    std::cout << "=== Message Processing Completed ===" << std::endl << std::endl;
 }
 
-bool process_message(uint64_t capcode, const std::string& message, uint64_t frequency,
-                    ConnectionState& conn_state, const Config& config,
-                    bool debug_mode, bool verbose_mode) {
-
-    log_message_processing_start(capcode, message, frequency, verbose_mode);
-
-    // Validate capcode
+// Checks that a page can be encoded and transmitted before it is queued.
+// Returns an empty string when valid, otherwise a client-facing error.
+std::string validate_message(uint64_t capcode, uint64_t frequency) {
     int is_long;
     if (!is_capcode_valid(capcode, &is_long)) {
-        std::cerr << "Invalid capcode: " << capcode << std::endl;
-        return false;
+        return "Invalid capcode";
     }
-    log_capcode_validation(capcode, verbose_mode);
-
-    // Validate frequency
     if (frequency < 1000000 || frequency > 6000000000) {
-        std::cerr << "Frequency out of valid range: " << frequency << std::endl;
+        return "Frequency out of valid range";
+    }
+    return "";
+}
+
+// A job that has been encoded and is waiting for the transmitter
+struct RadioFrame {
+    std::shared_ptr<Job> job;
+    std::vector<uint8_t> data;
+    std::chrono::steady_clock::time_point encoded_at;
+};
+
+// Encodes a page into a FLEX frame. Runs on the encoder pool.
+bool encode_message(uint64_t capcode, const std::string& message, uint64_t frequency,
+                    std::vector<uint8_t>& frame) {
+
+    log_message_processing_start(capcode, message, frequency);
+
+    std::string validation_error = validate_message(capcode, frequency);
+    if (!validation_error.empty()) {
+        log_error(LOG_ENCODER, "invalid_page").s("error", validation_error).u("capcode", capcode)
+            .u("frequency", frequency);
         return false;
     }
+    log_capcode_validation(capcode);
 
     // Encode message using TinyFlex
     uint8_t flex_buffer[1024];
@@ -249,29 +288,54 @@ bool process_message(uint64_t capcode, const std::string& message, uint64_t freq
     struct tf_message_config msg_config = {0};
     msg_config.mail_drop = 0; // Can be configured if needed
 
+    auto encode_started = std::chrono::steady_clock::now();
     size_t flex_len = tf_encode_flex_message_ex(message.c_str(), capcode, flex_buffer,
                                                sizeof(flex_buffer), &error, &msg_config);
+    metrics_observe_since(STAGE_ENCODE, encode_started);
+    trace_span(trace_context().id, trace_context().job, "encode", encode_started,
+               std::chrono::steady_clock::now());
 
     if (error < 0) {
-        std::cerr << "Error encoding message: " << error << std::endl;
+        log_error(LOG_ENCODER, "encode_failed").i("error", error).u("capcode", capcode);
         return false;
     }
-    log_flex_encoding(flex_buffer, flex_len, message, verbose_mode);
+    log_flex_encoding(flex_buffer, flex_len, message);
+
+    frame.assign(flex_buffer, flex_buffer + flex_len);
+    return true;
+}
+
+// Sends an encoded frame through the FLEX device. Runs on the radio thread,
+// which is the only owner of the transmitter.
+bool transmit_frame(const std::vector<uint8_t>& frame, uint64_t frequency,
+                    ConnectionState& conn_state, ServerHealth& health, const Config& config,
+                    bool debug_mode) {
 
     // Setup FLEX AT connection
+    auto setup_started = std::chrono::steady_clock::now();
+    TraceSpan open_span("device_open", config.FLEX_DEVICE);
     int flex_fd = open_flex_at_serial(config.FLEX_DEVICE, config.FLEX_BAUDRATE);
+    open_span.end();
     if (flex_fd < 0) {
-        std::cerr << "Failed to open FLEX device: " << config.FLEX_DEVICE << std::endl;
+        log_error(LOG_RADIO, "device_open_failed").s("device", config.FLEX_DEVICE).s("error", strerror(errno));
+        metrics_count(METRIC_DEVICE_ERRORS);
+        health.device_ok.store(false, std::memory_order_relaxed);
         return false;
     }
-    log_flex_at_setup(frequency, config.FLEX_POWER, config.FLEX_DEVICE, verbose_mode);
+    log_flex_at_setup(frequency, config.FLEX_POWER, config.FLEX_DEVICE);
 
     // Initialize AT communication
-    if (at_initialize_flex_device(flex_fd, verbose_mode) < 0) {
-        std::cerr << "Failed to initialize FLEX device" << std::endl;
+    TraceSpan init_span("device_init");
+    int init_result = at_initialize_flex_device(flex_fd);
+    init_span.end();
+    if (init_result < 0) {
+        log_error(LOG_RADIO, "device_init_failed").s("device", config.FLEX_DEVICE);
+        metrics_count(METRIC_DEVICE_ERRORS);
+        health.device_ok.store(false, std::memory_order_relaxed);
         close_flex_at_serial(flex_fd);
         return false;
     }
+    health.device_ok.store(true, std::memory_order_relaxed);
 
     // Create FLEX AT config for transmission
     FlexATConfig flex_config;
@@ -281,16 +345,23 @@ bool process_message(uint64_t capcode, const std::string& message, uint64_t freq
     // Check if we need to send EMR messages
     bool need_emr = should_send_emr(conn_state);
     if (need_emr) {
-        send_emr_messages(flex_fd, flex_config, debug_mode, verbose_mode);
+        send_emr_messages(flex_fd, flex_config, debug_mode);
     }
 
     // Transmit FLEX message via AT commands
-    log_flex_transmission_start(debug_mode, verbose_mode);
+    log_flex_transmission_start(debug_mode);
     bool success = false;
     if (!debug_mode) {
-        success = (send_flex_via_at_commands(flex_fd, flex_config, flex_buffer, flex_len, verbose_mode) == 0);
+        FlexATTimings timings;
+        success = (send_flex_via_at_commands(flex_fd, flex_config, frame.data(), frame.size(),
+                                             &timings) == 0);
 
         if (success) {
+            metrics_observe(STAGE_DEVICE_SETUP, timings.configured - setup_started);
+            metrics_observe(STAGE_MODULATION, timings.data_sent - timings.configured);
+            metrics_observe(STAGE_ON_AIR, timings.completed - timings.data_sent);
+            metrics_count(METRIC_BYTES_TRANSMITTED, frame.size());
+
             // Update connection state
             conn_state.last_transmission = std::chrono::steady_clock::now();
             conn_state.first_message = false;
@@ -298,256 +369,1330 @@ bool process_message(uint64_t capcode, const std::string& message, uint64_t freq
     } else {
         success = true; // In debug mode, we consider it successful
     }
-    log_flex_transmission_complete(debug_mode, verbose_mode);
+    log_flex_transmission_complete(debug_mode, success);
 
     close_flex_at_serial(flex_fd);
     return success;
 }
 
-void handle_serial_client(int client_fd, ConnectionState& conn_state, const Config& config,
-                         bool debug_mode, bool verbose_mode) {
-    char buffer[2048] = {0};
-
-    // Read input from client
-    int valRead = read(client_fd, buffer, sizeof(buffer) - 1);
-    if (valRead <= 0) {
-        perror("read");
+// Encoder pool task: turns a queued job into a frame for the radio thread
+void encode_job(const std::shared_ptr<Job>& job, JobQueue& queue, MpscQueue<RadioFrame>& radio_queue) {
+    TraceScope trace(job->trace, job->id);
+    trace_span(job->trace, job->id, "queue_wait", job->queued_at, std::chrono::steady_clock::now());
+
+    RadioFrame frame;
+    frame.job = job;
+    if (!encode_message(job->capcode, job->message, job->frequency, frame.data)) {
+        queue.start(job);
+        queue.finish(job, false);
+        log_error(LOG_ENCODER, "job_failed").u("job", job->id);
         return;
     }
+    queue.encoded(job, frame.data.size());
+    frame.encoded_at = std::chrono::steady_clock::now();
+    radio_queue.push(std::move(frame));
+}
 
-    buffer[valRead] = '\0';
+// Reads the job's priority before the frame is moved into its lane
+void push_lane(PriorityLanes<RadioFrame>& lanes, RadioFrame& frame) {
+    unsigned priority = frame.job->priority;
+    auto queued_at = frame.job->queued_at;
+    lanes.push(std::move(frame), priority, queued_at);
+}
 
-    // Parse input: {CAPCODE}|{MESSAGE}|{FREQUENCY IN HZ}
-    std::string input(buffer);
+void radio_worker(JobQueue& queue, MpscQueue<RadioFrame>& radio_queue, ServerHealth& health,
+                  const ConfigStore& configs, bool debug_mode) {
+    ConnectionState conn_state;
+    PriorityLanes<RadioFrame> lanes(configs.current().PRIORITY_AGING_SECONDS);
+    RadioFrame frame;
+
+    while (true) {
+        // Sort everything the encoders have finished into the lanes, and
+        // only sleep once there is nothing left to transmit
+        while (radio_queue.try_pop(frame)) {
+            push_lane(lanes, frame);
+        }
+        if (lanes.empty()) {
+            if (!radio_queue.pop_wait(frame)) {
+                break;
+            }
+            push_lane(lanes, frame);
+            continue;
+        }
+        if (radio_queue.stopped()) {
+            break;
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        frame = lanes.pop(now);
+        queue.start(frame.job);
+
+        TraceScope trace(frame.job->trace, frame.job->id);
+        trace_span(frame.job->trace, frame.job->id, "radio_wait", frame.encoded_at, now,
+                   priority_name(frame.job->priority));
+        log_info(LOG_RADIO, "transmit").u("job", frame.job->id).s("priority", priority_name(frame.job->priority))
+            .u("frame_bytes", frame.data.size()).u("queued", queue.depth()).s("trace_id", frame.job->trace.str());
+
+        // Device settings as of this page, so a reload applies from the next one
+        TraceSpan transmit_span("transmit");
+        bool success = transmit_frame(frame.data, frame.job->frequency,
+                                      conn_state, health, configs.current(), debug_mode);
+        transmit_span.end();
+        queue.finish(frame.job, success);
+
+        if (!success) {
+            log_error(LOG_RADIO, "job_failed").u("job", frame.job->id);
+        }
+    }
+}
+
+// Longest record accepted on the serial protocol
+#define SERIAL_MAX_LINE 4096
+
+// Seconds a serial connection may stay silent with no page outstanding
+#define SERIAL_IDLE_TIMEOUT 60
+
+// Seconds a client may take to finish a record it has started sending
+#define SERIAL_RECORD_TIMEOUT 10
+
+// A legacy client's record without a newline is taken as complete after this much silence
+#define SERIAL_LEGACY_QUIET_MS 200
+
+// Upper bound on simultaneously open serial connections
+#define SERIAL_MAX_CONNECTIONS 256
+
+// How a serial connection is answered. Legacy clients send one or more
+// records, read one reply per record and are disconnected once everything
+// has been answered. "PERSIST" keeps the connection open; "ASYNC" also
+// acknowledges each record as soon as it is queued, tagged with its sequence
+// number, and reports the transmission result later. "PRIORITY <n>" sets the
+// priority of the records that follow.
+typedef enum {
+    SERIAL_MODE_LEGACY,
+    SERIAL_MODE_PERSIST,
+    SERIAL_MODE_ASYNC
+} serial_mode_t;
+
+// Transmission result for a serial or binary client, handed from the radio
+// side back to the main loop
+struct PageResult {
+    int fd;
+    uint64_t conn_id;
+    uint64_t seq;
+    uint64_t job_id;
+    bool sent;
+};
+
+// A serial record handed to a worker for queueing, and what became of it
+struct SerialSubmission {
+    uint64_t seq;
+    uint64_t capcode;
+    std::string trace_id;
+    SubmitResult result;
+};
+
+// Per-connection state for the pipe-delimited protocol, owned by the main loop
+struct SerialConnection {
+    int fd;
+    uint64_t id;                // tells a reused fd apart when late results arrive
+    std::string peer;
+    ConnBuffer in;
+    std::string out;
+    serial_mode_t mode;
+    unsigned priority;          // applied to the records that follow
+    uint64_t records;           // sequence number of the last record received
+    size_t outstanding;         // queued pages whose result has not been reported
+    bool saw_newline;           // client frames its records
+    bool line_open;             // the last reply was sent without its newline
+    bool busy;                  // a record is at a worker; nothing else is read until it is queued
+    SerialSubmission submission;
+    std::vector<PageResult> early;  // results that arrived before their record was reported queued
+    bool eof;
+    bool closing;
+    std::string client_ip;      // or unix:user, for the per-client connection limit
+    std::chrono::steady_clock::time_point last_activity;
+    std::chrono::steady_clock::time_point progress;  // last record taken (or connect)
+
+    SerialConnection() : fd(-1), id(0), mode(SERIAL_MODE_LEGACY), priority(PRIORITY_DEFAULT), records(0), outstanding(0),
+                         saw_newline(false), line_open(false), busy(false), eof(false), closing(false) {}
+};
+
+// Queues one reply line. In legacy mode a reply is sent bare, as it was
+// before the protocol became line-oriented, so one-shot clients that read
+// until the connection closes see exactly the old text; further replies on
+// the same connection start with the newline the previous one left out.
+void serial_reply(SerialConnection& conn, const std::string& text) {
+    if (conn.line_open) {
+        conn.out += '\n';
+    }
+    conn.out += text;
+    conn.line_open = conn.mode == SERIAL_MODE_LEGACY;
+    if (!conn.line_open) {
+        conn.out += '\n';
+    }
+}
+
+// Parses {CAPCODE}|{MESSAGE}|{FREQUENCY IN HZ}; returns an error text or ""
+std::string parse_serial_record(const std::string& input, PageRequest& page) {
     size_t pos1 = input.find('|');
     size_t pos2 = input.rfind('|');
     if (pos1 == std::string::npos || pos2 == std::string::npos || pos1 == pos2) {
-        std::string error_msg = "Invalid input format. Expected: CAPCODE|MESSAGE|FREQUENCY";
-        send(client_fd, error_msg.c_str(), error_msg.size(), 0);
+        return "Invalid input format. Expected: CAPCODE|MESSAGE|FREQUENCY";
+    }
+
+    page.message = input.substr(pos1 + 1, pos2 - pos1 - 1);
+    try {
+        page.capcode = std::stoull(input.substr(0, pos1));
+        page.frequency = std::stoull(input.substr(pos2 + 1));
+    } catch (const std::exception& e) {
+        return "Invalid capcode or frequency format";
+    }
+
+    return validate_message(page.capcode, page.frequency);
+}
+
+void handle_serial_line(SerialConnection& conn, const std::string& line, JobQueue& queue,
+                        RateLimiter& limiter, EventQueue<PageResult>& results, ThreadPool& workers,
+                        EventQueue<SerialConnection*>& submissions) {
+    if (line == "PERSIST" || line == "ASYNC") {
+        conn.mode = (line == "ASYNC") ? SERIAL_MODE_ASYNC : SERIAL_MODE_PERSIST;
+        serial_reply(conn, "OK " + line);
+        return;
+    }
+    if (line.compare(0, 9, "PRIORITY ") == 0) {
+        std::string level = trim(line.substr(9));
+        if (level.size() == 1 && level[0] >= '0' && level[0] < '0' + PRIORITY_LEVELS) {
+            conn.priority = level[0] - '0';
+            serial_reply(conn, "OK PRIORITY " + level);
+        } else {
+            serial_reply(conn, (conn.mode == SERIAL_MODE_ASYNC ? "ERROR " : "") + std::string("Invalid priority"));
+        }
         return;
     }
 
-    std::string capcode_str = input.substr(0, pos1);
-    std::string message     = input.substr(pos1 + 1, pos2 - pos1 - 1);
-    std::string freq_str    = input.substr(pos2 + 1);
+    uint64_t seq = ++conn.records;
+    PageRequest page;
+    page.priority = conn.priority;
+    std::string error = parse_serial_record(line, page);
+    if (error.empty()) {
+        uint32_t retry_after = limiter.admit("", conn.client_ip, page.capcode);
+        if (retry_after > 0) {
+            error = "Rate limit exceeded, retry after " + std::to_string(retry_after) + " seconds";
+            log_info(LOG_SERIAL, "rate_limited").s("peer", conn.peer).u("capcode", page.capcode)
+                .u("retry_after", retry_after);
+        }
+    }
+    if (!error.empty()) {
+        serial_reply(conn, conn.mode == SERIAL_MODE_ASYNC ? std::to_string(seq) + " ERROR " + error : error);
+        return;
+    }
 
-    uint64_t capcode;
-    uint64_t frequency;
+    // The result arrives on the radio thread; route it back through the loop
+    int fd = conn.fd;
+    uint64_t conn_id = conn.id;
+    page.on_finish = [&results, fd, conn_id, seq](const Job& job) {
+        results.push({fd, conn_id, seq, job.id, job.state == JOB_SENT});
+    };
+    page.trace = trace_id_new();
+
+    // With a page log, queueing waits for the disk; do it off the main loop
+    conn.busy = true;
+    conn.submission = SerialSubmission{seq, page.capcode, page.trace.str(), SubmitResult()};
+    SerialConnection* target = &conn;
+    workers.submit([target, page = std::move(page), &queue, &submissions]() mutable {
+        target->submission.result = queue.submit(std::move(page));
+        submissions.push(target);
+    });
+}
 
-    try {
-        capcode = std::stoull(capcode_str);
-        frequency = std::stoull(freq_str);
-    } catch (const std::exception& e) {
-        std::string error_msg = "Invalid capcode or frequency format";
-        send(client_fd, error_msg.c_str(), error_msg.size(), 0);
+// Called on the main loop once a worker has queued the connection's record
+void complete_serial_submission(SerialConnection& conn, RateLimiter& limiter) {
+    conn.busy = false;
+    const SerialSubmission& record = conn.submission;
+    const SubmitResult& submitted = record.result;
+    if (submitted.status != SUBMIT_QUEUED) {
+        limiter.refund("", conn.client_ip, record.capcode);
+    }
+    if (submitted.status == SUBMIT_BUSY || submitted.status == SUBMIT_FAILED) {
+        std::string error;
+        if (submitted.status == SUBMIT_BUSY) {
+            error = "Transmitter busy, retry after " + std::to_string(submitted.retry_after) + " seconds";
+            log_info(LOG_SERIAL, "busy").s("peer", conn.peer).u("drain_seconds", submitted.drain_seconds);
+        } else {
+            error = "Page log write failed";
+            log_error(LOG_SERIAL, "page_not_logged").s("peer", conn.peer);
+        }
+        serial_reply(conn, conn.mode == SERIAL_MODE_ASYNC ? std::to_string(record.seq) + " ERROR " + error : error);
         return;
     }
+    conn.outstanding++;
+
+    log_debug(LOG_SERIAL, "queued").s("peer", conn.peer).u("seq", record.seq).u("job", submitted.id)
+        .s("priority", priority_name(conn.priority)).b("duplicate", submitted.status == SUBMIT_DUPLICATE)
+        .s("trace_id", record.trace_id);
+    if (conn.mode == SERIAL_MODE_ASYNC) {
+        serial_reply(conn, std::to_string(record.seq) + " QUEUED " + std::to_string(submitted.id));
+    }
+}
+
+// Handles every complete record in the buffer. Outside ASYNC mode each record
+// is answered before the next one is looked at, so replies stay in order.
+void process_serial_input(SerialConnection& conn, JobQueue& queue, RateLimiter& limiter,
+                          EventQueue<PageResult>& results, ThreadPool& workers,
+                          EventQueue<SerialConnection*>& submissions) {
+    auto now = std::chrono::steady_clock::now();
+
+    while (!conn.closing && !conn.busy && !conn.in.empty() &&
+           (conn.mode == SERIAL_MODE_ASYNC || conn.outstanding == 0)) {
+        const char* data = conn.in.data();
+        const char* newline = static_cast<const char*>(memchr(data, '\n', conn.in.size()));
+        size_t length;
+        size_t consumed;
+        if (newline) {
+            conn.saw_newline = true;
+            length = newline - data;
+            consumed = length + 1;
+        } else if (conn.eof || (!conn.saw_newline && conn.mode == SERIAL_MODE_LEGACY &&
+                                now - conn.last_activity >= std::chrono::milliseconds(SERIAL_LEGACY_QUIET_MS))) {
+            // Old clients send a single unterminated record and wait for the reply
+            length = conn.in.size();
+            consumed = length;
+        } else {
+            break;
+        }
+
+        if (length > SERIAL_MAX_LINE) {
+            serial_reply(conn, "Line too long");
+            conn.closing = true;
+            break;
+        }
+
+        std::string line = trim(std::string(data, length));
+        conn.in.consume(consumed);
+        conn.progress = now;
+        if (!line.empty()) {
+            handle_serial_line(conn, line, queue, limiter, results, workers, submissions);
+        }
+    }
+
+    if (!conn.closing && !conn.saw_newline && conn.in.size() > SERIAL_MAX_LINE) {
+        serial_reply(conn, "Line too long");
+        conn.closing = true;
+    }
+
+    // Legacy clients are done once everything they sent has been answered
+    if (!conn.busy && conn.outstanding == 0 && conn.in.empty() &&
+        (conn.eof || (conn.mode == SERIAL_MODE_LEGACY && conn.records > 0))) {
+        conn.closing = true;
+    }
+}
 
-    if (process_message(capcode, message, frequency, conn_state, config, debug_mode, verbose_mode)) {
-        std::string success_msg = "Message sent successfully!";
-        send(client_fd, success_msg.c_str(), success_msg.size(), 0);
+// Called on the main loop when the radio has finished one of the connection's pages
+void complete_serial_record(SerialConnection& conn, const PageResult& result) {
+    conn.outstanding--;
+    conn.progress = std::chrono::steady_clock::now();  // the record timeout counts the client's time only
+    if (conn.mode == SERIAL_MODE_ASYNC) {
+        serial_reply(conn, std::to_string(result.seq) + (result.sent ? " SENT " : " FAILED ") +
+                           std::to_string(result.job_id));
     } else {
-        std::string error_msg = "Failed to process message";
-        send(client_fd, error_msg.c_str(), error_msg.size(), 0);
+        serial_reply(conn, result.sent ? "Message sent successfully!" : "Failed to process message");
+    }
+}
+
+// Upper bound on simultaneously open binary protocol connections
+#define BINARY_MAX_CONNECTIONS 256
+
+// Seconds a binary connection may stay silent with no result outstanding
+#define BINARY_IDLE_TIMEOUT 60
+
+// Seconds a client may take to finish a frame it has started sending
+#define BINARY_FRAME_TIMEOUT 10
+
+// Frames taken from a binary connection in one go; a worker queues the valid ones
+struct BinaryBatch {
+    std::vector<PageRequest> pages;
+    std::vector<uint32_t> seqs;              // per frame, in order
+    std::vector<binary_status_t> statuses;
+    std::vector<uint32_t> retry_after;       // seconds, for rate limited frames
+    std::vector<SubmitResult> submitted;     // per page
+};
+
+// Per-connection state for the binary protocol, owned by the main loop
+struct BinaryConnection {
+    int fd;
+    uint64_t id;                // tells a reused fd apart when late results arrive
+    std::string peer;
+    ConnBuffer in;
+    std::string out;
+    uint64_t frames;
+    size_t outstanding;         // results the client asked for that are still due
+    bool busy;                  // batch is at a worker; nothing else is read until it is queued
+    BinaryBatch batch;
+    std::vector<PageResult> early;  // results that arrived before their frame was acked
+    bool eof;
+    bool closing;
+    std::string client_ip;      // for the per-client connection limit
+    std::chrono::steady_clock::time_point last_activity;
+    std::chrono::steady_clock::time_point progress;  // last frame taken (or connect)
+
+    BinaryConnection() : fd(-1), id(0), frames(0), outstanding(0), busy(false), eof(false), closing(false) {}
+};
+
+binary_status_t check_binary_frame(const BinaryFrameHeader& header, const std::string& message,
+                                   uint64_t frequency) {
+    int is_long;
+    if (header.flags & ~BINARY_FLAGS_KNOWN) {
+        return BINARY_STATUS_UNKNOWN_FLAGS;
+    }
+    if (message.empty()) {
+        return BINARY_STATUS_EMPTY_MESSAGE;
+    }
+    if (header.priority >= PRIORITY_LEVELS) {
+        return BINARY_STATUS_INVALID_PRIORITY;
+    }
+    if (!is_capcode_valid(header.capcode, &is_long)) {
+        return BINARY_STATUS_INVALID_CAPCODE;
     }
+    if (!validate_message(header.capcode, frequency).empty()) {
+        return BINARY_STATUS_INVALID_FREQUENCY;
+    }
+    return BINARY_STATUS_OK;
 }
 
-void handle_http_client(int client_fd, const std::map<std::string, std::string>& passwords,
-                       ConnectionState& conn_state, const Config& config,
-                       bool debug_mode, bool verbose_mode) {
-    char buffer[8192] = {0};
-    struct sockaddr_in client_addr;
-    socklen_t client_len = sizeof(client_addr);
+// Acks every frame of the connection's batch, in frame order
+void complete_binary_batch(BinaryConnection& conn, RateLimiter& limiter) {
+    BinaryBatch& batch = conn.batch;
+    conn.busy = false;
+
+    size_t next_page = 0;
+    size_t accepted = 0;
+    for (size_t i = 0; i < batch.seqs.size(); ++i) {
+        if (batch.statuses[i] == BINARY_STATUS_OK) {
+            const SubmitResult& result = batch.submitted[next_page];
+            if (result.status != SUBMIT_QUEUED) {
+                limiter.refund("", conn.client_ip, batch.pages[next_page].capcode);
+            }
+            if (result.status == SUBMIT_BUSY) {
+                batch.statuses[i] = BINARY_STATUS_BUSY;
+                batch.retry_after[i] = result.retry_after;
+            } else if (result.status == SUBMIT_FAILED) {
+                batch.statuses[i] = BINARY_STATUS_LOG_FAILED;
+            } else {
+                if (batch.pages[next_page].on_finish) {
+                    conn.outstanding++;
+                }
+                accepted++;
+            }
+            next_page++;
+        }
+        if (batch.statuses[i] == BINARY_STATUS_OK) {
+            binary_write_ack(conn.out, BINARY_ACK_QUEUED, BINARY_STATUS_OK, batch.seqs[i],
+                             batch.submitted[next_page - 1].id);
+        } else {
+            // For rate limited and busy frames the job id field carries the seconds to wait
+            uint64_t detail = (i < batch.retry_after.size()) ? batch.retry_after[i] : 0;
+            binary_write_ack(conn.out, BINARY_ACK_REJECTED, batch.statuses[i], batch.seqs[i], detail);
+        }
+    }
+    if (!batch.seqs.empty()) {
+        log_debug(LOG_BINARY, "frames").s("peer", conn.peer).u("received", batch.seqs.size()).u("queued", accepted);
+    }
+    batch = BinaryBatch();
 
-    // Get client info for logging
-    std::string client_ip = "unknown";
-    int client_port = 0;
-    if (getpeername(client_fd, (struct sockaddr*)&client_addr, &client_len) == 0) {
-        client_ip = inet_ntoa(client_addr.sin_addr);
-        client_port = ntohs(client_addr.sin_port);
+    if (conn.eof && conn.outstanding == 0) {
+        conn.closing = true;
+    }
+}
+
+// Takes every complete frame in the buffer and queues the valid ones as a
+// single batch. With a page log that waits for the disk, so a worker does
+// it and the acks go out from complete_binary_batch(), in frame order.
+void process_binary_input(BinaryConnection& conn, JobQueue& queue, RateLimiter& limiter,
+                          EventQueue<PageResult>& results, ThreadPool& workers,
+                          EventQueue<BinaryConnection*>& submissions, const Config& config) {
+    if (conn.busy) {
+        return;
     }
+    BinaryBatch& batch = conn.batch;
+
+    while (!conn.closing && conn.in.size() >= BINARY_HEADER_SIZE) {
+        BinaryFrameHeader header;
+        if (!binary_read_header(conn.in.data(), header)) {
+            // Out of sync; nothing after this point can be trusted
+            log_warn(LOG_BINARY, "bad_header").s("peer", conn.peer);
+            conn.closing = true;
+            break;
+        }
+        if (header.length > BINARY_MAX_PAYLOAD) {
+            batch.seqs.push_back(header.seq);
+            batch.statuses.push_back(BINARY_STATUS_TOO_LONG);
+            conn.closing = true;
+            break;
+        }
+        if (conn.in.size() < BINARY_HEADER_SIZE + header.length) {
+            break;
+        }
 
-    // Enhanced HTTP request reading with proper handling of body
-    std::string full_request;
-    int total_read = 0;
-    int content_length = 0;
-    bool headers_complete = false;
-    size_t headers_end_pos = 0;
+        std::string message(conn.in.data() + BINARY_HEADER_SIZE, header.length);
+        conn.in.consume(BINARY_HEADER_SIZE + header.length);
+        conn.frames++;
+        conn.progress = std::chrono::steady_clock::now();
+
+        uint64_t frequency = header.frequency > 0 ? header.frequency : config.DEFAULT_FREQUENCY;
+        binary_status_t status = check_binary_frame(header, message, frequency);
+        uint32_t wait = 0;
+        if (status == BINARY_STATUS_OK) {
+            wait = limiter.admit("", conn.client_ip, header.capcode);
+            if (wait > 0) {
+                status = BINARY_STATUS_RATE_LIMITED;
+            }
+        }
+        batch.seqs.push_back(header.seq);
+        batch.statuses.push_back(status);
+        batch.retry_after.push_back(wait);
+        if (status != BINARY_STATUS_OK) {
+            continue;
+        }
 
-    // Read initial chunk
-    int initial_read = read(client_fd, buffer, sizeof(buffer) - 1);
-    if (initial_read <= 0) {
-        if (verbose_mode) {
-            std::cout << "Failed to read initial HTTP data from client" << std::endl;
+        PageRequest page{header.capcode, std::move(message), frequency, header.priority, nullptr, trace_id_new()};
+        if (header.flags & BINARY_FLAG_REPORT_RESULT) {
+            int fd = conn.fd;
+            uint64_t conn_id = conn.id;
+            uint64_t seq = header.seq;
+            page.on_finish = [&results, fd, conn_id, seq](const Job& job) {
+                results.push({fd, conn_id, seq, job.id, job.state == JOB_SENT});
+            };
         }
-        send_http_response(client_fd, 400, "Bad Request",
-                          "{\"error\":\"Failed to read request\",\"code\":400}",
-                          "application/json", verbose_mode);
+        batch.pages.push_back(std::move(page));
+    }
+
+    if (batch.pages.empty()) {
+        complete_binary_batch(conn, limiter);
         return;
     }
+    conn.busy = true;
+    BinaryConnection* target = &conn;
+    workers.submit([target, &queue, &submissions] {
+        target->batch.submitted = queue.submit_batch(target->batch.pages);
+        submissions.push(target);
+    });
+}
 
-    buffer[initial_read] = '\0';
-    full_request = std::string(buffer, initial_read);
-    total_read = initial_read;
+// Called on the main loop when the radio has finished a page whose result was requested
+void complete_binary_frame(BinaryConnection& conn, const PageResult& result) {
+    conn.outstanding--;
+    binary_write_ack(conn.out, result.sent ? BINARY_ACK_SENT : BINARY_ACK_FAILED, BINARY_STATUS_OK,
+                     static_cast<uint32_t>(result.seq), result.job_id);
+    if (conn.eof && conn.outstanding == 0) {
+        conn.closing = true;
+    }
+}
 
-    if (verbose_mode) {
-        std::cout << std::endl << "=== HTTP Client Connected ===" << std::endl;
-        std::cout << "Client IP: " << client_ip << std::endl;
-        std::cout << "Client Port: " << client_port << std::endl;
-        std::cout << "Initial read: " << initial_read << " bytes" << std::endl;
-    }
-
-    // Check if headers are complete (look for \r\n\r\n)
-    headers_end_pos = full_request.find("\r\n\r\n");
-    if (headers_end_pos != std::string::npos) {
-        headers_complete = true;
-        headers_end_pos += 4; // Include the \r\n\r\n
-    }
-
-    // Parse headers to get Content-Length
-    std::istringstream header_stream(full_request);
-    std::string line;
-    while (std::getline(header_stream, line) && !line.empty() && line != "\r") {
-        line.erase(line.find_last_not_of("\r\n") + 1); // Remove trailing \r\n
-        if (line.empty()) break;
-
-        std::transform(line.begin(), line.end(), line.begin(), ::tolower);
-        if (line.find("content-length:") == 0) {
-            size_t colon_pos = line.find(':');
-            if (colon_pos != std::string::npos) {
-                std::string length_str = line.substr(colon_pos + 1);
-                length_str.erase(0, length_str.find_first_not_of(" \t"));
-                try {
-                    content_length = std::stoi(length_str);
-                    if (verbose_mode) {
-                        std::cout << "Found Content-Length: " << content_length << std::endl;
-                    }
-                } catch (...) {
-                    if (verbose_mode) {
-                        std::cout << "Failed to parse Content-Length: '" << length_str << "'" << std::endl;
-                    }
-                }
+// Upper bound on simultaneously open HTTP connections
+#define HTTP_MAX_CONNECTIONS 256
+
+// Upper bound on entries in one POST /messages/batch request
+#define BATCH_MAX_MESSAGES 1000
+
+// Login data used by the HTTP workers. The main loop replaces the whole
+// snapshot when a file changes; requests in flight keep the one they started with.
+struct HttpCredentials {
+    std::map<std::string, std::string> passwords;
+    ApiTokenTable api_tokens;
+};
+
+// Per-connection state for the HTTP listener. Connections are non-blocking
+// and multiplexed by the main loop, so an idle keep-alive client never holds
+// up anyone else. While a request is with a worker (busy), the main loop
+// neither reads into nor frees the connection; the worker only writes reply.
+struct HttpConnection {
+    int fd;
+    std::string client_ip;
+    int client_port;
+    std::string local_user;     // peer on the unix socket, vetted at accept; skips login
+    std::chrono::steady_clock::time_point accepted_at;
+    ConnBuffer in;
+    HttpParser parser;
+    std::string out;            // response bytes not yet written to the socket
+    std::string reply;          // response being built for the current request
+    uint32_t requests_served;
+    bool keep_alive;            // whether the current response keeps the connection
+    bool busy;                  // current request is being handled by a worker
+    bool eof;                   // peer stopped sending; finish buffered requests
+    bool closing;               // close once out has been flushed
+    bool continue_sent;         // "100 Continue" already sent for the current request
+    std::chrono::steady_clock::time_point last_activity;
+    std::chrono::steady_clock::time_point request_started;  // first byte of the current request
+    std::chrono::steady_clock::time_point body_started;     // its headers completed (unset until then)
+    TraceId trace;              // current request's trace, returned as X-Trace-Id
+
+    HttpConnection() : fd(-1), client_port(0), requests_served(0), keep_alive(false),
+                       busy(false), eof(false), closing(false), continue_sent(false) {}
+};
+
+void reply_http(HttpConnection& conn, int status_code, const std::string& body,
+                const Config& config, const std::string& extra_headers = "",
+                const char* content_type = "application/json") {
+    std::string headers = extra_headers;
+    if (conn.trace.valid()) {
+        headers += "X-Trace-Id: " + conn.trace.str() + "\r\n";
+    }
+    if (conn.keep_alive) {
+        headers += "Keep-Alive: timeout=" + std::to_string(config.HTTP_KEEPALIVE_TIMEOUT) +
+                   ", max=" + std::to_string(config.HTTP_KEEPALIVE_MAX_REQUESTS) + "\r\n";
+    }
+    conn.reply += build_http_response(status_code, http_status_text(status_code), body,
+                                      content_type, conn.keep_alive, headers);
+    log_http_response(status_code, body);
+}
+
+// GET /metrics in the Prometheus text format
+void handle_metrics_request(HttpConnection& conn, JobQueue& queue, const Config& config) {
+    std::string body = metrics().render();
+    body += "# HELP flex_queue_depth Pages waiting for the transmitter\n"
+            "# TYPE flex_queue_depth gauge\n"
+            "flex_queue_depth " + std::to_string(queue.depth()) + "\n";
+    body += "# HELP flex_queue_drain_seconds Estimated time to transmit everything queued\n"
+            "# TYPE flex_queue_drain_seconds gauge\n"
+            "flex_queue_drain_seconds " + std::to_string(queue.drain_ms() / 1000.0) + "\n";
+    reply_http(conn, 200, body, config, "", "text/plain; version=0.0.4");
+}
+
+// GET /log-levels shows the level of every component; POST changes them,
+// taking the same form as LOG_LEVELS in the body (e.g. "radio=debug")
+void handle_log_levels_request(HttpConnection& conn, const HttpRequestView& request, const std::string& user,
+                               const Config& config) {
+    if (request.method == "POST") {
+        std::string error;
+        if (!logger().set_levels(trim(std::string(request.body)), error)) {
+            std::string escaped;
+            log_json_escape(escaped, error);
+            reply_http(conn, 400, "{\"error\":\"" + escaped + "\",\"code\":400}", config);
+            return;
+        }
+        log_info(LOG_CORE, "log_levels_changed").s("user", user).s("log_levels", logger().levels_spec());
+    }
+    reply_http(conn, 200, "{\"log_levels\":\"" + logger().levels_spec() + "\"}", config);
+}
+
+void handle_job_status_request(HttpConnection& conn, std::string_view path, JobQueue& queue,
+                               const Config& config) {
+    const std::string_view prefix = "/messages/";
+    if (path.compare(0, prefix.size(), prefix) != 0) {
+        reply_http(conn, 404, "{\"error\":\"Not found\",\"code\":404}", config);
+        return;
+    }
+
+    uint64_t job_id = 0;
+    std::string_view id_str = path.substr(prefix.size());
+    auto res = std::from_chars(id_str.data(), id_str.data() + id_str.size(), job_id);
+    if (res.ec != std::errc() || res.ptr != id_str.data() + id_str.size()) {
+        job_id = 0;
+    }
+
+    Job job;
+    if (job_id == 0 || !queue.lookup(job_id, job)) {
+        reply_http(conn, 404, "{\"error\":\"Unknown message id\",\"code\":404}", config);
+        return;
+    }
+
+    reply_http(conn, 200, job_status_json(job), config);
+}
+
+// Applies the API rules to a parsed message and fills in the page to queue,
+// resolving defaults. Returns an empty string when the page can be queued,
+// otherwise the error.
+std::string check_json_message(const JsonMessage& json_msg, const Config& config, PageRequest& page) {
+    if (!json_msg.valid) {
+        return json_msg.error.empty() ? "Invalid JSON format or missing required fields" : json_msg.error;
+    }
+
+    // Validate required fields: capcode and message are MANDATORY
+    if (json_msg.capcode == 0) {
+        return "Missing required field: capcode must be specified";
+    }
+    if (json_msg.message.empty()) {
+        return "Missing required field: message must be specified";
+    }
+
+    if (json_msg.has_priority && json_msg.priority >= PRIORITY_LEVELS) {
+        return "priority must be between 0 and " + std::to_string(PRIORITY_LEVELS - 1);
+    }
+
+    // Use default frequency if not provided (frequency is optional)
+    page.capcode = json_msg.capcode;
+    page.message = json_msg.message;
+    page.frequency = json_msg.frequency > 0 ? json_msg.frequency : config.DEFAULT_FREQUENCY;
+    page.priority = json_msg.has_priority ? static_cast<unsigned>(json_msg.priority) : PRIORITY_DEFAULT;
+    return validate_message(page.capcode, page.frequency);
+}
+
+// POST /messages/batch: a JSON array of messages or an NDJSON stream. Every
+// entry is validated on its own; the valid ones are queued together and the
+// response lists the outcome per entry, in order.
+void handle_batch_request(HttpConnection& conn, const HttpRequestView& request, const std::string& user,
+                          JobQueue& queue, RateLimiter& limiter, const Config& config) {
+    std::vector<JsonMessage> items;
+    std::string parse_error;
+    auto parse_started = std::chrono::steady_clock::now();
+    bool parsed = parse_json_batch(request.body, items, parse_error);
+    metrics_observe_since(STAGE_JSON_PARSE, parse_started);
+    trace_span(conn.trace, 0, "json_parse", parse_started, std::chrono::steady_clock::now());
+    if (!parsed) {
+        reply_http(conn, 400, "{\"error\":\"Malformed JSON array: " + parse_error + "\",\"code\":400}",
+                   config);
+        return;
+    }
+    if (items.empty()) {
+        reply_http(conn, 400, "{\"error\":\"Batch contains no messages\",\"code\":400}", config);
+        return;
+    }
+    if (items.size() > BATCH_MAX_MESSAGES) {
+        reply_http(conn, 413, "{\"error\":\"Batch exceeds " + std::to_string(BATCH_MAX_MESSAGES) +
+                   " messages\",\"code\":413}", config);
+        return;
+    }
+
+    std::vector<PageRequest> pages;
+    std::vector<std::string> errors(items.size());
+    uint32_t retry_after = 0;
+    pages.reserve(items.size());
+
+    for (size_t i = 0; i < items.size(); ++i) {
+        PageRequest page;
+        errors[i] = check_json_message(items[i], config, page);
+        if (errors[i].empty()) {
+            uint32_t wait = limiter.admit(user, conn.client_ip, page.capcode);
+            if (wait > 0) {
+                errors[i] = "Rate limit exceeded, retry after " + std::to_string(wait) + " seconds";
+                retry_after = std::max(retry_after, wait);
             }
-            break;
+        }
+        if (errors[i].empty()) {
+            page.trace = conn.trace;
+            pages.push_back(std::move(page));
         }
     }
 
-    // If we have content-length, make sure we read the complete body
-    if (content_length > 0 && headers_complete) {
-        size_t body_start = headers_end_pos;
-        int body_received = full_request.length() - body_start;
+    std::vector<SubmitResult> submitted;
+    if (!pages.empty()) {
+        TraceSpan submit_span("submit");
+        submitted = queue.submit_batch(pages);
+    }
 
-        if (verbose_mode) {
-            std::cout << "Body bytes received so far: " << body_received << std::endl;
-            std::cout << "Expected body length: " << content_length << std::endl;
+    // Pages refused because the transmitter is saturated become errors too
+    size_t accepted = 0;
+    bool busy = false;
+    bool not_logged = false;
+    uint32_t drain_seconds = 0;
+    size_t next_page = 0;
+    std::vector<uint64_t> ids(items.size(), 0);
+    std::vector<bool> duplicates(items.size(), false);
+    for (size_t i = 0; i < items.size(); ++i) {
+        if (!errors[i].empty()) {
+            continue;
+        }
+        const SubmitResult& result = submitted[next_page];
+        if (result.status != SUBMIT_QUEUED) {
+            limiter.refund(user, conn.client_ip, pages[next_page].capcode);
+        }
+        next_page++;
+        if (result.status == SUBMIT_BUSY) {
+            errors[i] = "Transmitter busy, retry after " + std::to_string(result.retry_after) + " seconds";
+            retry_after = std::max(retry_after, result.retry_after);
+            drain_seconds = result.drain_seconds;
+            busy = true;
+            continue;
         }
+        if (result.status == SUBMIT_FAILED) {
+            errors[i] = "Page log write failed";
+            not_logged = true;
+            continue;
+        }
+        ids[i] = result.id;
+        duplicates[i] = (result.status == SUBMIT_DUPLICATE);
+        accepted++;
+    }
 
-        // Read more data if needed
-        while (body_received < content_length) {
-            int additional_read = read(client_fd, buffer, sizeof(buffer) - 1);
-            if (additional_read <= 0) {
-                if (verbose_mode) {
-                    std::cout << "Failed to read additional body data" << std::endl;
-                }
-                break;
+    std::string body = "{\"accepted\":" + std::to_string(accepted) +
+                       ",\"rejected\":" + std::to_string(items.size() - accepted) +
+                       ",\"trace_id\":\"" + conn.trace.str() + "\"";
+    if (busy) {
+        body += ",\"drain_seconds\":" + std::to_string(drain_seconds);
+    }
+    body += ",\"results\":[";
+    for (size_t i = 0; i < items.size(); ++i) {
+        if (i > 0) {
+            body += ",";
+        }
+        body += "{\"index\":" + std::to_string(i);
+        if (errors[i].empty()) {
+            body += ",\"status\":\"queued\",\"id\":" + std::to_string(ids[i]) +
+                    (duplicates[i] ? ",\"duplicate\":true}" : "}");
+        } else {
+            body += ",\"status\":\"rejected\",\"error\":\"" + errors[i] + "\"}";
+        }
+    }
+    body += "]}";
+
+    log_debug(LOG_HTTP, "batch").u("messages", items.size()).u("queued", accepted).b("busy", busy);
+    if (not_logged) {
+        log_error(LOG_HTTP, "page_not_logged").s("client", conn.client_ip);
+    }
+
+    if (accepted == 0 && not_logged) {
+        reply_http(conn, 500, body, config);
+        return;
+    }
+    if (accepted == 0 && retry_after > 0) {
+        reply_http(conn, busy ? 503 : 429, body, config,
+                   "Retry-After: " + std::to_string(retry_after) + "\r\n");
+        return;
+    }
+    reply_http(conn, accepted == 0 ? 400 : 202, body, config);
+}
+
+// Runs on the HTTP worker pool
+void handle_http_request(HttpConnection& conn, const HttpRequestView& request,
+                         const HttpCredentials& credentials, AuthCache& auth_cache, uint64_t auth_generation,
+                         JobQueue& queue, RateLimiter& limiter, const Config& config) {
+    TraceScope trace(conn.trace, 0);
+    log_parsed_request(request);
+    metrics_count(METRIC_HTTP_REQUESTS);
+
+    // Only POST (submit) and GET (job status) are supported
+    if (request.method != "POST" && request.method != "GET") {
+        reply_http(conn, 405, "{\"error\":\"Only POST and GET methods are allowed\",\"code\":405}",
+                   config);
+        return;
+    }
+
+    // Check authentication: bearer tokens for machine clients, Basic for users.
+    // A recently verified Basic header skips the crypt() call.
+    // Unix socket peers were already checked by the kernel (file mode) and at accept.
+    auto auth_started = std::chrono::steady_clock::now();
+    std::string_view auth_header = request.header("authorization");
+    std::string user;           // who the rate limit charges
+    bool authorized = false;
+    TraceSpan auth_span("auth", !conn.local_user.empty() ? "unix" :
+                                auth_header.substr(0, 7) == "Bearer " ? "bearer" : "basic");
+    if (!conn.local_user.empty()) {
+        authorized = true;
+        user = conn.local_user;
+    } else if (auth_header.substr(0, 7) == "Bearer ") {
+        const std::string* client = credentials.api_tokens.lookup(auth_header.substr(7));
+        authorized = client != nullptr;
+        if (client) {
+            user = *client;
+            log_debug(LOG_HTTP, "token_auth").s("client", *client);
+        }
+    } else if (!auth_header.empty()) {
+        authorized = auth_cache.contains(auth_header);
+        if (!authorized) {
+            TraceSpan crypt_span("crypt");
+            if (authenticate_user(std::string(auth_header), credentials.passwords)) {
+                auth_cache.insert(auth_header, auth_generation);
+                authorized = true;
+            }
+        }
+        if (authorized) {
+            user = basic_auth_user(std::string(auth_header));
+        }
+    }
+    metrics_observe_since(STAGE_AUTH, auth_started);
+    auth_span.end();
+    if (!authorized) {
+        std::string challenge = "WWW-Authenticate: Basic realm=\"FLEX HTTP Server\"\r\n";
+        if (credentials.api_tokens.size() > 0) {
+            challenge += "WWW-Authenticate: Bearer realm=\"FLEX HTTP Server\"\r\n";
+        }
+        reply_http(conn, 401, "{\"error\":\"Authentication required\",\"code\":401}", config,
+                   challenge);
+        return;
+    }
+
+    if (request.method == "GET" && request.path == "/metrics") {
+        handle_metrics_request(conn, queue, config);
+        return;
+    }
+    if (request.path == "/log-levels") {
+        handle_log_levels_request(conn, request, user, config);
+        return;
+    }
+    if (request.method == "GET") {
+        handle_job_status_request(conn, request.path, queue, config);
+        return;
+    }
+
+    if (request.path == "/messages/batch") {
+        handle_batch_request(conn, request, user, queue, limiter, config);
+        return;
+    }
+
+    // Parse JSON message
+    auto parse_started = std::chrono::steady_clock::now();
+    JsonMessage json_msg = parse_json_message(request.body);
+    PageRequest page;
+    std::string json_error = check_json_message(json_msg, config, page);
+    metrics_observe_since(STAGE_JSON_PARSE, parse_started);
+    trace_span(conn.trace, 0, "json_parse", parse_started, std::chrono::steady_clock::now());
+    if (!json_error.empty()) {
+        log_info(LOG_HTTP, "json_rejected").s("error", json_error).s("body", request.body);
+        reply_http(conn, 400, "{\"error\":\"" + json_error + "\",\"code\":400}", config);
+        return;
+    }
+
+    log_json_processing(json_msg, config.DEFAULT_FREQUENCY);
+
+    uint32_t retry_after = limiter.admit(user, conn.client_ip, page.capcode);
+    if (retry_after > 0) {
+        log_info(LOG_HTTP, "rate_limited").s("user", user).s("client", conn.client_ip).u("capcode", page.capcode)
+            .u("retry_after", retry_after);
+        reply_http(conn, 429, "{\"error\":\"Rate limit exceeded\",\"retry_after\":" + std::to_string(retry_after) +
+                   ",\"code\":429}", config, "Retry-After: " + std::to_string(retry_after) + "\r\n");
+        return;
+    }
+
+    // Hand the page to the radio thread and answer right away
+    page.trace = conn.trace;
+    uint64_t capcode = page.capcode;
+    TraceSpan submit_span("submit");
+    SubmitResult submitted = queue.submit(std::move(page));
+    submit_span.end();
+    if (submitted.status != SUBMIT_QUEUED) {
+        limiter.refund(user, conn.client_ip, capcode);
+    }
+    if (submitted.status == SUBMIT_BUSY) {
+        log_info(LOG_HTTP, "busy").s("client", conn.client_ip).u("drain_seconds", submitted.drain_seconds);
+        reply_http(conn, 503, "{\"error\":\"Transmitter busy\",\"retry_after\":" +
+                   std::to_string(submitted.retry_after) + ",\"drain_seconds\":" +
+                   std::to_string(submitted.drain_seconds) + ",\"code\":503}",
+                   config, "Retry-After: " + std::to_string(submitted.retry_after) + "\r\n");
+        return;
+    }
+    if (submitted.status == SUBMIT_FAILED) {
+        log_error(LOG_HTTP, "page_not_logged").s("client", conn.client_ip);
+        reply_http(conn, 500, "{\"error\":\"Page log write failed\",\"code\":500}", config);
+        return;
+    }
+    uint64_t job_id = submitted.id;
+    bool duplicate = (submitted.status == SUBMIT_DUPLICATE);
+    reply_http(conn, 202, "{\"status\":\"queued\",\"id\":" + std::to_string(job_id) +
+               (duplicate ? ",\"duplicate\":true" : "") +
+               ",\"location\":\"/messages/" + std::to_string(job_id) + "\"" +
+               ",\"trace_id\":\"" + conn.trace.str() + "\"}",
+               config);
+
+    log_debug(LOG_HTTP, "queued").u("job", job_id).b("duplicate", duplicate)
+        .u("duplicates_merged", duplicate ? queue.duplicates_merged() : 0);
+}
+
+// GET /health and /ready for load balancers and orchestrators. They are
+// answered on the main loop from cached state and need no authentication,
+// so a long transmission or a busy worker pool never delays them. Returns
+// false for any other request.
+bool handle_probe_request(HttpConnection& conn, const HttpRequestView& request, const ServerHealth& health,
+                          const JobQueue& queue, const Config& config) {
+    if (request.method != "GET" || (request.path != "/health" && request.path != "/ready")) {
+        return false;
+    }
+    if (request.path == "/health") {
+        reply_http(conn, 200, "{\"status\":\"ok\"}", config);
+        return true;
+    }
+
+    bool device_ok = health.device_ok.load(std::memory_order_relaxed);
+    bool draining = health.draining.load(std::memory_order_relaxed);
+    size_t depth = queue.depth();
+    bool queue_ok = config.READY_QUEUE_THRESHOLD == 0 || depth < config.READY_QUEUE_THRESHOLD;
+    bool ready = device_ok && queue_ok && !draining;
+    reply_http(conn, ready ? 200 : 503,
+               std::string("{\"ready\":") + (ready ? "true" : "false") +
+               ",\"device\":\"" + (device_ok ? "ok" : "failed") + "\"" +
+               ",\"queue_depth\":" + std::to_string(depth) +
+               ",\"draining\":" + (draining ? "true" : "false") + "}",
+               config);
+    return true;
+}
+
+// HTTP/1.1 connections persist unless the client opts out; HTTP/1.0 only
+// persists when the client explicitly asks for it.
+bool wants_keep_alive(const HttpRequestView& request) {
+    std::string_view connection = request.header("connection");
+    if (http_header_has_token(connection, "close")) {
+        return false;
+    }
+    if (http_header_has_token(connection, "keep-alive")) {
+        return true;
+    }
+    return request.version == "HTTP/1.1";
+}
+
+// Called on the main loop once a worker has answered the current request
+void complete_http_request(HttpConnection& conn) {
+    conn.out += conn.reply;
+    conn.reply.clear();
+    conn.in.consume(conn.parser.consumed());
+    conn.parser.reset();
+    conn.continue_sent = false;
+    conn.busy = false;
+    conn.trace = TraceId();
+    if (!conn.keep_alive) {
+        conn.closing = true;
+    }
+
+    // A pipelined request already in the buffer starts its clock now
+    conn.request_started = std::chrono::steady_clock::now();
+    conn.body_started = std::chrono::steady_clock::time_point();
+}
+
+// Hands the next complete request in the connection buffer to a worker.
+// Requests on one connection are handled one at a time, so pipelined
+// requests are answered in order; complete_http_request() picks up the next.
+// Health probes are answered in place and the loop moves on to the next.
+void process_http_input(HttpConnection& conn, const std::shared_ptr<const HttpCredentials>& credentials,
+                        AuthCache& auth_cache, JobQueue& queue, RateLimiter& limiter, ThreadPool& workers,
+                        EventQueue<HttpConnection*>& completions, const ServerHealth& health,
+                        const Config& config) {
+    while (!conn.closing && !conn.busy && !conn.in.empty()) {
+        HttpRequestView request;
+        http_parse_result_t result = conn.parser.parse(conn.in.data(), conn.in.size(), request);
+
+        if (result == HTTP_PARSE_INCOMPLETE) {
+            if (conn.parser.headers_complete() &&
+                conn.body_started == std::chrono::steady_clock::time_point()) {
+                conn.body_started = std::chrono::steady_clock::now();
             }
 
-            buffer[additional_read] = '\0';
-            full_request += std::string(buffer, additional_read);
-            body_received += additional_read;
-            total_read += additional_read;
+            // Clients sending "Expect: 100-continue" hold the body back until told to go on
+            if (conn.parser.awaiting_continue() && !conn.continue_sent) {
+                conn.out += "HTTP/1.1 100 Continue\r\n\r\n";
+                conn.continue_sent = true;
+            }
+            break;
+        } else if (result == HTTP_PARSE_ERROR) {
+            log_info(LOG_HTTP, "parse_error").s("client", conn.client_ip).i("status", conn.parser.status())
+                .s("reason", conn.parser.reason());
+            conn.keep_alive = false;
+            reply_http(conn, conn.parser.status(),
+                       "{\"error\":\"" + std::string(conn.parser.reason()) + "\",\"code\":" +
+                       std::to_string(conn.parser.status()) + "}",
+                       config);
+            conn.out += conn.reply;
+            conn.reply.clear();
+            conn.closing = true;
+        } else {
+            // The first request on a connection is timed from accept
+            auto received_from = conn.requests_served == 0 ? conn.accepted_at : conn.request_started;
+            metrics_observe_since(STAGE_ACCEPT_TO_PARSE, received_from);
 
-            if (verbose_mode) {
-                std::cout << "Read additional " << additional_read << " bytes" << std::endl;
-                std::cout << "Total body received: " << body_received << "/" << content_length << std::endl;
+            // Join the caller's trace if it sent one
+            if (!trace_id_from_traceparent(request.header("traceparent"), conn.trace)) {
+                conn.trace = trace_id_new();
+            }
+            trace_span(conn.trace, 0, "receive", received_from, std::chrono::steady_clock::now(),
+                       conn.client_ip);
+            conn.requests_served++;
+            conn.keep_alive = wants_keep_alive(request) &&
+                              conn.requests_served < config.HTTP_KEEPALIVE_MAX_REQUESTS &&
+                              !health.draining.load(std::memory_order_relaxed);
+
+            if (handle_probe_request(conn, request, health, queue, config)) {
+                complete_http_request(conn);
+                continue;
             }
+            conn.busy = true;
+
+            // The request views point into conn.in, which stays untouched while busy.
+            // Reloads swap the credentials and clear the auth cache on this
+            // thread too, so the generation read here matches credentials.
+            HttpConnection* target = &conn;
+            uint64_t auth_generation = auth_cache.generation();
+            workers.submit([target, request, credentials, &auth_cache, auth_generation, &queue, &limiter,
+                            &completions, &config] {
+                handle_http_request(*target, request, *credentials, auth_cache, auth_generation, queue, limiter,
+                                    config);
+                metrics_observe_since(STAGE_REQUEST_TOTAL, target->request_started);
+                if (tracer().enabled()) {
+                    trace_span(target->trace, 0, "http_request", target->request_started,
+                               std::chrono::steady_clock::now(),
+                               std::string(request.method) + " " + std::string(request.path));
+                }
+                completions.push(target);
+            });
+            return;
+        }
+    }
+
+    if (conn.eof && !conn.busy) {
+        conn.closing = true;
+    }
+}
+
+// Answers 408 and closes if the request being received has run past its
+// header or body deadline, however steadily bytes are still trickling in.
+void check_http_deadline(HttpConnection& conn, std::chrono::steady_clock::time_point now,
+                         const Config& config) {
+    if (conn.busy || conn.closing || conn.in.empty()) {
+        return;
+    }
+
+    bool headers_done = conn.parser.headers_complete();
+    auto since = headers_done ? conn.body_started : conn.request_started;
+    auto allowed = std::chrono::seconds(headers_done ? config.HTTP_BODY_TIMEOUT : config.HTTP_HEADER_TIMEOUT);
+    if (now - since <= allowed) {
+        return;
+    }
+
+    log_info(LOG_HTTP, "request_timeout").s("client", conn.client_ip).i("port", conn.client_port)
+        .s("waiting_for", headers_done ? "body" : "headers");
+    conn.keep_alive = false;
+    reply_http(conn, 408, "{\"error\":\"Request timeout\",\"code\":408}", config);
+    conn.out += conn.reply;
+    conn.reply.clear();
+    conn.closing = true;
+}
+
+// Returns false once the peer has closed the connection or it failed
+bool read_http_connection(HttpConnection& conn) {
+    char* dst = conn.in.write_ptr();
+    ssize_t bytes_read = read(conn.fd, dst, conn.in.write_space());
+
+    if (bytes_read > 0) {
+        conn.last_activity = std::chrono::steady_clock::now();
+        if (conn.in.empty()) {
+            conn.request_started = conn.last_activity;
         }
+        conn.in.commit(bytes_read);
+        log_trace(LOG_HTTP, "read").s("client", conn.client_ip).i("bytes", bytes_read).u("buffered", conn.in.size());
+        return true;
     }
 
-    if (verbose_mode) {
-        std::cout << "Final HTTP Request (" << full_request.length() << " bytes):" << std::endl;
-        std::cout << "---" << std::endl << full_request << "---" << std::endl;
+    if (bytes_read < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+        return true;
     }
+    return false;
+}
 
-    HttpRequest request = parse_http_request(full_request);
-    log_parsed_request(request, verbose_mode);
-
-    // Check if it's a POST request
-    if (request.method != "POST") {
-        send_http_response(client_fd, 405, "Method Not Allowed",
-                          "{\"error\":\"Only POST method is allowed\",\"code\":405}",
-                          "application/json", verbose_mode);
-        return;
+// Returns false if the socket failed while writing (HTTP and serial connections)
+template <typename Connection>
+bool flush_connection(Connection& conn) {
+    while (!conn.out.empty()) {
+        ssize_t sent = send(conn.fd, conn.out.data(), conn.out.size(), MSG_NOSIGNAL);
+        if (sent > 0) {
+            conn.out.erase(0, sent);
+            conn.last_activity = std::chrono::steady_clock::now();
+        } else if (sent < 0 && errno == EINTR) {
+            continue;
+        } else if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return true;
+        } else {
+            return false;
+        }
     }
+    return true;
+}
 
-    // Check authentication
-    auto auth_it = request.headers.find("authorization");
-    if (auth_it == request.headers.end() || !authenticate_user(auth_it->second, passwords)) {
-        send_unauthorized_response(client_fd, verbose_mode);
+// Takes ownership of an accepted HTTP client; it is closed if the server is
+// full or the client already holds its share of connections
+void add_http_connection(std::map<int, std::unique_ptr<HttpConnection>>& connections,
+                         std::unique_ptr<HttpConnection> conn, ConnectionLimiter& limiter,
+                         const Config& config) {
+    if (connections.size() >= HTTP_MAX_CONNECTIONS) {
+        log_warn(LOG_HTTP, "rejected").s("client", conn->client_ip).s("reason", "too many connections");
+        close(conn->fd);
         return;
     }
-
-    // Parse JSON message
-    JsonMessage json_msg = parse_json_message(request.body);
-    if (!json_msg.valid) {
-        if (verbose_mode) {
-            std::cout << "*** JSON MESSAGE PARSING FAILED ***" << std::endl;
-            std::cout << "Body was: '" << request.body << "'" << std::endl;
-        }
-        send_http_response(client_fd, 400, "Bad Request",
-                          "{\"error\":\"Invalid JSON format or missing required fields\",\"code\":400}",
-                          "application/json", verbose_mode);
+    if (!limiter.acquire(conn->client_ip)) {
+        log_warn(LOG_HTTP, "rejected").s("client", conn->client_ip).s("reason", "too many connections from client");
+        close(conn->fd);
         return;
     }
 
-    // Validate required fields: capcode and message are MANDATORY
-    if (json_msg.capcode == 0) {
-        send_http_response(client_fd, 400, "Bad Request",
-                          "{\"error\":\"Missing required field: capcode must be specified\",\"code\":400}",
-                          "application/json", verbose_mode);
-        return;
-    }
+    conn->parser.set_limits(config.HTTP_MAX_HEADER_SIZE, config.HTTP_MAX_BODY_SIZE);
+    conn->last_activity = std::chrono::steady_clock::now();
+    conn->accepted_at = conn->last_activity;
 
-    if (json_msg.message.empty()) {
-        send_http_response(client_fd, 400, "Bad Request",
-                          "{\"error\":\"Missing required field: message must be specified\",\"code\":400}",
-                          "application/json", verbose_mode);
-        return;
+    if (conn->local_user.empty()) {
+        log_debug(LOG_HTTP, "connected").s("client", conn->client_ip).i("port", conn->client_port);
+    } else {
+        log_debug(LOG_HTTP, "connected").s("user", conn->local_user).i("pid", conn->client_port);
     }
+    int fd = conn->fd;
+    connections[fd] = std::move(conn);
+}
 
-    log_json_processing(json_msg, config.DEFAULT_FREQUENCY, verbose_mode);
+// Reads what is available on a serial or binary connection; false on EOF or error
+template <typename Connection>
+bool read_stream_connection(Connection& conn, log_component_t component) {
+    char* dst = conn.in.write_ptr();
+    ssize_t bytes_read = read(conn.fd, dst, conn.in.write_space());
 
-    // Use default frequency if not provided (frequency is optional)
-    uint64_t frequency = json_msg.frequency > 0 ? json_msg.frequency : config.DEFAULT_FREQUENCY;
+    if (bytes_read > 0) {
+        conn.in.commit(bytes_read);
+        conn.last_activity = std::chrono::steady_clock::now();
+        log_trace(component, "read").s("peer", conn.peer).i("bytes", bytes_read);
+        return true;
+    }
 
-    if (process_message(json_msg.capcode, json_msg.message, frequency, conn_state, config, debug_mode, verbose_mode)) {
-        send_http_response(client_fd, 200, "OK",
-                          "{\"status\":\"success\",\"message\":\"Message transmitted successfully\"}",
-                          "application/json", verbose_mode);
+    if (bytes_read < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+        return true;
+    }
+    return false;
+}
 
-        if (verbose_mode) {
-            std::cout << "HTTP client disconnected." << std::endl << std::endl;
-        }
-    } else {
-        send_http_response(client_fd, 500, "Internal Server Error",
-                          "{\"error\":\"Failed to process message\",\"code\":500}",
-                          "application/json", verbose_mode);
+// Takes ownership of an accepted serial or binary client; it is closed if the
+// server is full or the client already holds its share of connections
+template <typename Connection>
+void add_stream_connection(std::map<int, std::unique_ptr<Connection>>& connections, size_t max_connections,
+                           ConnectionLimiter& limiter, int client_fd, const std::string& client_ip,
+                           const std::string& peer, uint64_t id) {
+    if (connections.size() >= max_connections) {
+        log_warn(LOG_CORE, "rejected").s("peer", peer).s("reason", "too many connections");
+        close(client_fd);
+        return;
+    }
+    if (!limiter.acquire(client_ip)) {
+        log_warn(LOG_CORE, "rejected").s("peer", peer).s("reason", "too many connections from client");
+        close(client_fd);
+        return;
     }
+
+    auto conn = std::make_unique<Connection>();
+    conn->fd = client_fd;
+    conn->id = id;
+    conn->peer = peer;
+    conn->client_ip = client_ip;
+    conn->last_activity = std::chrono::steady_clock::now();
+    conn->progress = conn->last_activity;
+    connections[client_fd] = std::move(conn);
 }
 
+// Seconds the main loop keeps going after the drain deadline, to flush
+// replies to requests that were already being handled
+#define SHUTDOWN_FLUSH_SECONDS 5
+
 // Signal handler for graceful shutdown
 static volatile sig_atomic_t keep_running = 1;
+static volatile sig_atomic_t stop_signals = 0;     // a second one skips the drain
+static volatile sig_atomic_t stop_signal = 0;
+static volatile sig_atomic_t reload_requested = 0;
 
+// Only records the request; the main loop does the rest
 void signal_handler(int sig) {
-    (void)sig;
+    if (sig == SIGHUP) {
+        reload_requested = 1;
+        return;
+    }
     keep_running = 0;
-    printf("\nShutdown signal received, stopping server...\n");
+    stop_signal = sig;
+    stop_signals = stop_signals + 1;
+}
+
+// Files reread while the server runs, and what was last seen of each
+struct ReloadState {
+    std::string config_path;        // empty when the settings came from the environment
+    FileStamp config_stamp;
+    FileStamp passwords_stamp;
+    FileStamp api_tokens_stamp;
+    bool http_auth;                 // credentials are in use
+    bool keep_log_levels;           // --verbose overrides LOG_LEVELS
+};
+
+/**
+ * @brief Rereads config.ini and the credential files that changed (all of
+ * them when forced, on SIGHUP) and publishes them as new snapshots.
+ *
+ * Runs on the main loop. Requests and pages in progress keep the snapshot
+ * they started with. A file that cannot be read or does not validate is
+ * reported and the running settings stay as they are.
+ */
+void reload_settings(ReloadState& state, bool force, ConfigStore& configs,
+                     std::shared_ptr<const HttpCredentials>& credentials, AuthCache& auth_cache) {
+    const Config& current = configs.current();
+    bool config_changed = !state.config_path.empty() &&
+                          file_stamp_changed(state.config_path, state.config_stamp);
+    if (config_changed || (force && !state.config_path.empty())) {
+        Config loaded;
+        std::string error;
+        bool ok = false;
+        try {
+            ok = load_config(state.config_path, loaded);
+            if (!ok) {
+                error = strerror(errno);
+            }
+        } catch (const std::exception& e) {
+            error = std::string("invalid value (") + e.what() + ")";
+        }
+        ok = ok && validate_config(loaded, error);
+
+        Config next = current;
+        std::vector<std::string> changed = config_apply_reloadable(next, loaded);
+        std::vector<std::string> pending = config_restart_changes(current, loaded);
+        if (ok && !state.keep_log_levels && next.LOG_LEVELS != current.LOG_LEVELS) {
+            ok = logger().set_levels(next.LOG_LEVELS, error);
+        }
+        auto join = [](const std::vector<std::string>& list) {
+            std::string names;
+            for (const std::string& name : list) {
+                names += (names.empty() ? "" : ",") + name;
+            }
+            return names;
+        };
+        if (!ok) {
+            log_error(LOG_CORE, "config_reload_failed").s("path", state.config_path).s("error", error);
+        } else {
+            if (!changed.empty()) {
+                configs.publish(next);
+                log_info(LOG_CORE, "config_reloaded").s("path", state.config_path).s("changed", join(changed));
+            } else if (pending.empty()) {
+                log_info(LOG_CORE, "config_unchanged").s("path", state.config_path);
+            }
+            // Edited, but the running server keeps the old values
+            if (!pending.empty()) {
+                log_warn(LOG_CORE, "config_restart_required").s("path", state.config_path)
+                    .s("keys", join(pending));
+            }
+        }
+    }
+
+    // Cached logins may no longer be valid once the credentials change
+    if (!state.http_auth) {
+        return;
+    }
+    bool passwords_changed = file_stamp_changed(current.HTTP_AUTH_CREDENTIALS, state.passwords_stamp) || force;
+    bool tokens_changed = file_stamp_changed(current.HTTP_API_TOKENS, state.api_tokens_stamp) || force;
+    if (passwords_changed || tokens_changed) {
+        auto updated = std::make_shared<HttpCredentials>(*credentials);
+        if (passwords_changed) {
+            updated->passwords = load_passwords(current.HTTP_AUTH_CREDENTIALS);
+            log_info(LOG_CORE, "passwords_reloaded").u("users", updated->passwords.size());
+        }
+        if (tokens_changed) {
+            log_info(LOG_CORE, "api_tokens_reloaded").u("tokens", updated->api_tokens.load(current.HTTP_API_TOKENS));
+        }
+        credentials = updated;
+        auth_cache.clear();
+    }
 }
 
 int main(int argc, char* argv[]) {
-    // Setup signal handlers
-    signal(SIGINT, signal_handler);
-    signal(SIGTERM, signal_handler);
+    // Setup signal handlers. Only the main loop takes them: every other
+    // thread inherits a mask that blocks them, so a stop or reload request
+    // never cuts an AT exchange or a sleep short with EINTR.
+    struct sigaction signal_action;
+    memset(&signal_action, 0, sizeof(signal_action));
+    signal_action.sa_handler = signal_handler;
+    sigemptyset(&signal_action.sa_mask);
+    sigaction(SIGINT, &signal_action, nullptr);
+    sigaction(SIGTERM, &signal_action, nullptr);
+    sigaction(SIGHUP, &signal_action, nullptr);
+    sigset_t handled_signals;
+    sigemptyset(&handled_signals);
+    sigaddset(&handled_signals, SIGINT);
+    sigaddset(&handled_signals, SIGTERM);
+    sigaddset(&handled_signals, SIGHUP);
+    pthread_sigmask(SIG_BLOCK, &handled_signals, nullptr);
 
     // Parse CLI arguments
     bool debug_mode = false;
@@ -571,10 +1716,13 @@ int main(int argc, char* argv[]) {
 
     Config config;
     bool config_loaded = false;
+    ReloadState reload_state;
 
     // Try to load config.ini first
     if (load_config("config.ini", config)) {
         config_loaded = true;
+        reload_state.config_path = "config.ini";
+        file_stamp_changed(reload_state.config_path, reload_state.config_stamp);
         if (verbose_mode) {
             std::cout << "Configuration loaded from config.ini" << std::endl;
         }
@@ -587,21 +1735,95 @@ int main(int argc, char* argv[]) {
         const char* env_bind = getenv("BIND_ADDRESS");
         const char* env_serial_port = getenv("SERIAL_LISTEN_PORT");
         const char* env_http_port = getenv("HTTP_LISTEN_PORT");
+        const char* env_binary_port = getenv("BINARY_LISTEN_PORT");
         const char* env_auth_credentials = getenv("HTTP_AUTH_CREDENTIALS");
         const char* env_flex_device = getenv("FLEX_DEVICE");
         const char* env_flex_baudrate = getenv("FLEX_BAUDRATE");
         const char* env_flex_power = getenv("FLEX_POWER");
         const char* env_default_freq = getenv("DEFAULT_FREQUENCY");
+        const char* env_http_keepalive_timeout = getenv("HTTP_KEEPALIVE_TIMEOUT");
+        const char* env_http_keepalive_max_requests = getenv("HTTP_KEEPALIVE_MAX_REQUESTS");
+        const char* env_http_auth_cache_ttl = getenv("HTTP_AUTH_CACHE_TTL");
+        const char* env_http_auth_cache_size = getenv("HTTP_AUTH_CACHE_SIZE");
+        const char* env_http_api_tokens = getenv("HTTP_API_TOKENS");
+        const char* env_http_worker_threads = getenv("HTTP_WORKER_THREADS");
+        const char* env_encoder_threads = getenv("ENCODER_THREADS");
+        const char* env_listen_backlog = getenv("LISTEN_BACKLOG");
+        const char* env_listen_reuseport = getenv("LISTEN_REUSEPORT");
+        const char* env_listen_defer_accept = getenv("LISTEN_DEFER_ACCEPT");
+        const char* env_listen_fastopen = getenv("LISTEN_FASTOPEN");
+        const char* env_http_unix_socket = getenv("HTTP_UNIX_SOCKET");
+        const char* env_serial_unix_socket = getenv("SERIAL_UNIX_SOCKET");
+        const char* env_unix_socket_mode = getenv("UNIX_SOCKET_MODE");
+        const char* env_unix_socket_allow = getenv("UNIX_SOCKET_ALLOW");
+        const char* env_http_header_timeout = getenv("HTTP_HEADER_TIMEOUT");
+        const char* env_http_body_timeout = getenv("HTTP_BODY_TIMEOUT");
+        const char* env_http_max_header_size = getenv("HTTP_MAX_HEADER_SIZE");
+        const char* env_http_max_body_size = getenv("HTTP_MAX_BODY_SIZE");
+        const char* env_max_connections_per_ip = getenv("MAX_CONNECTIONS_PER_IP");
+        const char* env_priority_aging_seconds = getenv("PRIORITY_AGING_SECONDS");
+        const char* env_dedup_window_seconds = getenv("DEDUP_WINDOW_SECONDS");
+        const char* env_rate_limit_per_user = getenv("RATE_LIMIT_PER_USER");
+        const char* env_rate_limit_per_ip = getenv("RATE_LIMIT_PER_IP");
+        const char* env_rate_limit_per_capcode = getenv("RATE_LIMIT_PER_CAPCODE");
+        const char* env_rate_limit_burst = getenv("RATE_LIMIT_BURST");
+        const char* env_flex_bitrate = getenv("FLEX_BITRATE");
+        const char* env_transmit_overhead_ms = getenv("TRANSMIT_OVERHEAD_MS");
+        const char* env_queue_sla_seconds = getenv("QUEUE_SLA_SECONDS");
+        const char* env_max_queued_pages = getenv("MAX_QUEUED_PAGES");
+        const char* env_log_levels = getenv("LOG_LEVELS");
+        const char* env_trace_file = getenv("TRACE_FILE");
+        const char* env_ready_queue_threshold = getenv("READY_QUEUE_THRESHOLD");
+        const char* env_wal_file = getenv("WAL_FILE");
+        const char* env_shutdown_drain_seconds = getenv("SHUTDOWN_DRAIN_SECONDS");
+        const char* env_handoff_socket = getenv("HANDOFF_SOCKET");
 
         // Set defaults
         config.BIND_ADDRESS = env_bind ? std::string(env_bind) : "127.0.0.1";
         config.SERIAL_LISTEN_PORT = env_serial_port ? std::stoul(env_serial_port) : 16175;
         config.HTTP_LISTEN_PORT = env_http_port ? std::stoul(env_http_port) : 16180;
+        config.BINARY_LISTEN_PORT = env_binary_port ? std::stoul(env_binary_port) : 0;
         config.HTTP_AUTH_CREDENTIALS = env_auth_credentials ? std::string(env_auth_credentials) : "passwords";
         config.FLEX_DEVICE = env_flex_device ? std::string(env_flex_device) : "/dev/ttyUSB0";
         config.FLEX_BAUDRATE = env_flex_baudrate ? std::stoul(env_flex_baudrate) : 115200;
         config.FLEX_POWER = env_flex_power ? std::stoi(env_flex_power) : 2;
         config.DEFAULT_FREQUENCY = env_default_freq ? std::stoull(env_default_freq) : 916000000;
+        config.HTTP_KEEPALIVE_TIMEOUT = env_http_keepalive_timeout ? std::stoul(env_http_keepalive_timeout) : 5;
+        config.HTTP_KEEPALIVE_MAX_REQUESTS = env_http_keepalive_max_requests ? std::stoul(env_http_keepalive_max_requests) : 100;
+        config.HTTP_AUTH_CACHE_TTL = env_http_auth_cache_ttl ? std::stoul(env_http_auth_cache_ttl) : 300;
+        config.HTTP_AUTH_CACHE_SIZE = env_http_auth_cache_size ? std::stoul(env_http_auth_cache_size) : 1024;
+        config.HTTP_API_TOKENS = env_http_api_tokens ? std::string(env_http_api_tokens) : "tokens";
+        config.HTTP_WORKER_THREADS = env_http_worker_threads ? std::stoul(env_http_worker_threads) : 2;
+        config.ENCODER_THREADS = env_encoder_threads ? std::stoul(env_encoder_threads) : 1;
+        config.LISTEN_BACKLOG = env_listen_backlog ? std::stoul(env_listen_backlog) : 128;
+        config.LISTEN_REUSEPORT = env_listen_reuseport ? std::stoul(env_listen_reuseport) : 0;
+        config.LISTEN_DEFER_ACCEPT = env_listen_defer_accept ? std::stoul(env_listen_defer_accept) : 0;
+        config.LISTEN_FASTOPEN = env_listen_fastopen ? std::stoul(env_listen_fastopen) : 0;
+        config.HTTP_UNIX_SOCKET = env_http_unix_socket ? std::string(env_http_unix_socket) : "";
+        config.SERIAL_UNIX_SOCKET = env_serial_unix_socket ? std::string(env_serial_unix_socket) : "";
+        config.UNIX_SOCKET_MODE = env_unix_socket_mode ? std::stoul(env_unix_socket_mode, nullptr, 8) : 0660;
+        config.UNIX_SOCKET_ALLOW = env_unix_socket_allow ? std::string(env_unix_socket_allow) : "";
+        config.HTTP_HEADER_TIMEOUT = env_http_header_timeout ? std::stoul(env_http_header_timeout) : 10;
+        config.HTTP_BODY_TIMEOUT = env_http_body_timeout ? std::stoul(env_http_body_timeout) : 30;
+        config.HTTP_MAX_HEADER_SIZE = env_http_max_header_size ? std::stoul(env_http_max_header_size) : 8192;
+        config.HTTP_MAX_BODY_SIZE = env_http_max_body_size ? std::stoul(env_http_max_body_size) : 1048576;
+        config.MAX_CONNECTIONS_PER_IP = env_max_connections_per_ip ? std::stoul(env_max_connections_per_ip) : 32;
+        config.PRIORITY_AGING_SECONDS = env_priority_aging_seconds ? std::stoul(env_priority_aging_seconds) : 60;
+        config.DEDUP_WINDOW_SECONDS = env_dedup_window_seconds ? std::stoul(env_dedup_window_seconds) : 60;
+        config.RATE_LIMIT_PER_USER = env_rate_limit_per_user ? std::stoul(env_rate_limit_per_user) : 60;
+        config.RATE_LIMIT_PER_IP = env_rate_limit_per_ip ? std::stoul(env_rate_limit_per_ip) : 60;
+        config.RATE_LIMIT_PER_CAPCODE = env_rate_limit_per_capcode ? std::stoul(env_rate_limit_per_capcode) : 12;
+        config.RATE_LIMIT_BURST = env_rate_limit_burst ? std::stoul(env_rate_limit_burst) : 20;
+        config.FLEX_BITRATE = env_flex_bitrate ? std::stoul(env_flex_bitrate) : 1600;
+        config.TRANSMIT_OVERHEAD_MS = env_transmit_overhead_ms ? std::stoul(env_transmit_overhead_ms) : 3000;
+        config.QUEUE_SLA_SECONDS = env_queue_sla_seconds ? std::stoul(env_queue_sla_seconds) : 300;
+        config.MAX_QUEUED_PAGES = env_max_queued_pages ? std::stoul(env_max_queued_pages) : 1000;
+        config.LOG_LEVELS = env_log_levels ? std::string(env_log_levels) : "info";
+        config.TRACE_FILE = env_trace_file ? std::string(env_trace_file) : "";
+        config.READY_QUEUE_THRESHOLD = env_ready_queue_threshold ? std::stoul(env_ready_queue_threshold) : 100;
+        config.WAL_FILE = env_wal_file ? std::string(env_wal_file) : "";
+        config.SHUTDOWN_DRAIN_SECONDS = env_shutdown_drain_seconds ? std::stoul(env_shutdown_drain_seconds) : 20;
+        config.HANDOFF_SOCKET = env_handoff_socket ? std::string(env_handoff_socket) : "";
 
         config_loaded = true;
     }
@@ -612,8 +1834,49 @@ int main(int argc, char* argv[]) {
     }
 
     // Validate FLEX configuration
-    if (config.FLEX_POWER < 2 || config.FLEX_POWER > 20) {
-        std::cerr << "Invalid FLEX_POWER: " << config.FLEX_POWER << " (must be 2-20)" << std::endl;
+    std::string config_error;
+    if (!validate_config(config, config_error)) {
+        std::cerr << config_error << std::endl;
+        return 2;
+    }
+    std::string log_levels_error;
+    if (!logger().set_levels(verbose_mode ? "trace" : config.LOG_LEVELS, log_levels_error)) {
+        std::cerr << "Invalid LOG_LEVELS: " << log_levels_error << std::endl;
+        return 2;
+    }
+    std::string trace_error;
+    if (!config.TRACE_FILE.empty() && !tracer().start(config.TRACE_FILE, trace_error)) {
+        std::cerr << "Cannot open TRACE_FILE " << config.TRACE_FILE << ": " << trace_error << std::endl;
+        return 2;
+    }
+
+    // Listening sockets from systemd socket activation or, failing that, from
+    // the server this process replaces. The old server has to be gone before
+    // the device and the page log are opened; until then new clients queue
+    // in the listen backlog.
+    InheritedListeners inherited;
+    if (inherited.load_systemd() > 0) {
+        printf("Using %zu listening socket(s) from systemd\n", inherited.size());
+    } else if (!config.HANDOFF_SOCKET.empty()) {
+        std::string handoff_error;
+        int handoff_fd = handoff_request(config.HANDOFF_SOCKET, inherited, handoff_error);
+        if (handoff_fd >= 0) {
+            printf("Took over %zu listening socket(s), waiting for the running server to stop\n", inherited.size());
+            handoff_wait_release(handoff_fd);
+        } else if (!handoff_error.empty()) {
+            std::cerr << "Listener handoff through " << config.HANDOFF_SOCKET << " failed: " << handoff_error
+                      << std::endl;
+        }
+    }
+
+    // Pages accepted before the last shutdown or crash that were never sent
+    PageWal page_wal;
+    std::vector<WalPage> recovered_pages;
+    uint64_t first_free_job_id = 1;
+    std::string wal_error;
+    if (!config.WAL_FILE.empty() &&
+        !page_wal.open(config.WAL_FILE, recovered_pages, first_free_job_id, wal_error)) {
+        std::cerr << "Cannot open WAL_FILE " << config.WAL_FILE << ": " << wal_error << std::endl;
         return 2;
     }
 
@@ -622,17 +1885,56 @@ int main(int argc, char* argv[]) {
         std::cout << "  BIND_ADDRESS: " << config.BIND_ADDRESS << std::endl;
         std::cout << "  SERIAL_LISTEN_PORT: " << config.SERIAL_LISTEN_PORT << std::endl;
         std::cout << "  HTTP_LISTEN_PORT: " << config.HTTP_LISTEN_PORT << std::endl;
+        std::cout << "  BINARY_LISTEN_PORT: " << config.BINARY_LISTEN_PORT << std::endl;
         std::cout << "  HTTP_AUTH_CREDENTIALS: " << config.HTTP_AUTH_CREDENTIALS << std::endl;
         std::cout << "  FLEX_DEVICE: " << config.FLEX_DEVICE << std::endl;
         std::cout << "  FLEX_BAUDRATE: " << config.FLEX_BAUDRATE << std::endl;
         std::cout << "  FLEX_POWER: " << config.FLEX_POWER << std::endl;
         std::cout << "  DEFAULT_FREQUENCY: " << config.DEFAULT_FREQUENCY << std::endl;
+        std::cout << "  HTTP_KEEPALIVE_TIMEOUT: " << config.HTTP_KEEPALIVE_TIMEOUT << std::endl;
+        std::cout << "  HTTP_KEEPALIVE_MAX_REQUESTS: " << config.HTTP_KEEPALIVE_MAX_REQUESTS << std::endl;
+        std::cout << "  HTTP_AUTH_CACHE_TTL: " << config.HTTP_AUTH_CACHE_TTL << std::endl;
+        std::cout << "  HTTP_AUTH_CACHE_SIZE: " << config.HTTP_AUTH_CACHE_SIZE << std::endl;
+        std::cout << "  HTTP_API_TOKENS: " << config.HTTP_API_TOKENS << std::endl;
+        std::cout << "  HTTP_WORKER_THREADS: " << config.HTTP_WORKER_THREADS << std::endl;
+        std::cout << "  ENCODER_THREADS: " << config.ENCODER_THREADS << std::endl;
+        std::cout << "  LISTEN_BACKLOG: " << config.LISTEN_BACKLOG << std::endl;
+        std::cout << "  LISTEN_REUSEPORT: " << config.LISTEN_REUSEPORT << std::endl;
+        std::cout << "  LISTEN_DEFER_ACCEPT: " << config.LISTEN_DEFER_ACCEPT << std::endl;
+        std::cout << "  LISTEN_FASTOPEN: " << config.LISTEN_FASTOPEN << std::endl;
+        std::cout << "  HTTP_UNIX_SOCKET: " << config.HTTP_UNIX_SOCKET << std::endl;
+        std::cout << "  SERIAL_UNIX_SOCKET: " << config.SERIAL_UNIX_SOCKET << std::endl;
+        std::cout << "  UNIX_SOCKET_MODE: " << std::oct << config.UNIX_SOCKET_MODE << std::dec << std::endl;
+        std::cout << "  UNIX_SOCKET_ALLOW: " << config.UNIX_SOCKET_ALLOW << std::endl;
+        std::cout << "  HTTP_HEADER_TIMEOUT: " << config.HTTP_HEADER_TIMEOUT << std::endl;
+        std::cout << "  HTTP_BODY_TIMEOUT: " << config.HTTP_BODY_TIMEOUT << std::endl;
+        std::cout << "  HTTP_MAX_HEADER_SIZE: " << config.HTTP_MAX_HEADER_SIZE << std::endl;
+        std::cout << "  HTTP_MAX_BODY_SIZE: " << config.HTTP_MAX_BODY_SIZE << std::endl;
+        std::cout << "  MAX_CONNECTIONS_PER_IP: " << config.MAX_CONNECTIONS_PER_IP << std::endl;
+        std::cout << "  PRIORITY_AGING_SECONDS: " << config.PRIORITY_AGING_SECONDS << std::endl;
+        std::cout << "  DEDUP_WINDOW_SECONDS: " << config.DEDUP_WINDOW_SECONDS << std::endl;
+        std::cout << "  RATE_LIMIT_PER_USER: " << config.RATE_LIMIT_PER_USER << std::endl;
+        std::cout << "  RATE_LIMIT_PER_IP: " << config.RATE_LIMIT_PER_IP << std::endl;
+        std::cout << "  RATE_LIMIT_PER_CAPCODE: " << config.RATE_LIMIT_PER_CAPCODE << std::endl;
+        std::cout << "  RATE_LIMIT_BURST: " << config.RATE_LIMIT_BURST << std::endl;
+        std::cout << "  FLEX_BITRATE: " << config.FLEX_BITRATE << std::endl;
+        std::cout << "  TRANSMIT_OVERHEAD_MS: " << config.TRANSMIT_OVERHEAD_MS << std::endl;
+        std::cout << "  QUEUE_SLA_SECONDS: " << config.QUEUE_SLA_SECONDS << std::endl;
+        std::cout << "  MAX_QUEUED_PAGES: " << config.MAX_QUEUED_PAGES << std::endl;
+        std::cout << "  LOG_LEVELS: " << config.LOG_LEVELS << std::endl;
+        std::cout << "  TRACE_FILE: " << config.TRACE_FILE << std::endl;
+        std::cout << "  READY_QUEUE_THRESHOLD: " << config.READY_QUEUE_THRESHOLD << std::endl;
+        std::cout << "  WAL_FILE: " << config.WAL_FILE << std::endl;
+        std::cout << "  SHUTDOWN_DRAIN_SECONDS: " << config.SHUTDOWN_DRAIN_SECONDS << std::endl;
+        std::cout << "  HANDOFF_SOCKET: " << config.HANDOFF_SOCKET << std::endl;
     }
 
-    // Check if both ports are disabled
-    if (config.SERIAL_LISTEN_PORT == 0 && config.HTTP_LISTEN_PORT == 0) {
-        std::cerr << "Error: Both SERIAL_LISTEN_PORT and HTTP_LISTEN_PORT are disabled (set to 0)!" << std::endl;
-        std::cerr << "At least one port must be enabled." << std::endl;
+    // Check if every listener is disabled
+    if (config.SERIAL_LISTEN_PORT == 0 && config.HTTP_LISTEN_PORT == 0 && config.BINARY_LISTEN_PORT == 0 &&
+        config.SERIAL_UNIX_SOCKET.empty() && config.HTTP_UNIX_SOCKET.empty()) {
+        std::cerr << "Error: SERIAL_LISTEN_PORT, HTTP_LISTEN_PORT and BINARY_LISTEN_PORT are all disabled (set to 0)"
+                  << " and no unix socket is configured!" << std::endl;
+        std::cerr << "At least one listener must be enabled." << std::endl;
         return 2;
     }
 
@@ -646,7 +1948,7 @@ int main(int argc, char* argv[]) {
         }
 
         // Test AT communication
-        if (at_initialize_flex_device(test_fd, verbose_mode) < 0) {
+        if (at_initialize_flex_device(test_fd) < 0) {
             std::cerr << "Failed to initialize FLEX device with AT commands" << std::endl;
             std::cerr << "Verify that flex-fsk-tx firmware is loaded and AT commands are working." << std::endl;
             close_flex_at_serial(test_fd);
@@ -662,10 +1964,22 @@ int main(int argc, char* argv[]) {
     // Setup servers
     int serial_server_fd = -1;
     int http_server_fd = -1;
-    struct sockaddr_in serial_address, http_address;
+    int binary_server_fd = -1;
+
+    TcpListenOptions listen_options;
+    listen_options.backlog = config.LISTEN_BACKLOG;
+    listen_options.reuse_port = config.LISTEN_REUSEPORT != 0;
+    listen_options.defer_accept = config.LISTEN_DEFER_ACCEPT;
+    listen_options.fastopen = config.LISTEN_FASTOPEN;
+
+    // Inherited sockets are used as they are; the rest are bound here
+    auto listen_tcp = [&](int port) {
+        int fd = inherited.take_tcp(port);
+        return fd >= 0 ? fd : setup_tcp_server(port, config.BIND_ADDRESS, listen_options);
+    };
 
     if (config.SERIAL_LISTEN_PORT > 0) {
-        serial_server_fd = setup_tcp_server(config.SERIAL_LISTEN_PORT, serial_address, config.BIND_ADDRESS);
+        serial_server_fd = listen_tcp(config.SERIAL_LISTEN_PORT);
         if (serial_server_fd < 0) {
             std::cerr << "Failed to setup serial TCP server" << std::endl;
             return 3;
@@ -676,7 +1990,7 @@ int main(int argc, char* argv[]) {
     }
 
     if (config.HTTP_LISTEN_PORT > 0) {
-        http_server_fd = setup_tcp_server(config.HTTP_LISTEN_PORT, http_address, config.BIND_ADDRESS);
+        http_server_fd = listen_tcp(config.HTTP_LISTEN_PORT);
         if (http_server_fd < 0) {
             if (serial_server_fd >= 0) close(serial_server_fd);
             std::cerr << "Failed to setup HTTP server" << std::endl;
@@ -687,8 +2001,20 @@ int main(int argc, char* argv[]) {
         printf("HTTP server disabled (port = 0)\n");
     }
 
+    if (config.BINARY_LISTEN_PORT > 0) {
+        binary_server_fd = listen_tcp(config.BINARY_LISTEN_PORT);
+        if (binary_server_fd < 0) {
+            if (serial_server_fd >= 0) close(serial_server_fd);
+            if (http_server_fd >= 0) close(http_server_fd);
+            std::cerr << "Failed to setup binary protocol server" << std::endl;
+            return 3;
+        }
+        printf("Binary protocol server listening on %s:%d\n", config.BIND_ADDRESS.c_str(), config.BINARY_LISTEN_PORT);
+    }
+
     // Load or create passwords file for HTTP authentication
-    std::map<std::string, std::string> passwords;
+    auto credentials = std::make_shared<HttpCredentials>();
+    std::map<std::string, std::string>& passwords = credentials->passwords;
     if (config.HTTP_LISTEN_PORT > 0) {
         passwords = load_passwords(config.HTTP_AUTH_CREDENTIALS);
         if (passwords.empty()) {
@@ -701,6 +2027,7 @@ int main(int argc, char* argv[]) {
                           << config.HTTP_AUTH_CREDENTIALS << "'!" << std::endl;
                 if (serial_server_fd >= 0) close(serial_server_fd);
                 if (http_server_fd >= 0) close(http_server_fd);
+                if (binary_server_fd >= 0) close(binary_server_fd);
                 return 4;
             }
         }
@@ -710,98 +2037,762 @@ int main(int argc, char* argv[]) {
         }
     }
 
-    ConnectionState conn_state;
-    printf("FLEX HTTP/TCP Server ready, waiting for connections...\n");
-    printf("Press Ctrl+C to stop the server gracefully.\n");
+    // Verified logins are cached until they expire or the password file changes
+    AuthCache auth_cache(config.HTTP_AUTH_CACHE_SIZE, config.HTTP_AUTH_CACHE_TTL);
+    reload_state.http_auth = config.HTTP_LISTEN_PORT > 0;
+    reload_state.keep_log_levels = verbose_mode;
+    file_stamp_changed(config.HTTP_AUTH_CREDENTIALS, reload_state.passwords_stamp);
+
+    // Bearer tokens for machine clients; the file is optional
+    if (config.HTTP_LISTEN_PORT > 0) {
+        credentials->api_tokens.load(config.HTTP_API_TOKENS);
+        file_stamp_changed(config.HTTP_API_TOKENS, reload_state.api_tokens_stamp);
+        if (verbose_mode) {
+            std::cout << "Loaded " << credentials->api_tokens.size() << " API token(s) from '"
+                      << config.HTTP_API_TOKENS << "'" << std::endl;
+        }
+    }
+    // Local listeners; peers are checked with SO_PEERCRED instead of a password
+    UnixPeerPolicy unix_peers;
+    int serial_unix_fd = -1;
+    int http_unix_fd = -1;
+    // Paths of sockets systemd created are systemd's to remove
+    bool unlink_unix_sockets = !inherited.systemd();
+    auto listen_unix = [&](const std::string& path) {
+        int fd = inherited.take_unix(path);
+        return fd >= 0 ? fd : setup_unix_server(path, config.UNIX_SOCKET_MODE, config.LISTEN_BACKLOG);
+    };
+    if (!config.SERIAL_UNIX_SOCKET.empty() || !config.HTTP_UNIX_SOCKET.empty()) {
+        bool unix_ok = unix_peers.load(config.UNIX_SOCKET_ALLOW);
+        if (unix_ok && !config.SERIAL_UNIX_SOCKET.empty()) {
+            serial_unix_fd = listen_unix(config.SERIAL_UNIX_SOCKET);
+            unix_ok = serial_unix_fd >= 0;
+            if (unix_ok) {
+                printf("Serial server listening on unix socket %s\n", config.SERIAL_UNIX_SOCKET.c_str());
+            }
+        }
+        if (unix_ok && !config.HTTP_UNIX_SOCKET.empty()) {
+            http_unix_fd = listen_unix(config.HTTP_UNIX_SOCKET);
+            unix_ok = http_unix_fd >= 0;
+            if (unix_ok) {
+                printf("HTTP server listening on unix socket %s\n", config.HTTP_UNIX_SOCKET.c_str());
+            }
+        }
+        if (!unix_ok) {
+            std::cerr << "Failed to setup unix socket server" << std::endl;
+            if (serial_unix_fd >= 0) {
+                close(serial_unix_fd);
+                if (unlink_unix_sockets) {
+                    unlink(config.SERIAL_UNIX_SOCKET.c_str());
+                }
+            }
+            if (serial_server_fd >= 0) close(serial_server_fd);
+            if (http_server_fd >= 0) close(http_server_fd);
+            if (binary_server_fd >= 0) close(binary_server_fd);
+            return 3;
+        }
+    }
+
+    // Sockets the old server or systemd passed that no listener claimed
+    inherited.close_rest();
+
+    // Where the next server process asks for the listeners
+    int handoff_server_fd = -1;
+    int handoff_client_fd = -1;    // connected, takeover request not read yet
+    struct ucred handoff_client = {0, 0, 0};
+    std::string handoff_received;
+    std::chrono::steady_clock::time_point handoff_client_since;
+    int handoff_peer_fd = -1;      // kept open until this process has stopped
+    bool handed_off = false;
+    if (!config.HANDOFF_SOCKET.empty()) {
+        handoff_server_fd = setup_unix_server(config.HANDOFF_SOCKET, 0600, 4);
+        if (handoff_server_fd < 0) {
+            std::cerr << "Listener handoff disabled: cannot listen on " << config.HANDOFF_SOCKET << std::endl;
+        }
+    }
+
+    std::shared_ptr<const HttpCredentials> http_credentials = credentials;
+    credentials.reset();
+
+    // Settings and credential files are reread when inotify reports a change
+    // in their directories (polled every second without inotify) or on SIGHUP
+    FileWatch settings_watch;
+    std::vector<std::string> watched_files = {config.HTTP_AUTH_CREDENTIALS, config.HTTP_API_TOKENS};
+    if (!reload_state.config_path.empty()) {
+        watched_files.push_back(reload_state.config_path);
+    }
+    if (!settings_watch.watch(watched_files)) {
+        log_warn(LOG_CORE, "file_watch_unavailable").s("error", strerror(errno));
+    }
+    auto settings_checked = std::chrono::steady_clock::now();
+    bool settings_touched = false;
+
+    // Transmission results for serial and binary clients, reported by the radio side
+    EventQueue<PageResult> serial_results;
+    EventQueue<PageResult> binary_results;
+
+    // Pipeline: HTTP workers, serial and binary clients -> encoder pool -> radio thread.
+    // The radio thread is the only one that touches the transmitter.
+    JobQueue job_queue;
+    MpscQueue<RadioFrame> radio_queue;
+    ThreadPool encoders(config.ENCODER_THREADS);
+    job_queue.set_dedup_window(config.DEDUP_WINDOW_SECONDS);
+    job_queue.set_admission(AirtimeModel(config.FLEX_BITRATE, config.TRANSMIT_OVERHEAD_MS),
+                            config.QUEUE_SLA_SECONDS, config.MAX_QUEUED_PAGES);
+    job_queue.set_dispatch([&](const std::shared_ptr<Job>& job) {
+        encoders.submit([job, &job_queue, &radio_queue] {
+            encode_job(job, job_queue, radio_queue);
+        });
+    });
+    if (page_wal.enabled()) {
+        job_queue.set_wal(&page_wal);
+        job_queue.restore(recovered_pages, first_free_job_id);
+        size_t interrupted = std::count_if(recovered_pages.begin(), recovered_pages.end(),
+                                           [](const WalPage& page) { return page.started; });
+        log_info(LOG_QUEUE, "wal_replayed").s("path", config.WAL_FILE).u("pages", recovered_pages.size())
+            .u("interrupted", interrupted);
+        recovered_pages.clear();
+    }
+    // Settings the running server rereads; config itself keeps the startup values
+    ConfigStore config_store(config);
+    ServerHealth server_health;
+    std::thread radio_thread(radio_worker, std::ref(job_queue), std::ref(radio_queue), std::ref(server_health),
+                             std::cref(config_store),
+                             debug_mode);
+
+    RateLimiter rate_limiter(config.RATE_LIMIT_PER_USER, config.RATE_LIMIT_PER_IP,
+                             config.RATE_LIMIT_PER_CAPCODE, config.RATE_LIMIT_BURST);
+    ThreadPool workers(config.HTTP_WORKER_THREADS);
+    EventQueue<HttpConnection*> http_completions;
+    // Serial records and binary frames queued by the workers
+    EventQueue<SerialConnection*> serial_submissions;
+    EventQueue<BinaryConnection*> binary_submissions;
+
+    logger().start();
+    log_info(LOG_CORE, "ready").u("http_port", config.HTTP_LISTEN_PORT).u("serial_port", config.SERIAL_LISTEN_PORT)
+        .u("binary_port", config.BINARY_LISTEN_PORT).s("log_levels", logger().levels_spec())
+        .b("tracing", tracer().enabled());
+
+    // Open HTTP and serial connections, keyed by socket
+    std::map<int, std::unique_ptr<HttpConnection>> http_connections;
+    std::map<int, std::unique_ptr<SerialConnection>> serial_connections;
+    std::map<int, std::unique_ptr<BinaryConnection>> binary_connections;
+    uint64_t next_stream_id = 1;
+    ConnectionLimiter connection_limiter(config.MAX_CONNECTIONS_PER_IP);
+
+    // Result channels stay polled while draining, after the listeners are gone
+    bool serial_enabled = serial_server_fd >= 0 || serial_unix_fd >= 0;
+    bool http_enabled = http_server_fd >= 0 || http_unix_fd >= 0;
+    bool binary_enabled = binary_server_fd >= 0;
+    bool draining = false;
+    std::chrono::steady_clock::time_point drain_deadline;
+
+    // Every thread is running with the signals blocked; take them here
+    pthread_sigmask(SIG_UNBLOCK, &handled_signals, nullptr);
+
+    // Main server loop using poll() with proper signal handling
+    while (true) {
+        // Settings that can be reloaded come from the current snapshot
+        const Config& config = config_store.current();
+
+        if (!keep_running && !draining) {
+            // Stop taking connections; pages already accepted are still sent
+            // and connections with a request in progress are still answered
+            // After a handoff the sockets and their paths live on in the new
+            // process, which also sends whatever the page log still holds
+            draining = true;
+            server_health.draining = true;
+            uint32_t drain_seconds = (handed_off && page_wal.enabled()) ? 0 : config.SHUTDOWN_DRAIN_SECONDS;
+            drain_deadline = std::chrono::steady_clock::now() + std::chrono::seconds(drain_seconds);
+            log_info(LOG_CORE, "shutdown_started").s("reason", handed_off ? "handoff" : strsignal(stop_signal))
+                .u("pending", job_queue.outstanding()).u("drain_seconds", drain_seconds);
+            for (int* fd : {&serial_server_fd, &http_server_fd, &binary_server_fd}) {
+                if (*fd >= 0) {
+                    close(*fd);
+                    *fd = -1;
+                }
+            }
+            if (handed_off) {
+                unlink_unix_sockets = false;
+            }
+            if (serial_unix_fd >= 0) {
+                close(serial_unix_fd);
+                if (unlink_unix_sockets) {
+                    unlink(config.SERIAL_UNIX_SOCKET.c_str());
+                }
+                serial_unix_fd = -1;
+            }
+            if (http_unix_fd >= 0) {
+                close(http_unix_fd);
+                if (unlink_unix_sockets) {
+                    unlink(config.HTTP_UNIX_SOCKET.c_str());
+                }
+                http_unix_fd = -1;
+            }
+            if (handoff_server_fd >= 0) {
+                close(handoff_server_fd);
+                if (!handed_off) {
+                    unlink(config.HANDOFF_SOCKET.c_str());
+                }
+                handoff_server_fd = -1;
+            }
+            if (handoff_client_fd >= 0) {
+                close(handoff_client_fd);
+                handoff_client_fd = -1;
+            }
+        }
+        if (draining) {
+            auto now = std::chrono::steady_clock::now();
+            bool sending = job_queue.outstanding() > 0 && now < drain_deadline;
+            bool replying = false;
+            for (const auto& entry : http_connections) {
+                replying = replying || entry.second->busy || !entry.second->out.empty();
+            }
+            for (const auto& entry : serial_connections) {
+                replying = replying || entry.second->busy || !entry.second->out.empty() ||
+                           (sending && entry.second->outstanding > 0);
+            }
+            for (const auto& entry : binary_connections) {
+                replying = replying || entry.second->busy || !entry.second->out.empty() ||
+                           (sending && entry.second->outstanding > 0);
+            }
+            if (stop_signals > 1 || (!sending && !replying) ||
+                now >= drain_deadline + std::chrono::seconds(SHUTDOWN_FLUSH_SECONDS)) {
+                break;
+            }
+        }
 
-    // Main server loop using select() with proper signal handling
-    while (keep_running) {
-        fd_set read_fds;
-        FD_ZERO(&read_fds);
+        std::vector<struct pollfd> poll_fds;
+        poll_fds.reserve(8 + http_connections.size() + serial_connections.size() + binary_connections.size());
 
-        int max_fd = 0;
         if (serial_server_fd >= 0) {
-            FD_SET(serial_server_fd, &read_fds);
-            max_fd = std::max(max_fd, serial_server_fd);
+            poll_fds.push_back({serial_server_fd, POLLIN, 0});
+        }
+        if (serial_unix_fd >= 0) {
+            poll_fds.push_back({serial_unix_fd, POLLIN, 0});
+        }
+        if (serial_enabled) {
+            poll_fds.push_back({serial_results.fd(), POLLIN, 0});
+            poll_fds.push_back({serial_submissions.fd(), POLLIN, 0});
         }
         if (http_server_fd >= 0) {
-            FD_SET(http_server_fd, &read_fds);
-            max_fd = std::max(max_fd, http_server_fd);
+            poll_fds.push_back({http_server_fd, POLLIN, 0});
+        }
+        if (http_unix_fd >= 0) {
+            poll_fds.push_back({http_unix_fd, POLLIN, 0});
+        }
+        if (http_enabled) {
+            poll_fds.push_back({http_completions.fd(), POLLIN, 0});
+        }
+        if (binary_server_fd >= 0) {
+            poll_fds.push_back({binary_server_fd, POLLIN, 0});
+        }
+        if (binary_enabled) {
+            poll_fds.push_back({binary_results.fd(), POLLIN, 0});
+            poll_fds.push_back({binary_submissions.fd(), POLLIN, 0});
+        }
+        if (handoff_server_fd >= 0) {
+            poll_fds.push_back({handoff_server_fd, POLLIN, 0});
+        }
+        if (handoff_client_fd >= 0) {
+            poll_fds.push_back({handoff_client_fd, POLLIN, 0});
+        }
+        if (settings_watch.descriptor() >= 0) {
+            poll_fds.push_back({settings_watch.descriptor(), POLLIN, 0});
+        }
+        for (const auto& entry : http_connections) {
+            const HttpConnection& conn = *entry.second;
+            short events = (conn.closing || conn.busy || conn.eof) ? 0 : POLLIN;
+            if (!conn.out.empty()) {
+                events |= POLLOUT;
+            }
+            if (events == 0 && conn.busy) {
+                continue;  // nothing to do until the worker is finished
+            }
+            poll_fds.push_back({conn.fd, events, 0});
         }
 
-        // Shorter timeout for more responsive shutdown
-        struct timeval timeout;
-        timeout.tv_sec = 0;
-        timeout.tv_usec = 500000; // 500ms instead of 1 second
+        // Shorter timeout for more responsive shutdown; shorter still while
+        // draining or while a legacy serial client may be waiting on an
+        // unterminated record
+        int poll_timeout = (draining || handoff_client_fd >= 0) ? 100 : 500;
+        for (const auto& entry : serial_connections) {
+            const SerialConnection& conn = *entry.second;
+            short events = (conn.closing || conn.busy || conn.eof) ? 0 : POLLIN;
+            if (!conn.out.empty()) {
+                events |= POLLOUT;
+            }
+            if (events != 0) {
+                poll_fds.push_back({conn.fd, events, 0});
+            }
+            if (!conn.saw_newline && !conn.in.empty()) {
+                poll_timeout = std::min(poll_timeout, SERIAL_LEGACY_QUIET_MS);
+            }
+        }
+        for (const auto& entry : binary_connections) {
+            const BinaryConnection& conn = *entry.second;
+            short events = (conn.closing || conn.busy || conn.eof) ? 0 : POLLIN;
+            if (!conn.out.empty()) {
+                events |= POLLOUT;
+            }
+            if (events != 0) {
+                poll_fds.push_back({conn.fd, events, 0});
+            }
+        }
 
-        int activity = select(max_fd + 1, &read_fds, NULL, NULL, &timeout);
+        int activity = poll(poll_fds.data(), poll_fds.size(), poll_timeout);
 
-        // Check keep_running immediately after select returns
-        if (!keep_running) {
-            break;
+        // A stop request is handled at the top of the loop
+        if (!keep_running && !draining) {
+            continue;
         }
 
         if (activity < 0) {
             if (errno == EINTR) {
-                // Signal interrupted select - check keep_running and continue
                 continue;
             } else {
-                perror("select error");
+                log_error(LOG_CORE, "poll_failed").s("error", strerror(errno));
                 break;
             }
         }
 
-        if (activity == 0) {
-            // Timeout - just continue to check keep_running
-            continue;
-        }
+        for (const struct pollfd& pfd : poll_fds) {
+            if (pfd.revents == 0) {
+                continue;
+            }
+
+            if (pfd.fd == settings_watch.descriptor()) {
+                settings_touched = settings_watch.drain() || settings_touched;
+                continue;
+            }
+
+            // A replacement process asking for the listeners; only the same
+            // user (or root) may take them, and one at a time. Its request
+            // is read as it arrives, like any other connection.
+            if (pfd.fd == handoff_server_fd) {
+                struct ucred peer;
+                int client_fd = accept_unix_client(handoff_server_fd, peer);
+                if (client_fd < 0) {
+                    continue;
+                }
+                if ((peer.uid != geteuid() && peer.uid != 0) || handoff_client_fd >= 0) {
+                    log_warn(LOG_CORE, "handoff_refused").i("pid", peer.pid).u("uid", peer.uid)
+                        .s("reason", handoff_client_fd >= 0 ? "handoff in progress" : "not permitted");
+                    close(client_fd);
+                    continue;
+                }
+                handoff_client_fd = client_fd;
+                handoff_client = peer;
+                handoff_received.clear();
+                handoff_client_since = std::chrono::steady_clock::now();
+                continue;
+            }
+            if (pfd.fd == handoff_client_fd) {
+                int request = handoff_read_request(handoff_client_fd, handoff_received);
+                if (request == 0) {
+                    continue;
+                }
+                std::vector<int> listeners;
+                for (int fd : {serial_server_fd, http_server_fd, binary_server_fd, serial_unix_fd, http_unix_fd}) {
+                    if (fd >= 0) {
+                        listeners.push_back(fd);
+                    }
+                }
+                if (request < 0 || !handoff_send(handoff_client_fd, listeners)) {
+                    log_warn(LOG_CORE, "handoff_refused").i("pid", handoff_client.pid).u("uid", handoff_client.uid)
+                        .s("reason", request < 0 ? "bad request" : strerror(errno));
+                    close(handoff_client_fd);
+                    handoff_client_fd = -1;
+                    continue;
+                }
+                log_info(LOG_CORE, "handoff").i("pid", handoff_client.pid).u("sockets", listeners.size());
+                handoff_peer_fd = handoff_client_fd;
+                handoff_client_fd = -1;
+                handed_off = true;
+                keep_running = 0;
+                break;
+            }
+
+            // Handle serial TCP connections
+            if (pfd.fd == serial_server_fd) {
+                // Take everything the kernel has queued, not just one client per wakeup
+                std::string client_ip;
+                int client_port;
+                int client_fd;
+                while ((client_fd = accept_tcp_client(serial_server_fd, client_ip, client_port)) >= 0) {
+                    log_debug(LOG_SERIAL, "connected").s("client", client_ip).i("port", client_port);
+                    add_stream_connection(serial_connections, SERIAL_MAX_CONNECTIONS, connection_limiter, client_fd,
+                                          client_ip, client_ip + ":" + std::to_string(client_port),
+                                          next_stream_id++);
+                }
+                continue;
+            }
 
-        // Handle serial TCP connections
-        if (serial_server_fd >= 0 && FD_ISSET(serial_server_fd, &read_fds)) {
-            socklen_t serial_addrlen = sizeof(serial_address);
-            int client_fd = accept(serial_server_fd, (struct sockaddr *)&serial_address, &serial_addrlen);
-            if (client_fd >= 0) {
-                if (verbose_mode) {
-                    std::cout << "Serial TCP client connected from " << inet_ntoa(serial_address.sin_addr) << std::endl;
-                } else {
-                    printf("Serial TCP client connected!\n");
+            // Serial protocol on the unix socket
+            if (pfd.fd == serial_unix_fd) {
+                struct ucred peer;
+                int client_fd;
+                while ((client_fd = accept_unix_client(serial_unix_fd, peer)) >= 0) {
+                    if (!unix_peers.allows(peer)) {
+                        log_warn(LOG_CORE, "unix_peer_rejected").u("uid", peer.uid).i("pid", peer.pid);
+                        close(client_fd);
+                        continue;
+                    }
+                    log_debug(LOG_SERIAL, "connected").s("user", unix_user_name(peer.uid)).i("pid", peer.pid);
+                    std::string local_client = "unix:" + unix_user_name(peer.uid);
+                    add_stream_connection(serial_connections, SERIAL_MAX_CONNECTIONS, connection_limiter, client_fd,
+                                          local_client, local_client, next_stream_id++);
                 }
+                continue;
+            }
 
-                handle_serial_client(client_fd, conn_state, config, debug_mode, verbose_mode);
-                close(client_fd);
+            // Pages sent (or failed) on behalf of serial clients
+            if (pfd.fd == serial_results.fd()) {
+                for (const PageResult& result : serial_results.drain()) {
+                    auto it = serial_connections.find(result.fd);
+                    if (it == serial_connections.end() || it->second->id != result.conn_id) {
+                        continue;  // client already gone
+                    }
+                    SerialConnection& conn = *it->second;
+                    if (conn.busy) {
+                        conn.early.push_back(result);  // reported once the record is
+                        continue;
+                    }
+                    complete_serial_record(conn, result);
+                    process_serial_input(conn, job_queue, rate_limiter, serial_results, workers, serial_submissions);
+                    if (!flush_connection(conn)) {
+                        conn.out.clear();
+                        conn.closing = true;
+                    }
+                }
+                continue;
+            }
 
-                if (verbose_mode) {
-                    std::cout << "Serial TCP client connection closed." << std::endl;
+            // Serial records the workers have queued
+            if (pfd.fd == serial_submissions.fd()) {
+                for (SerialConnection* conn : serial_submissions.drain()) {
+                    complete_serial_submission(*conn, rate_limiter);
+                    for (const PageResult& result : conn->early) {
+                        complete_serial_record(*conn, result);
+                    }
+                    conn->early.clear();
+                    process_serial_input(*conn, job_queue, rate_limiter, serial_results, workers, serial_submissions);
+                    if (!flush_connection(*conn)) {
+                        conn->out.clear();
+                        conn->closing = true;
+                    }
                 }
+                continue;
             }
-        }
 
-        // Handle HTTP connections
-        if (http_server_fd >= 0 && FD_ISSET(http_server_fd, &read_fds)) {
-            socklen_t http_addrlen = sizeof(http_address);
-            int client_fd = accept(http_server_fd, (struct sockaddr *)&http_address, &http_addrlen);
-            if (client_fd >= 0) {
-                if (!verbose_mode) {
-                    printf("HTTP client connected!\n");
+            // Responses finished by the HTTP workers
+            if (pfd.fd == http_completions.fd()) {
+                for (HttpConnection* conn : http_completions.drain()) {
+                    complete_http_request(*conn);
+                    process_http_input(*conn, http_credentials, auth_cache, job_queue, rate_limiter, workers,
+                                       http_completions, server_health, config);
+                    if (!flush_connection(*conn)) {
+                        conn->out.clear();
+                        conn->closing = true;
+                    }
+                }
+                continue;
+            }
+
+            // Accept new HTTP connections
+            if (pfd.fd == http_server_fd) {
+                // Take everything the kernel has queued, not just one client per wakeup
+                auto conn = std::make_unique<HttpConnection>();
+                int client_fd;
+                while ((client_fd = accept_tcp_client(http_server_fd, conn->client_ip, conn->client_port)) >= 0) {
+                    conn->fd = client_fd;
+                    add_http_connection(http_connections, std::move(conn), connection_limiter, config);
+                    conn = std::make_unique<HttpConnection>();
+                }
+                continue;
+            }
+
+            // Local HTTP clients; the socket's owner is their identity
+            if (pfd.fd == http_unix_fd) {
+                struct ucred peer;
+                int client_fd;
+                while ((client_fd = accept_unix_client(http_unix_fd, peer)) >= 0) {
+                    if (!unix_peers.allows(peer)) {
+                        log_warn(LOG_CORE, "unix_peer_rejected").u("uid", peer.uid).i("pid", peer.pid);
+                        close(client_fd);
+                        continue;
+                    }
+                    auto conn = std::make_unique<HttpConnection>();
+                    conn->fd = client_fd;
+                    conn->local_user = unix_user_name(peer.uid);
+                    conn->client_ip = "unix:" + conn->local_user;
+                    conn->client_port = peer.pid;
+                    add_http_connection(http_connections, std::move(conn), connection_limiter, config);
+                }
+                continue;
+            }
+
+            // Accept new binary protocol connections
+            if (pfd.fd == binary_server_fd) {
+                std::string client_ip;
+                int client_port;
+                int client_fd;
+                while ((client_fd = accept_tcp_client(binary_server_fd, client_ip, client_port)) >= 0) {
+                    log_debug(LOG_BINARY, "connected").s("client", client_ip).i("port", client_port);
+                    add_stream_connection(binary_connections, BINARY_MAX_CONNECTIONS, connection_limiter, client_fd,
+                                          client_ip, client_ip + ":" + std::to_string(client_port),
+                                          next_stream_id++);
+                }
+                continue;
+            }
+
+            // Pages sent (or failed) on behalf of binary clients
+            if (pfd.fd == binary_results.fd()) {
+                for (const PageResult& result : binary_results.drain()) {
+                    auto it = binary_connections.find(result.fd);
+                    if (it == binary_connections.end() || it->second->id != result.conn_id) {
+                        continue;  // client already gone
+                    }
+                    BinaryConnection& conn = *it->second;
+                    if (conn.busy) {
+                        conn.early.push_back(result);  // reported once the frame is acked
+                        continue;
+                    }
+                    complete_binary_frame(conn, result);
+                    if (!flush_connection(conn)) {
+                        conn.out.clear();
+                        conn.closing = true;
+                    }
+                }
+                continue;
+            }
+
+            // Binary frames the workers have queued
+            if (pfd.fd == binary_submissions.fd()) {
+                for (BinaryConnection* conn : binary_submissions.drain()) {
+                    complete_binary_batch(*conn, rate_limiter);
+                    for (const PageResult& result : conn->early) {
+                        complete_binary_frame(*conn, result);
+                    }
+                    conn->early.clear();
+                    process_binary_input(*conn, job_queue, rate_limiter, binary_results, workers, binary_submissions,
+                                         config);
+                    if (!flush_connection(*conn)) {
+                        conn->out.clear();
+                        conn->closing = true;
+                    }
+                }
+                continue;
+            }
+
+            // Existing binary protocol connection
+            auto binary_it = binary_connections.find(pfd.fd);
+            if (binary_it != binary_connections.end()) {
+                BinaryConnection& conn = *binary_it->second;
+                if ((pfd.revents & (POLLIN | POLLHUP | POLLERR)) && !conn.busy && !conn.eof) {
+                    if (!read_stream_connection(conn, LOG_BINARY)) {
+                        conn.eof = true;
+                    }
+                    process_binary_input(conn, job_queue, rate_limiter, binary_results, workers, binary_submissions,
+                                         config);
+                }
+                if (!flush_connection(conn)) {
+                    conn.out.clear();
+                    conn.closing = true;
+                }
+                continue;
+            }
+
+            // Existing serial connection
+            auto serial_it = serial_connections.find(pfd.fd);
+            if (serial_it != serial_connections.end()) {
+                SerialConnection& conn = *serial_it->second;
+                if ((pfd.revents & (POLLIN | POLLHUP | POLLERR)) && !conn.busy && !conn.eof) {
+                    if (!read_stream_connection(conn, LOG_SERIAL)) {
+                        // Results for records already queued are still delivered
+                        conn.eof = true;
+                    }
+                    process_serial_input(conn, job_queue, rate_limiter, serial_results, workers, serial_submissions);
+                }
+                if (!flush_connection(conn)) {
+                    conn.out.clear();
+                    conn.closing = true;
+                }
+                continue;
+            }
+
+            // Existing HTTP connection
+            auto it = http_connections.find(pfd.fd);
+            if (it == http_connections.end()) {
+                continue;
+            }
+            HttpConnection& conn = *it->second;
+
+            if ((pfd.revents & (POLLIN | POLLHUP | POLLERR)) && !conn.busy && !conn.eof) {
+                if (!read_http_connection(conn)) {
+                    // Answer whatever arrived before a half-close as well
+                    conn.eof = true;
                 }
+                process_http_input(conn, http_credentials, auth_cache, job_queue, rate_limiter, workers,
+                                   http_completions, server_health, config);
+            }
+
+            if (!flush_connection(conn)) {
+                conn.out.clear();
+                conn.closing = true;
+            }
+        }
+
+        // Close finished connections and those idle for longer than the keep-alive timeout.
+        // Connections with a request at a worker are left alone until it is answered.
+        auto now = std::chrono::steady_clock::now();
+        if (handoff_client_fd >= 0 &&
+            now - handoff_client_since > std::chrono::milliseconds(HANDOFF_REQUEST_TIMEOUT_MS)) {
+            log_warn(LOG_CORE, "handoff_refused").i("pid", handoff_client.pid).u("uid", handoff_client.uid)
+                .s("reason", "no request");
+            close(handoff_client_fd);
+            handoff_client_fd = -1;
+        }
+        for (auto it = http_connections.begin(); it != http_connections.end(); ) {
+            HttpConnection& conn = *it->second;
+            check_http_deadline(conn, now, config);
+            if (!flush_connection(conn)) {
+                conn.out.clear();
+                conn.closing = true;
+            }
+
+            bool done = conn.closing && conn.out.empty();
+            bool idle = now - conn.last_activity > std::chrono::seconds(config.HTTP_KEEPALIVE_TIMEOUT);
+            if (!conn.busy && (done || idle)) {
+                log_debug(LOG_HTTP, "disconnected").s("client", conn.client_ip).i("port", conn.client_port)
+                    .u("requests", conn.requests_served).b("idle_timeout", !done);
+                close(conn.fd);
+                connection_limiter.release(conn.client_ip);
+                it = http_connections.erase(it);
+            } else {
+                ++it;
+            }
+        }
+
+        // Same for serial clients. Connections waiting on a page are not idle,
+        // but a record that has been started must be finished in time.
+        for (auto it = serial_connections.begin(); it != serial_connections.end(); ) {
+            SerialConnection& conn = *it->second;
+            if (!conn.saw_newline && !conn.in.empty() && !conn.closing) {
+                process_serial_input(conn, job_queue, rate_limiter, serial_results, workers, serial_submissions);
+            }
+            bool reading = !conn.busy && (conn.mode == SERIAL_MODE_ASYNC || conn.outstanding == 0);
+            if (reading && !conn.in.empty() && !conn.closing &&
+                now - conn.progress > std::chrono::seconds(SERIAL_RECORD_TIMEOUT)) {
+                serial_reply(conn, "Record timeout");
+                conn.closing = true;
+            }
+            if (!flush_connection(conn)) {
+                conn.out.clear();
+                conn.closing = true;
+            }
+
+            bool done = conn.closing && conn.out.empty();
+            bool idle = conn.outstanding == 0 &&
+                        now - conn.last_activity > std::chrono::seconds(SERIAL_IDLE_TIMEOUT);
+            if (!conn.busy && (done || idle)) {
+                log_debug(LOG_SERIAL, "disconnected").s("peer", conn.peer).u("records", conn.records);
+                close(conn.fd);
+                connection_limiter.release(conn.client_ip);
+                it = serial_connections.erase(it);
+            } else {
+                ++it;
+            }
+        }
 
-                handle_http_client(client_fd, passwords, conn_state, config, debug_mode, verbose_mode);
-                close(client_fd);
+        for (auto it = binary_connections.begin(); it != binary_connections.end(); ) {
+            BinaryConnection& conn = *it->second;
+            if (!conn.in.empty() && !conn.closing && !conn.busy &&
+                now - conn.progress > std::chrono::seconds(BINARY_FRAME_TIMEOUT)) {
+                conn.closing = true;
             }
+
+            bool done = conn.closing && conn.out.empty();
+            bool idle = conn.outstanding == 0 &&
+                        now - conn.last_activity > std::chrono::seconds(BINARY_IDLE_TIMEOUT);
+            if (!conn.busy && (done || idle)) {
+                log_debug(LOG_BINARY, "disconnected").s("peer", conn.peer).u("frames", conn.frames);
+                close(conn.fd);
+                connection_limiter.release(conn.client_ip);
+                it = binary_connections.erase(it);
+            } else {
+                ++it;
+            }
+        }
+
+        // Pick up edits to config.ini and the credential files
+        bool reload_forced = reload_requested != 0;
+        bool poll_due = settings_watch.descriptor() < 0 && now - settings_checked >= std::chrono::seconds(1);
+        if (reload_forced || settings_touched || poll_due) {
+            reload_requested = 0;
+            settings_touched = false;
+            settings_checked = now;
+            reload_settings(reload_state, reload_forced, config_store, http_credentials, auth_cache);
         }
     }
 
     // Cleanup
-    printf("\nShutting down servers...\n");
+    log_info(LOG_CORE, "shutting_down");
+    workers.stop();
+    for (const auto& entry : http_connections) {
+        close(entry.first);
+    }
+    http_connections.clear();
+    for (const auto& entry : serial_connections) {
+        close(entry.first);
+    }
+    serial_connections.clear();
+    for (const auto& entry : binary_connections) {
+        close(entry.first);
+    }
+    binary_connections.clear();
+    // Stop the radio first: otherwise frames the encoders finish now would
+    // still go on the air after the drain deadline
+    radio_queue.stop();
+    encoders.stop();
+    radio_thread.join();
+    if (job_queue.outstanding() > 0) {
+        log_warn(LOG_CORE, "pages_not_sent").u("pages", job_queue.outstanding())
+            .b("requeued_on_restart", page_wal.enabled());
+    }
+    page_wal.close_log();
+    // Lets the process that took over the listeners open the device and log
+    if (handoff_peer_fd >= 0) {
+        close(handoff_peer_fd);
+    }
     if (serial_server_fd >= 0) {
         close(serial_server_fd);
-        printf("Serial TCP server stopped.\n");
     }
     if (http_server_fd >= 0) {
         close(http_server_fd);
-        printf("HTTP server stopped.\n");
+    }
+    if (binary_server_fd >= 0) {
+        close(binary_server_fd);
+    }
+    if (serial_unix_fd >= 0) {
+        close(serial_unix_fd);
+        if (unlink_unix_sockets) {
+            unlink(config.SERIAL_UNIX_SOCKET.c_str());
+        }
+    }
+    if (http_unix_fd >= 0) {
+        close(http_unix_fd);
+        if (unlink_unix_sockets) {
+            unlink(config.HTTP_UNIX_SOCKET.c_str());
+        }
+    }
+    if (handoff_server_fd >= 0) {
+        close(handoff_server_fd);
+        unlink(config.HANDOFF_SOCKET.c_str());
     }
 
-    printf("FLEX HTTP/TCP Server stopped gracefully.\n");
+    tracer().stop();
+    log_info(LOG_CORE, "stopped");
+    logger().stop();
     return 0;
 }
@@ -6,36 +6,37 @@
 #include <thread>
 #include <chrono>
 #include <cstring>
+#include "async_log.hpp"
 
 inline hackrf_device* setup_hackrf(uint64_t frequency, uint32_t sample_rate, int tx_gain) {
     hackrf_device* device = nullptr;
    
     int result = hackrf_init();
     if (result != HACKRF_SUCCESS) {
-        printf("hackrf_init() failed: %s\n", hackrf_error_name((hackrf_error)result));
+        log_error(LOG_RADIO, "hackrf_init_failed").s("error", hackrf_error_name((hackrf_error)result));
         return nullptr;
     }
    
     result = hackrf_open(&device);
     if (result != HACKRF_SUCCESS) {
-        printf("hackrf_open() failed: %s\n", hackrf_error_name((hackrf_error)result));
+        log_error(LOG_RADIO, "hackrf_open_failed").s("error", hackrf_error_name((hackrf_error)result));
         hackrf_exit();
         return nullptr;
     }
    
     result = hackrf_set_sample_rate(device, sample_rate);
     if (result != HACKRF_SUCCESS) {
-        printf("hackrf_set_sample_rate() failed\n");
+        log_warn(LOG_RADIO, "hackrf_set_sample_rate_failed").u("sample_rate", sample_rate);
     }
    
     result = hackrf_set_freq(device, frequency);
     if (result != HACKRF_SUCCESS) {
-        printf("hackrf_set_freq() failed\n");
+        log_warn(LOG_RADIO, "hackrf_set_freq_failed").u("frequency", frequency);
     }
    
     result = hackrf_set_txvga_gain(device, tx_gain); // 0-47 dB
     if (result != HACKRF_SUCCESS) {
-        printf("hackrf_set_txvga_gain() failed\n");
+        log_warn(LOG_RADIO, "hackrf_set_txvga_gain_failed").i("tx_gain", tx_gain);
     }
 
     return device;
@@ -78,7 +79,7 @@ inline bool transmit_hackrf(hackrf_device* device, const std::vector<int8_t>& iq
 
     int result = hackrf_start_tx(device, tx_callback, &tx_state);
     if (result != HACKRF_SUCCESS) {
-        printf("hackrf_start_tx() failed\n");
+        log_error(LOG_RADIO, "hackrf_start_tx_failed").s("error", hackrf_error_name((hackrf_error)result));
         return false;
     }
 
@@ -87,7 +88,7 @@ inline bool transmit_hackrf(hackrf_device* device, const std::vector<int8_t>& iq
     }
 
     hackrf_stop_tx(device);
-    printf("Transmission complete.\n");
+    log_debug(LOG_RADIO, "stream_done").u("bytes", tx_state.sent);
 
     return true;
 }
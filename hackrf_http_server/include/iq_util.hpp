@@ -1,18 +1,21 @@
 #pragma once
+#include <cerrno>
 #include <cstdio>
+#include <cstring>
 #include <cstdint>
 #include <vector>
 #include <string>
+#include "async_log.hpp"
 
 inline bool write_iq_file(const std::string& filename, const std::vector<int8_t>& iq_samples) {
     FILE* iq_file = fopen(filename.c_str(), "wb");
     if (iq_file) {
         fwrite(iq_samples.data(), sizeof(int8_t), iq_samples.size(), iq_file);
         fclose(iq_file);
-        printf("Wrote %zu IQ samples to %s\n", iq_samples.size() / 2, filename.c_str());
+        log_debug(LOG_RADIO, "iq_file_written").s("file", filename).u("samples", iq_samples.size() / 2);
         return true;
     } 
    
-    printf("Failed to open %s for writing!\n", filename.c_str());
+    log_warn(LOG_RADIO, "iq_file_failed").s("file", filename).s("error", strerror(errno));
     return false;
 }
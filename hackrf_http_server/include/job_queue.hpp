@@ -0,0 +1,191 @@
+#pragma once
+#include <string>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <memory>
+#include <sstream>
+#include <cstdint>
+
+// Number of finished jobs kept around for GET /messages/{id}
+#define JOB_HISTORY_LIMIT 4096
+
+typedef enum {
+    JOB_QUEUED,
+    JOB_TRANSMITTING,
+    JOB_SENT,
+    JOB_FAILED
+} job_state_t;
+
+struct Job {
+    uint64_t id;
+    uint64_t capcode;
+    std::string message;
+    uint64_t frequency;
+    job_state_t state;
+
+    // Wall clock for reporting, steady clock for durations
+    std::chrono::system_clock::time_point queued_wall;
+    std::chrono::steady_clock::time_point queued_at;
+    std::chrono::steady_clock::time_point started_at;
+    std::chrono::steady_clock::time_point finished_at;
+};
+
+inline const char* job_state_name(job_state_t state) {
+    switch (state) {
+    case JOB_QUEUED:       return "queued";
+    case JOB_TRANSMITTING: return "transmitting";
+    case JOB_SENT:         return "sent";
+    case JOB_FAILED:       return "failed";
+    }
+    return "unknown";
+}
+
+/**
+ * @brief In-memory FIFO of validated pages waiting for the radio.
+ *
+ * Producers (the network handlers) call submit() and get a job ID back
+ * immediately. The single radio thread pulls jobs with pop() and reports
+ * the outcome with finish(). Finished jobs stay queryable until they fall
+ * out of the JOB_HISTORY_LIMIT window. stop() lets the radio thread work
+ * through the pages already accepted before it exits.
+ */
+class JobQueue {
+public:
+    JobQueue() : next_id(1), stopping(false) {}
+
+    uint64_t submit(uint64_t capcode, const std::string& message, uint64_t frequency) {
+        auto job = std::make_shared<Job>();
+        job->capcode = capcode;
+        job->message = message;
+        job->frequency = frequency;
+        job->state = JOB_QUEUED;
+        job->queued_wall = std::chrono::system_clock::now();
+        job->queued_at = std::chrono::steady_clock::now();
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            job->id = next_id++;
+            pending.push_back(job);
+            jobs[job->id] = job;
+        }
+        ready_cv.notify_one();
+        return job->id;
+    }
+
+    // Blocks until a job is available; after stop(), returns the jobs
+    // still queued and then nullptr
+    std::shared_ptr<Job> pop() {
+        std::unique_lock<std::mutex> lock(mutex);
+        ready_cv.wait(lock, [this] { return stopping || !pending.empty(); });
+        if (pending.empty()) {
+            return nullptr;
+        }
+
+        std::shared_ptr<Job> job = pending.front();
+        pending.pop_front();
+        job->state = JOB_TRANSMITTING;
+        job->started_at = std::chrono::steady_clock::now();
+        return job;
+    }
+
+    void finish(const std::shared_ptr<Job>& job, bool success) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            job->state = success ? JOB_SENT : JOB_FAILED;
+            job->finished_at = std::chrono::steady_clock::now();
+            finished.push_back(job->id);
+            while (finished.size() > JOB_HISTORY_LIMIT) {
+                jobs.erase(finished.front());
+                finished.pop_front();
+            }
+        }
+        done_cv.notify_all();
+    }
+
+    // Copies the current state of a job; returns false for unknown IDs
+    bool lookup(uint64_t id, Job& out) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = jobs.find(id);
+        if (it == jobs.end()) {
+            return false;
+        }
+        out = *it->second;
+        return true;
+    }
+
+    // Blocks until the job has been sent or has failed
+    job_state_t wait(uint64_t id) {
+        std::unique_lock<std::mutex> lock(mutex);
+        auto it = jobs.find(id);
+        if (it == jobs.end()) {
+            return JOB_FAILED;
+        }
+        std::shared_ptr<Job> job = it->second;
+        done_cv.wait(lock, [&] {
+            return stopping || job->state == JOB_SENT || job->state == JOB_FAILED;
+        });
+        return job->state == JOB_SENT ? JOB_SENT : JOB_FAILED;
+    }
+
+    size_t depth() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return pending.size();
+    }
+
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        ready_cv.notify_all();
+        done_cv.notify_all();
+    }
+
+private:
+    std::mutex mutex;
+    std::condition_variable ready_cv;
+    std::condition_variable done_cv;
+    std::deque<std::shared_ptr<Job>> pending;
+    std::deque<uint64_t> finished;
+    std::map<uint64_t, std::shared_ptr<Job>> jobs;
+    uint64_t next_id;
+    bool stopping;
+};
+
+inline long long job_elapsed_ms(std::chrono::steady_clock::time_point from,
+                                std::chrono::steady_clock::time_point to) {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(to - from).count();
+}
+
+/**
+ * @brief Renders a job as the JSON body returned by GET /messages/{id}.
+ */
+inline std::string job_status_json(const Job& job) {
+    auto now = std::chrono::steady_clock::now();
+    long long queued_epoch_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+        job.queued_wall.time_since_epoch()).count();
+
+    std::ostringstream json;
+    json << "{\"id\":" << job.id
+         << ",\"status\":\"" << job_state_name(job.state) << "\""
+         << ",\"capcode\":" << job.capcode
+         << ",\"frequency\":" << job.frequency
+         << ",\"queued_at\":" << queued_epoch_ms;
+
+    if (job.state == JOB_QUEUED) {
+        json << ",\"queue_ms\":" << job_elapsed_ms(job.queued_at, now);
+    } else {
+        json << ",\"queue_ms\":" << job_elapsed_ms(job.queued_at, job.started_at);
+        if (job.state == JOB_TRANSMITTING) {
+            json << ",\"transmit_ms\":" << job_elapsed_ms(job.started_at, now);
+        } else {
+            json << ",\"transmit_ms\":" << job_elapsed_ms(job.started_at, job.finished_at)
+                 << ",\"total_ms\":" << job_elapsed_ms(job.queued_at, job.finished_at);
+        }
+    }
+    json << "}";
+    return json.str();
+}
@@ -3,6 +3,9 @@
 #include <fstream>
 #include <iostream>
 #include <cstdlib>
+#include <atomic>
+#include <memory>
+#include <vector>
 
 struct Config {
     std::string BIND_ADDRESS;
@@ -15,6 +18,26 @@ struct Config {
     uint32_t TTGO_BAUDRATE;
     int TTGO_POWER;
     uint64_t DEFAULT_FREQUENCY;
+
+    // Slow and abusive clients
+    uint32_t HTTP_HEADER_TIMEOUT;
+    uint32_t HTTP_BODY_TIMEOUT;
+    uint32_t HTTP_MAX_HEADER_SIZE;
+    uint32_t HTTP_MAX_BODY_SIZE;
+    uint32_t MAX_CONNECTIONS_PER_IP;
+
+    // HTTP credential cache
+    uint32_t HTTP_AUTH_CACHE_TTL;
+    uint32_t HTTP_AUTH_CACHE_SIZE;
+
+    // Listener tuning
+    uint32_t LISTEN_BACKLOG;
+    uint32_t LISTEN_REUSEPORT;
+    uint32_t LISTEN_DEFER_ACCEPT;
+    uint32_t LISTEN_FASTOPEN;
+
+    // Logging
+    std::string LOG_LEVELS;
 };
 
 // Helper function to trim whitespace and trailing commas
@@ -46,6 +69,26 @@ inline bool load_config(const std::string& filename, Config& config) {
     config.TTGO_POWER = 2;
     config.DEFAULT_FREQUENCY = 916000000; // 916.0 MHz
 
+    // Slow and abusive clients
+    config.HTTP_HEADER_TIMEOUT = 10;
+    config.HTTP_BODY_TIMEOUT = 30;
+    config.HTTP_MAX_HEADER_SIZE = 8192;
+    config.HTTP_MAX_BODY_SIZE = 65536;
+    config.MAX_CONNECTIONS_PER_IP = 4;
+
+    // HTTP credential cache
+    config.HTTP_AUTH_CACHE_TTL = 300;
+    config.HTTP_AUTH_CACHE_SIZE = 1024;
+
+    // Listener tuning
+    config.LISTEN_BACKLOG = 128;
+    config.LISTEN_REUSEPORT = 0;
+    config.LISTEN_DEFER_ACCEPT = 0;
+    config.LISTEN_FASTOPEN = 0;
+
+    // Logging
+    config.LOG_LEVELS = "info";
+
     std::string line;
     while (std::getline(file, line)) {
         // Skip comments and empty lines
@@ -77,8 +120,128 @@ inline bool load_config(const std::string& filename, Config& config) {
             config.TTGO_POWER = std::stoi(value);
         } else if (key == "DEFAULT_FREQUENCY") {
             config.DEFAULT_FREQUENCY = std::stoull(value);
+        } else if (key == "HTTP_HEADER_TIMEOUT") {
+            config.HTTP_HEADER_TIMEOUT = std::stoul(value);
+        } else if (key == "HTTP_BODY_TIMEOUT") {
+            config.HTTP_BODY_TIMEOUT = std::stoul(value);
+        } else if (key == "HTTP_MAX_HEADER_SIZE") {
+            config.HTTP_MAX_HEADER_SIZE = std::stoul(value);
+        } else if (key == "HTTP_MAX_BODY_SIZE") {
+            config.HTTP_MAX_BODY_SIZE = std::stoul(value);
+        } else if (key == "MAX_CONNECTIONS_PER_IP") {
+            config.MAX_CONNECTIONS_PER_IP = std::stoul(value);
+        } else if (key == "HTTP_AUTH_CACHE_TTL") {
+            config.HTTP_AUTH_CACHE_TTL = std::stoul(value);
+        } else if (key == "HTTP_AUTH_CACHE_SIZE") {
+            config.HTTP_AUTH_CACHE_SIZE = std::stoul(value);
+        } else if (key == "LISTEN_BACKLOG") {
+            config.LISTEN_BACKLOG = std::stoul(value);
+        } else if (key == "LISTEN_REUSEPORT") {
+            config.LISTEN_REUSEPORT = std::stoul(value);
+        } else if (key == "LISTEN_DEFER_ACCEPT") {
+            config.LISTEN_DEFER_ACCEPT = std::stoul(value);
+        } else if (key == "LISTEN_FASTOPEN") {
+            config.LISTEN_FASTOPEN = std::stoul(value);
+        } else if (key == "LOG_LEVELS") {
+            config.LOG_LEVELS = value;
         }
     }
 
     return true;
 }
+
+// Checks settings that load_config accepts syntactically but the server
+// cannot run with; error says which
+inline bool validate_config(const Config& config, std::string& error) {
+    if (config.TTGO_POWER < 2 || config.TTGO_POWER > 17) {
+        error = "Invalid TTGO_POWER: " + std::to_string(config.TTGO_POWER) + " (must be 2-17)";
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Copies the settings that take effect without a restart from loaded
+ * into config and returns the names of those that changed.
+ *
+ * These are read each time they are used (per page or per request).
+ * Everything else opens or sizes something at startup
+ * (listeners, the password file, the credential cache, the per-address cap)
+ * and keeps its startup value until the next restart.
+ */
+inline std::vector<std::string> config_apply_reloadable(Config& config, const Config& loaded) {
+    std::vector<std::string> changed;
+#define CONFIG_RELOAD(key) \
+    if (config.key != loaded.key) { \
+        config.key = loaded.key; \
+        changed.push_back(#key); \
+    }
+    CONFIG_RELOAD(TTGO_DEVICE)
+    CONFIG_RELOAD(TTGO_BAUDRATE)
+    CONFIG_RELOAD(TTGO_POWER)
+    CONFIG_RELOAD(DEFAULT_FREQUENCY)
+    CONFIG_RELOAD(HTTP_HEADER_TIMEOUT)
+    CONFIG_RELOAD(HTTP_BODY_TIMEOUT)
+    CONFIG_RELOAD(HTTP_MAX_HEADER_SIZE)
+    CONFIG_RELOAD(HTTP_MAX_BODY_SIZE)
+    CONFIG_RELOAD(LOG_LEVELS)
+#undef CONFIG_RELOAD
+    return changed;
+}
+
+// Names of the settings in loaded that differ from config but only take
+// effect after a restart
+inline std::vector<std::string> config_restart_changes(const Config& config, const Config& loaded) {
+    std::vector<std::string> changed;
+#define CONFIG_RESTART(key) \
+    if (config.key != loaded.key) { \
+        changed.push_back(#key); \
+    }
+    CONFIG_RESTART(BIND_ADDRESS)
+    CONFIG_RESTART(SERIAL_LISTEN_PORT)
+    CONFIG_RESTART(HTTP_LISTEN_PORT)
+    CONFIG_RESTART(HTTP_AUTH_CREDENTIALS)
+    CONFIG_RESTART(HTTP_AUTH_CACHE_TTL)
+    CONFIG_RESTART(HTTP_AUTH_CACHE_SIZE)
+    CONFIG_RESTART(MAX_CONNECTIONS_PER_IP)
+    CONFIG_RESTART(LISTEN_BACKLOG)
+    CONFIG_RESTART(LISTEN_REUSEPORT)
+    CONFIG_RESTART(LISTEN_DEFER_ACCEPT)
+    CONFIG_RESTART(LISTEN_FASTOPEN)
+#undef CONFIG_RESTART
+    return changed;
+}
+
+/**
+ * @brief The current settings, replaced as a whole when config.ini is
+ * reloaded.
+ *
+ * The main loop takes the snapshot once per pass and hands it to the
+ * client it serves; the radio thread takes it once per page. Readers never
+ * lock, and a reload never changes settings halfway through a request or a
+ * page. Replaced snapshots are kept until exit, so a reader may keep using
+ * the one it loaded; a reload costs one Config. Only the main loop
+ * publishes.
+ */
+class ConfigStore {
+public:
+    explicit ConfigStore(const Config& initial) : live(nullptr) {
+        publish(initial);
+    }
+
+    const Config& current() const {
+        return *live.load(std::memory_order_acquire);
+    }
+
+    void publish(const Config& next) {
+        snapshots.push_back(std::unique_ptr<const Config>(new Config(next)));
+        live.store(snapshots.back().get(), std::memory_order_release);
+    }
+
+    ConfigStore(const ConfigStore&) = delete;
+    ConfigStore& operator=(const ConfigStore&) = delete;
+
+private:
+    std::atomic<const Config*> live;
+    std::vector<std::unique_ptr<const Config>> snapshots;
+};
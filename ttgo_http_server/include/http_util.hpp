@@ -9,7 +9,7 @@
 #include <unistd.h>
 #include <algorithm>
 #include <crypt.h>
-#include <iomanip>
+#include "async_log.hpp"
 
 struct HttpRequest {
     std::string method;
@@ -56,67 +56,31 @@ inline std::string trim(const std::string& str) {
     return str.substr(start, end - start + 1);
 }
 
-inline void log_http_request(const std::string& request, const std::string& client_ip, int client_port, bool verbose_mode) {
-    if (!verbose_mode) return;
-
-    std::cout << "\n=== HTTP Client Connected ===\n";
-    std::cout << "Client IP: " << client_ip << "\n";
-    std::cout << "Client Port: " << client_port << "\n";
-    std::cout << "Raw HTTP Request (" << request.length() << " bytes):\n";
-    std::cout << "---\n" << request << "---\n";
+inline void log_http_request(const std::string& request, const std::string& client_ip, int client_port) {
+    log_debug(LOG_HTTP, "request_read").s("client", client_ip).i("port", client_port).u("bytes", request.length());
 }
 
-inline void log_parsed_request(const HttpRequest& req, bool verbose_mode) {
-    if (!verbose_mode) return;
-
-    std::cout << "Parsed HTTP Request:\n";
-    std::cout << "  Method: " << req.method << "\n";
-    std::cout << "  Path: " << req.path << "\n";
-    std::cout << "  Version: " << req.version << "\n";
+inline void log_parsed_request(const HttpRequest& req) {
+    log_debug(LOG_HTTP, "request_parsed").s("method", req.method).s("path", req.path)
+        .s("version", req.version).u("headers", req.headers.size()).u("body_bytes", req.body.length());
+    if (!log_enabled(LOG_HTTP, LOG_LEVEL_TRACE)) return;
 
-    // Log ALL headers in verbose mode
-    std::cout << "  Headers:\n";
     for (const auto& header : req.headers) {
-        std::cout << "    " << header.first << ": " << header.second << "\n";
+        // Credentials stay out of the logs even at trace level (names are lowercased)
+        bool secret = header.first == "authorization";
+        log_trace(LOG_HTTP, "request_header").s("name", header.first)
+            .s("value", secret ? std::string("[redacted]") : header.second);
     }
-
     if (!req.body.empty()) {
-        std::cout << "  Body Length: " << req.body.length() << " bytes\n";
-        std::cout << "  Body Content: " << req.body << "\n";
-
-        // Additional body analysis
-        std::cout << "  Body Analysis:\n";
-        std::cout << "    First char: '" << (req.body.empty() ? "EMPTY" : std::string(1, req.body[0])) << "' (ASCII: "
-                  << (req.body.empty() ? 0 : static_cast<int>(req.body[0])) << ")\n";
-        std::cout << "    Last char: '" << (req.body.empty() ? "EMPTY" : std::string(1, req.body.back())) << "' (ASCII: "
-                  << (req.body.empty() ? 0 : static_cast<int>(req.body.back())) << ")\n";
-        std::cout << "    Contains '{': " << (req.body.find('{') != std::string::npos ? "YES" : "NO") << "\n";
-        std::cout << "    Contains '}': " << (req.body.find('}') != std::string::npos ? "YES" : "NO") << "\n";
-        std::cout << "    Contains 'message': " << (req.body.find("message") != std::string::npos ? "YES" : "NO") << "\n";
-    } else {
-        std::cout << "  Body: EMPTY\n";
+        log_trace(LOG_HTTP, "request_body").s("body", req.body);
     }
-    std::cout << std::endl;
 }
 
-inline void log_json_processing(const JsonMessage& msg, uint64_t default_freq, bool verbose_mode) {
-    if (!verbose_mode) return;
-
-    std::cout << "=== JSON Message Processing ===\n";
-    std::cout << "Message Data Received:\n";
-    std::cout << "  Message: '" << msg.message << "'\n";
-    std::cout << "  Capcode: " << msg.capcode;
-    if (msg.capcode == 37137) std::cout << " (default)";
-    std::cout << "\n";
-
+inline void log_json_processing(const JsonMessage& msg, uint64_t default_freq) {
     uint64_t freq = msg.frequency > 0 ? msg.frequency : default_freq;
-    std::cout << "  Frequency: " << freq << " Hz (" << std::fixed << std::setprecision(3)
-              << (freq / 1000000.0) << " MHz)";
-    if (msg.frequency == 0 || msg.frequency == default_freq) std::cout << " (default)";
-    std::cout << "\n";
-
-    std::cout << "  Final Message: '" << msg.message << "'\n";
-    std::cout << "  JSON Valid: " << (msg.valid ? "YES" : "NO") << "\n\n";
+    log_debug(LOG_HTTP, "json_message").u("capcode", msg.capcode).u("frequency", freq)
+        .b("default_frequency", msg.frequency == 0 || msg.frequency == default_freq)
+        .s("message", msg.message).b("valid", msg.valid);
 }
 
 inline HttpRequest parse_http_request(const std::string& request) {
@@ -162,31 +126,23 @@ inline JsonMessage parse_json_message(const std::string& json) {
     msg.capcode = 37137; // Default capcode
     msg.message = ""; // Initialize message
 
-    std::cout << "=== JSON Parsing Debug ===\n";
-    std::cout << "Input JSON Length: " << json.length() << " bytes\n";
-    std::cout << "Input JSON Content: '" << json << "'\n";
-
     // Check if JSON is empty or whitespace only
     std::string trimmed_json = trim(json);
     if (trimmed_json.empty()) {
-        std::cout << "JSON Parsing Error: Empty JSON after trimming\n";
+        log_trace(LOG_HTTP, "json_parse_error").s("reason", "empty body");
         return msg;
     }
 
-    std::cout << "Trimmed JSON: '" << trimmed_json << "'\n";
-
     // Simple JSON parsing (for production use a proper JSON library)
     size_t capcode_pos = json.find("\"capcode\"");
     size_t message_pos = json.find("\"message\"");
     size_t freq_pos = json.find("\"frequency\"");
 
-    std::cout << "JSON Field Positions:\n";
-    std::cout << "  capcode position: " << (capcode_pos != std::string::npos ? std::to_string(capcode_pos) : "NOT_FOUND") << "\n";
-    std::cout << "  message position: " << (message_pos != std::string::npos ? std::to_string(message_pos) : "NOT_FOUND") << "\n";
-    std::cout << "  frequency position: " << (freq_pos != std::string::npos ? std::to_string(freq_pos) : "NOT_FOUND") << "\n";
+    log_trace(LOG_HTTP, "json_fields").b("capcode", capcode_pos != std::string::npos)
+        .b("message", message_pos != std::string::npos).b("frequency", freq_pos != std::string::npos);
 
     if (message_pos == std::string::npos) {
-        std::cout << "JSON Parsing Error: 'message' field not found\n";
+        log_trace(LOG_HTTP, "json_parse_error").s("reason", "'message' field not found");
         return msg;
     }
 
@@ -198,12 +154,11 @@ inline JsonMessage parse_json_message(const std::string& json) {
             size_t capcode_end = json.find_first_of(",}", capcode_start);
             if (capcode_start != std::string::npos && capcode_end != std::string::npos) {
                 std::string capcode_str = json.substr(capcode_start, capcode_end - capcode_start);
-                std::cout << "Capcode extraction: '" << capcode_str << "'\n";
                 try {
                     msg.capcode = std::stoull(capcode_str);
-                    std::cout << "Capcode parsed successfully: " << msg.capcode << "\n";
                 } catch (const std::exception& e) {
-                    std::cout << "Capcode parsing error: " << e.what() << ", using default\n";
+                    log_trace(LOG_HTTP, "json_parse_error").s("reason", "capcode not a number, using default")
+                        .s("value", capcode_str);
                 }
             }
         }
@@ -217,15 +172,14 @@ inline JsonMessage parse_json_message(const std::string& json) {
             size_t msg_quote_end = json.find('"', msg_quote_start + 1);
             if (msg_quote_end != std::string::npos) {
                 msg.message = json.substr(msg_quote_start + 1, msg_quote_end - msg_quote_start - 1);
-                std::cout << "Message extraction: '" << msg.message << "'\n";
             } else {
-                std::cout << "Message parsing error: closing quote not found\n";
+                log_trace(LOG_HTTP, "json_parse_error").s("reason", "message closing quote not found");
             }
         } else {
-            std::cout << "Message parsing error: opening quote not found\n";
+            log_trace(LOG_HTTP, "json_parse_error").s("reason", "message opening quote not found");
         }
     } else {
-        std::cout << "Message parsing error: colon after 'message' not found\n";
+        log_trace(LOG_HTTP, "json_parse_error").s("reason", "colon after 'message' not found");
     }
 
     // Extract frequency (optional)
@@ -236,12 +190,11 @@ inline JsonMessage parse_json_message(const std::string& json) {
             size_t freq_end = json.find_first_of(",}", freq_start);
             if (freq_start != std::string::npos && freq_end != std::string::npos) {
                 std::string freq_str = json.substr(freq_start, freq_end - freq_start);
-                std::cout << "Frequency extraction: '" << freq_str << "'\n";
                 try {
                     msg.frequency = std::stoull(freq_str);
-                    std::cout << "Frequency parsed successfully: " << msg.frequency << "\n";
                 } catch (const std::exception& e) {
-                    std::cout << "Frequency parsing error: " << e.what() << ", using default\n";
+                    log_trace(LOG_HTTP, "json_parse_error").s("reason", "frequency not a number, using default")
+                        .s("value", freq_str);
                     msg.frequency = 0; // Will use default
                 }
             }
@@ -249,9 +202,7 @@ inline JsonMessage parse_json_message(const std::string& json) {
     }
 
     msg.valid = !msg.message.empty();
-    std::cout << "JSON Parsing Result: " << (msg.valid ? "VALID" : "INVALID") << "\n";
-    std::cout << "Final Message: '" << msg.message << "'\n";
-    std::cout << "=== End JSON Parsing Debug ===\n\n";
+    log_trace(LOG_HTTP, "json_parsed").b("valid", msg.valid).u("capcode", msg.capcode).u("frequency", msg.frequency);
 
     return msg;
 }
@@ -316,8 +267,8 @@ inline bool verify_password(const std::string& password, const std::string& hash
     }
     else if (hash.substr(0, 6) == "$apr1$") {
         // Apache MD5 - not supported on this system
-        std::cerr << "WARNING: Apache MD5 hashes ($apr1$) are not supported on this system." << std::endl;
-        std::cerr << "Please recreate the passwords file using: htpasswd -B passwords username" << std::endl;
+        log_warn(LOG_HTTP, "unsupported_password_hash").s("format", "$apr1$")
+            .s("hint", "recreate the passwords file using: htpasswd -B passwords username");
         return false;
     }
     else {
@@ -326,7 +277,9 @@ inline bool verify_password(const std::string& password, const std::string& hash
     }
 }
 
-inline bool authenticate_user(const std::string& auth_header, const std::map<std::string, std::string>& passwords) {
+// On success the user name is stored in *user when given
+inline bool authenticate_user(const std::string& auth_header, const std::map<std::string, std::string>& passwords,
+                              std::string* user = nullptr) {
     if (auth_header.substr(0, 6) != "Basic ") {
         return false;
     }
@@ -347,12 +300,30 @@ inline bool authenticate_user(const std::string& auth_header, const std::map<std
         return false;
     }
 
-    return verify_password(password, it->second);
+    if (!verify_password(password, it->second)) {
+        return false;
+    }
+    if (user) {
+        *user = username;
+    }
+    return true;
+}
+
+// User name from a Basic Authorization header, without checking the password
+inline std::string basic_auth_user(const std::string& auth_header) {
+    if (auth_header.substr(0, 6) != "Basic ") {
+        return "";
+    }
+    std::string decoded = base64_decode(auth_header.substr(6));
+    return decoded.substr(0, decoded.find(':'));
+}
+
+inline void log_http_response(int status_code, const std::string& body) {
+    log_debug(LOG_HTTP, "response").i("status", status_code).s("body", body);
 }
 
 inline void send_http_response(int client_fd, int status_code, const std::string& status_text,
-                              const std::string& body, const std::string& content_type = "application/json",
-                              bool verbose_mode = false) {
+                              const std::string& body, const std::string& content_type = "application/json") {
     std::ostringstream response;
     response << "HTTP/1.1 " << status_code << " " << status_text << "\r\n";
     response << "Content-Type: " << content_type << "\r\n";
@@ -363,15 +334,10 @@ inline void send_http_response(int client_fd, int status_code, const std::string
 
     std::string response_str = response.str();
     send(client_fd, response_str.c_str(), response_str.length(), 0);
-
-    if (verbose_mode) {
-        std::cout << "HTTP Response sent:\n";
-        std::cout << "  Status: " << status_code << "\n";
-        std::cout << "  Body: " << body << "\n\n";
-    }
+    log_http_response(status_code, body);
 }
 
-inline void send_unauthorized_response(int client_fd, bool verbose_mode = false) {
+inline void send_unauthorized_response(int client_fd) {
     std::ostringstream response;
     response << "HTTP/1.1 401 Unauthorized\r\n";
     response << "WWW-Authenticate: Basic realm=\"HackRF HTTP Server\"\r\n";
@@ -383,10 +349,5 @@ inline void send_unauthorized_response(int client_fd, bool verbose_mode = false)
 
     std::string response_str = response.str();
     send(client_fd, response_str.c_str(), response_str.length(), 0);
-
-    if (verbose_mode) {
-        std::cout << "HTTP Response sent:\n";
-        std::cout << "  Status: 401 Unauthorized\n";
-        std::cout << "  Body: {\"error\":\"Authentication required\",\"code\":401}\n\n";
-    }
+    log_http_response(401, "{\"error\":\"Authentication required\",\"code\":401}");
 }
@@ -0,0 +1,108 @@
+#pragma once
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+// First descriptor passed by systemd socket activation (SD_LISTEN_FDS_START)
+#define LISTEN_FDS_START 3
+
+// Most listening sockets taken from systemd
+#define LISTEN_FDS_MAX 16
+
+/**
+ * @brief Listening sockets passed by systemd socket activation.
+ *
+ * Each is claimed by port, not by position or name, so the socket unit and
+ * the configuration only have to agree on ports. Sockets nobody claims are
+ * closed by close_rest().
+ */
+class InheritedListeners {
+public:
+    InheritedListeners() {}
+
+    ~InheritedListeners() {
+        close_rest();
+    }
+
+    InheritedListeners(const InheritedListeners&) = delete;
+    InheritedListeners& operator=(const InheritedListeners&) = delete;
+
+    /**
+     * @brief Takes the sockets systemd passed (sd_listen_fds(3) protocol,
+     * implemented here to avoid a libsystemd dependency). The variables are
+     * cleared so child processes do not see them.
+     */
+    size_t load_systemd() {
+        const char* pid = getenv("LISTEN_PID");
+        const char* count = getenv("LISTEN_FDS");
+        if (pid && count && strtol(pid, nullptr, 10) == static_cast<long>(getpid())) {
+            long n = strtol(count, nullptr, 10);
+            for (long i = 0; i < n && i < LISTEN_FDS_MAX; ++i) {
+                add(LISTEN_FDS_START + static_cast<int>(i));
+            }
+        }
+        unsetenv("LISTEN_PID");
+        unsetenv("LISTEN_FDS");
+        unsetenv("LISTEN_FDNAMES");
+        return fds.size();
+    }
+
+    // Adopts a listening socket: made non-blocking, like the ones
+    // setup_tcp_server() creates, and close-on-exec
+    void add(int fd) {
+        int flags = fcntl(fd, F_GETFL);
+        if (flags < 0) {
+            return;
+        }
+        fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+        fds.push_back(fd);
+    }
+
+    size_t size() const {
+        return fds.size();
+    }
+
+    // The TCP listener on port, or -1
+    int take_tcp(int port) {
+        for (size_t i = 0; i < fds.size(); ++i) {
+            struct sockaddr_storage address;
+            memset(&address, 0, sizeof(address));
+            socklen_t length = sizeof(address);
+            int listening = 0;
+            socklen_t option_length = sizeof(listening);
+            if (getsockname(fds[i], (struct sockaddr*)&address, &length) == 0 &&
+                getsockopt(fds[i], SOL_SOCKET, SO_ACCEPTCONN, &listening, &option_length) == 0 &&
+                listening && socket_port(address) == port) {
+                int fd = fds[i];
+                fds.erase(fds.begin() + i);
+                return fd;
+            }
+        }
+        return -1;
+    }
+
+    void close_rest() {
+        for (size_t i = 0; i < fds.size(); ++i) {
+            close(fds[i]);
+        }
+        fds.clear();
+    }
+
+private:
+    static int socket_port(const struct sockaddr_storage& address) {
+        if (address.ss_family == AF_INET) {
+            return ntohs(((const struct sockaddr_in*)&address)->sin_port);
+        }
+        if (address.ss_family == AF_INET6) {
+            return ntohs(((const struct sockaddr_in6*)&address)->sin6_port);
+        }
+        return -1;
+    }
+
+    std::vector<int> fds;
+};
@@ -4,10 +4,9 @@
 #include <termios.h>
 #include <unistd.h>
 #include <cstring>
-#include <iostream>
 #include <poll.h>
 #include <errno.h>
-#include <iomanip>
+#include "async_log.hpp"
 
 struct TtgoConfig {
     double frequency;  // Frequency in MHz
@@ -28,7 +27,7 @@ inline int configure_ttgo_serial(int fd, int baudrate) {
     speed_t speed;
 
     if (tcgetattr(fd, &orig_tty) != 0) {
-        perror("tcgetattr");
+        log_error(LOG_TTGO, "tcgetattr_failed").s("error", strerror(errno));
         return -1;
     }
     tty_saved = true;
@@ -44,7 +43,7 @@ inline int configure_ttgo_serial(int fd, int baudrate) {
     case 115200: speed = B115200; break;
     case 230400: speed = B230400; break;
     default:
-        fprintf(stderr, "Unsupported baudrate: %d\n", baudrate);
+        log_error(LOG_TTGO, "unsupported_baudrate").i("baudrate", baudrate);
         return -1;
     }
 
@@ -65,7 +64,7 @@ inline int configure_ttgo_serial(int fd, int baudrate) {
     tty.c_iflag &= ~(IXON | IXOFF | IXANY);  // No software flow control
 
     if (tcsetattr(fd, TCSANOW, &tty) != 0) {
-        perror("tcsetattr");
+        log_error(LOG_TTGO, "tcsetattr_failed").s("error", strerror(errno));
         return -1;
     }
 
@@ -100,7 +99,7 @@ inline int discard_ttgo_serial(int fd) {
  * @brief Reads a full line from a given fd.
  * Based on read_serial_line from send_ttgo.c - EXACT COPY
  */
-inline ssize_t read_ttgo_line(int fd, char *line, size_t line_size, bool verbose_mode = false) {
+inline ssize_t read_ttgo_line(int fd, char *line, size_t line_size) {
     ssize_t bytes_read;
     size_t total_read;
 
@@ -108,20 +107,14 @@ inline ssize_t read_ttgo_line(int fd, char *line, size_t line_size, bool verbose
     total_read = 0;
     line[line_size - 1] = '\0';
 
-    if (verbose_mode) {
-        std::cout << "  Reading TTGO response...\n";
-    }
-
     while (total_read < line_size - 1) {
         bytes_read = read(fd, line + total_read, 1);
         if (bytes_read < 0) {
-            perror("read");
+            log_warn(LOG_TTGO, "read_failed").s("error", strerror(errno));
             return -1;
         }
         if (bytes_read == 0) {
-            if (verbose_mode) {
-                std::cerr << "  Timeout reading TTGO response\n";
-            }
+            log_debug(LOG_TTGO, "read_timeout");
             return -1;
         }
         if (line[total_read] == '\n') {
@@ -147,7 +140,7 @@ inline ssize_t send_ttgo_data(int fd, const char *msg, size_t size) {
     while (total_written < size) {
         bytes_written = write(fd, msg + total_written, size - total_written);
         if (bytes_written < 0) {
-            perror("write");
+            log_warn(LOG_TTGO, "write_failed").s("error", strerror(errno));
             return -1;
         }
         total_written += bytes_written;
@@ -159,15 +152,13 @@ inline ssize_t send_ttgo_data(int fd, const char *msg, size_t size) {
 
 /**
  * @brief Sends a command and checks for response via serial.
- * Based on send_command_and_check from send_ttgo.c - EXACT COPY with verbose option
+ * Based on send_command_and_check from send_ttgo.c - EXACT COPY with logging
  */
 inline int send_ttgo_command_and_check(int fd, const char *command, int size,
-    const char *error_msg, bool verbose_mode = false) {
+    const char *error_msg) {
     char response[256];
 
-    if (verbose_mode) {
-        std::cout << "  Sending TTGO command: (" << std::string(command, size - 1) << ")\n";
-    }
+    log_trace(LOG_TTGO, "ttgo_send").s("command", std::string(command, size - 1));
 
     // Send command
     if (send_ttgo_data(fd, command, size) < 0)
@@ -175,18 +166,14 @@ inline int send_ttgo_command_and_check(int fd, const char *command, int size,
 
     // Read response until newline, timeout or a matching line
     // NOTE: This is the EXACT logic from send_ttgo.c
-    while (read_ttgo_line(fd, response, sizeof response, verbose_mode) >= 0) {
+    while (read_ttgo_line(fd, response, sizeof response) >= 0) {
         if (strncmp(response, "CONSOLE:", 8) == 0) {
             // Check if error or not
             if (response[8] != '0') {
-                if (verbose_mode) {
-                    std::cerr << "  TTGO Error: (" << error_msg << "), Got: " << response << "\n";
-                }
+                log_warn(LOG_TTGO, "ttgo_error").s("error", error_msg).s("line", response);
                 return -1;
             }
-            if (verbose_mode) {
-                std::cout << "  TTGO Response: " << response << "\n";
-            }
+            log_trace(LOG_TTGO, "ttgo_received").s("line", response);
             break;
         }
     }
@@ -196,14 +183,12 @@ inline int send_ttgo_command_and_check(int fd, const char *command, int size,
 
 /**
  * @brief Sends binary data via serial and waits for response.
- * Based on send_binary_data from send_ttgo.c - EXACT COPY with verbose option
+ * Based on send_binary_data from send_ttgo.c - EXACT COPY with logging
  */
-inline int send_ttgo_binary_data(int fd, const uint8_t *data, size_t size, bool verbose_mode = false) {
+inline int send_ttgo_binary_data(int fd, const uint8_t *data, size_t size) {
     char response[256];
 
-    if (verbose_mode) {
-        std::cout << "  Sending binary data (" << size << " bytes)...\n";
-    }
+    log_trace(LOG_TTGO, "ttgo_send_data").u("bytes", size);
 
     // Send all binary data
     if (send_ttgo_data(fd, (const char*)data, size) < 0)
@@ -211,18 +196,14 @@ inline int send_ttgo_binary_data(int fd, const uint8_t *data, size_t size, bool
 
     // Read response until newline, timeout or a matching line
     // NOTE: This is the EXACT logic from send_ttgo.c
-    while (read_ttgo_line(fd, response, sizeof response, verbose_mode) >= 0) {
+    while (read_ttgo_line(fd, response, sizeof response) >= 0) {
         if (strncmp(response, "TX:", 3) == 0) {
             // Check if error or not
             if (response[3] != '0') {
-                if (verbose_mode) {
-                    std::cerr << "  TTGO TX Error: " << response << "\n";
-                }
+                log_warn(LOG_TTGO, "ttgo_tx_error").s("line", response);
                 return -1;
             }
-            if (verbose_mode) {
-                std::cout << "  TTGO TX Response: " << response << "\n";
-            }
+            log_trace(LOG_TTGO, "ttgo_received").s("line", response);
             break;
         }
     }
@@ -259,45 +240,34 @@ inline void close_ttgo_serial(int fd) {
 
 /**
  * @brief Sends a flex message via TTGO serial.
- * Based on send_flex_via_serial from send_ttgo.c - EXACT COPY with verbose option
+ * Based on send_flex_via_serial from send_ttgo.c - EXACT COPY with logging
  */
 inline int send_flex_via_ttgo(int fd, const TtgoConfig& config,
-    const uint8_t *data, size_t size, bool verbose_mode = false) {
+    const uint8_t *data, size_t size) {
     char cmd_buffer[64];
     int s;
 
-    if (verbose_mode) {
-        std::cout << "TTGO Transmission Details:\n";
-        std::cout << "  Frequency: " << std::fixed << std::setprecision(4) << config.frequency << " MHz\n";
-        std::cout << "  Power: " << config.power << "\n";
-        std::cout << "  Data size: " << size << " bytes\n";
-    }
-
     // Ignore all previous messages sent
     (void)discard_ttgo_serial(fd);
 
     // Set frequency - use EXACT same format as send_ttgo.c
     s = snprintf(cmd_buffer, sizeof(cmd_buffer), "f %.4f\n", config.frequency);
-    if (send_ttgo_command_and_check(fd, cmd_buffer, s, "Failed to set frequency", verbose_mode) < 0)
+    if (send_ttgo_command_and_check(fd, cmd_buffer, s, "Failed to set frequency") < 0)
         return -1;
 
     // Set TX power
     s = snprintf(cmd_buffer, sizeof(cmd_buffer), "p %d\n", config.power);
-    if (send_ttgo_command_and_check(fd, cmd_buffer, s, "Failed to set TX power", verbose_mode) < 0)
+    if (send_ttgo_command_and_check(fd, cmd_buffer, s, "Failed to set TX power") < 0)
         return -1;
 
     // Send message length
     s = snprintf(cmd_buffer, sizeof(cmd_buffer), "m %zu\n", size);
-    if (send_ttgo_command_and_check(fd, cmd_buffer, s, "Failed to set message length", verbose_mode) < 0)
+    if (send_ttgo_command_and_check(fd, cmd_buffer, s, "Failed to set message length") < 0)
         return -1;
 
     // Send binary data
-    if (send_ttgo_binary_data(fd, data, size, verbose_mode) < 0)
+    if (send_ttgo_binary_data(fd, data, size) < 0)
         return -1;
 
-    if (verbose_mode) {
-        std::cout << "  TTGO transmission completed successfully\n";
-    }
-
     return 0;
 }
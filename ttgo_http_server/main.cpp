@@ -6,18 +6,31 @@
 #include <chrono>
 #include <thread>
 #include <sys/select.h>
+#include <deque>
+#include <vector>
+#include <signal.h>
 #include <errno.h>
-#include <iomanip>
 #include <arpa/inet.h>
 #include <fcntl.h>
 #include <termios.h>
 #include <poll.h>
 #include "../tinyflex/tinyflex.h"
 #include "include/config.hpp"
+#include "include/async_log.hpp"
 #include "include/tcp_util.hpp"
+#include "include/auth_cache.hpp"
+#include "include/file_watch.hpp"
+#include "include/job_queue.hpp"
+#include "include/listen_fds.hpp"
 #include "include/http_util.hpp"
 #include "include/ttgo_util.hpp"
 
+// Seconds a serial client has to send its line
+#define SERIAL_READ_TIMEOUT 10
+
+// Accepted clients waiting for their turn; beyond this, new ones are refused
+#define MAX_PENDING_CLIENTS 64
+
 void print_help() {
     std::cout << "ttgo_http_server - FLEX paging HTTP/TCP server for TTGO-FSK-TX\n";
     std::cout << "A dual-protocol server with comprehensive logging and AWS Lambda compatible response codes\n\n";
@@ -28,7 +41,7 @@ void print_help() {
     std::cout << "OPTIONS:\n";
     std::cout << "  --help, -h     Show this help message and exit\n";
     std::cout << "  --debug, -d    Enable debug mode (show commands, skip transmission)\n";
-    std::cout << "  --verbose, -v  Enable comprehensive pipeline logging (detailed processing info)\n\n";
+    std::cout << "  --verbose, -v  Log everything (sets every component to trace, overriding LOG_LEVELS)\n\n";
 
     std::cout << "EXIT CODES (AWS Lambda Compatible):\n";
     std::cout << "  0  Success\n";
@@ -43,14 +56,26 @@ void print_help() {
     std::cout << "  Both protocols can be independently enabled/disabled (set port to 0).\n\n";
 
     std::cout << "  Configuration parameters:\n";
-    std::cout << "    BIND_ADDRESS        - IP address to bind to (default: 127.0.0.1)\n";
+    std::cout << "    BIND_ADDRESS        - IP address to bind to, IPv4 or IPv6 (default: 127.0.0.1)\n";
     std::cout << "    SERIAL_LISTEN_PORT  - TCP port for serial protocol (default: 16175, 0 = disabled)\n";
     std::cout << "    HTTP_LISTEN_PORT    - HTTP port for JSON API (default: 16180, 0 = disabled)\n";
     std::cout << "    HTTP_AUTH_CREDENTIALS - Password file path (default: passwords)\n";
     std::cout << "    TTGO_DEVICE         - Serial device path (default: /dev/ttyACM0)\n";
     std::cout << "    TTGO_BAUDRATE       - Serial baudrate (default: 115200)\n";
     std::cout << "    TTGO_POWER          - TX power level (default: 2, range: 2-17)\n";
-    std::cout << "    DEFAULT_FREQUENCY   - Default frequency Hz (default: 916000000)\n\n";
+    std::cout << "    DEFAULT_FREQUENCY   - Default frequency Hz (default: 916000000)\n";
+    std::cout << "    HTTP_HEADER_TIMEOUT - Seconds a client has to send the request headers (default: 10)\n";
+    std::cout << "    HTTP_BODY_TIMEOUT   - Seconds a client has to send the request body (default: 30)\n";
+    std::cout << "    HTTP_MAX_HEADER_SIZE - Largest request headers accepted in bytes, else 431 (default: 8192)\n";
+    std::cout << "    HTTP_MAX_BODY_SIZE  - Largest request body accepted in bytes, else 413 (default: 65536)\n";
+    std::cout << "    MAX_CONNECTIONS_PER_IP - Connections one address may hold, 0 = unlimited (default: 4)\n";
+    std::cout << "    HTTP_AUTH_CACHE_TTL - Seconds a verified login is cached, 0 = disabled (default: 300)\n";
+    std::cout << "    HTTP_AUTH_CACHE_SIZE - Maximum number of cached logins (default: 1024)\n";
+    std::cout << "    LISTEN_BACKLOG      - Pending connections queued by the kernel per port (default: 128)\n";
+    std::cout << "    LISTEN_REUSEPORT    - 1 = set SO_REUSEPORT so another instance can share the ports (default: 0)\n";
+    std::cout << "    LISTEN_DEFER_ACCEPT - TCP_DEFER_ACCEPT seconds, 0 = off (default: 0)\n";
+    std::cout << "    LISTEN_FASTOPEN     - TCP_FASTOPEN queue length, 0 = off (default: 0)\n";
+    std::cout << "    LOG_LEVELS          - Log level, optionally per component, e.g. info,ttgo=trace (default: info)\n\n";
 
     std::cout << "TTGO-FSK-TX HARDWARE:\n";
     std::cout << "  This server communicates with TTGO ESP32 + SX127x module running ttgo-fsk-tx firmware.\n";
@@ -61,7 +86,8 @@ void print_help() {
     std::cout << "  Example: echo '001122334|Hello World|916000000' | nc localhost 16175\n\n";
 
     std::cout << "HTTP PROTOCOL (JSON API) - Modern REST API:\n";
-    std::cout << "  Endpoint: POST http://localhost:16180/\n";
+    std::cout << "  Endpoint: POST http://localhost:16180/ (queues the page, returns a job ID)\n";
+    std::cout << "  Status:   GET  http://localhost:16180/messages/{id}\n";
     std::cout << "  Authentication: HTTP Basic Auth (required)\n";
     std::cout << "  Content-Type: application/json\n\n";
 
@@ -73,11 +99,13 @@ void print_help() {
     std::cout << "  }\n\n";
 
     std::cout << "  HTTP Response Codes (AWS Lambda Compatible):\n";
-    std::cout << "    200 OK                - Message transmitted successfully\n";
+    std::cout << "    202 Accepted          - Message queued for transmission (body carries job ID)\n";
+    std::cout << "    200 OK                - Job status returned (GET /messages/{id})\n";
     std::cout << "    400 Bad Request       - Invalid JSON or missing required fields\n";
     std::cout << "    401 Unauthorized      - Authentication required/failed\n";
-    std::cout << "    405 Method Not Allowed - Only POST requests supported\n";
-    std::cout << "    500 Internal Error    - Processing/transmission failure\n\n";
+    std::cout << "    404 Not Found         - Unknown job ID or path\n";
+    std::cout << "    405 Method Not Allowed - Only POST and GET requests supported\n";
+    std::cout << "    500 Internal Error    - Transmission failure (serial protocol only)\n\n";
 
     std::cout << "TTGO COMMANDS:\n";
     std::cout << "  The server sends these commands to TTGO device:\n";
@@ -95,11 +123,40 @@ void print_help() {
     std::cout << "  # Send message via TCP\n";
     std::cout << "  echo '1122334|Test Message|916000000' | nc localhost 16175\n\n";
 
+    std::cout << "LOGGING:\n";
+    std::cout << "  JSON lines on stdout. Components: core, http, serial, encoder, radio, ttgo.\n";
+    std::cout << "  Levels: error, warn, info, debug, trace. To change them at runtime:\n";
+    std::cout << "    curl -u admin:passw0rd http://localhost:16180/log-levels\n";
+    std::cout << "    curl -u admin:passw0rd -d 'radio=debug,ttgo=trace' http://localhost:16180/log-levels\n\n";
+
     std::cout << "DEBUGGING:\n";
-    std::cout << "  --verbose: Shows all TTGO communication and FLEX encoding details\n";
+    std::cout << "  --verbose: Logs all TTGO communication and FLEX encoding details\n";
     std::cout << "  --debug:   Shows commands but skips actual transmission\n\n";
 }
 
+// Signal handler for graceful shutdown
+static volatile sig_atomic_t keep_running = 1;
+static volatile sig_atomic_t stop_signal = 0;
+static volatile sig_atomic_t reload_requested = 0;
+
+// SIGHUP only asks for a reload. The first stop signal lets the page being
+// sent finish; a second one stops at once, putting the serial port back
+// first (tcsetattr is async-signal-safe)
+void signal_handler(int sig) {
+    if (sig == SIGHUP) {
+        reload_requested = 1;
+        return;
+    }
+    if (!keep_running) {
+        restore_ttgo_tty();
+        signal(sig, SIG_DFL);
+        raise(sig);
+        return;
+    }
+    keep_running = 0;
+    stop_signal = sig;
+}
+
 struct ConnectionState {
     std::chrono::steady_clock::time_point last_transmission;
     bool first_message;
@@ -119,126 +176,86 @@ bool should_send_emr(ConnectionState& state) {
     return duration.count() >= 10;
 }
 
-void send_emr_messages(int ttgo_fd, const TtgoConfig& config, bool debug_mode, bool verbose_mode) {
-    if (verbose_mode) {
-        std::cout << "EMR Transmission:\n";
-        std::cout << "  Status: STARTING EMR (Emergency Message Resynchronization)...\n";
-    }
-
+void send_emr_messages(int ttgo_fd, const TtgoConfig& config, bool debug_mode) {
     if (debug_mode) {
-        if (verbose_mode) {
-            std::cout << "  Status: SKIPPED (debug mode active)\n\n";
-        }
+        log_debug(LOG_RADIO, "emr_skipped").s("reason", "debug mode");
         return;
     }
+    log_debug(LOG_RADIO, "emr_start");
 
     // EMR message is typically a short synchronization burst
     uint8_t emr_buffer[] = {0xA5, 0x5A, 0xA5, 0x5A}; // Simple sync pattern
 
-    if (send_flex_via_ttgo(ttgo_fd, config, emr_buffer, sizeof(emr_buffer), verbose_mode) == 0) {
-        if (verbose_mode) {
-            std::cout << "  Status: EMR COMPLETED\n\n";
-        }
+    if (send_flex_via_ttgo(ttgo_fd, config, emr_buffer, sizeof(emr_buffer)) == 0) {
+        log_debug(LOG_RADIO, "emr_done");
     } else {
-        if (verbose_mode) {
-            std::cout << "  Status: EMR FAILED\n\n";
-        }
+        log_warn(LOG_RADIO, "emr_failed");
     }
 }
 
-void log_message_processing_start(uint64_t capcode, const std::string& message, uint64_t frequency, bool verbose_mode) {
-    if (!verbose_mode) return;
-
-    std::cout << "=== Message Processing Started ===\n";
-    std::cout << "Input Parameters:\n";
-    std::cout << "  CAPCODE: " << capcode << "\n";
-    std::cout << "  MESSAGE: '" << message << "' (" << message.length() << " characters)\n";
-    std::cout << "  FREQUENCY: " << frequency << " Hz (" << std::fixed << std::setprecision(6)
-              << (frequency / 1000000.0) << " MHz)\n\n";
+void log_message_processing_start(uint64_t capcode, const std::string& message, uint64_t frequency) {
+    log_debug(LOG_ENCODER, "encode_start").u("capcode", capcode).u("frequency", frequency)
+        .u("length", message.length()).s("message", message);
 }
 
-void log_capcode_validation(uint64_t capcode, bool verbose_mode) {
-    if (!verbose_mode) return;
+void log_capcode_validation(uint64_t capcode) {
+    if (!log_enabled(LOG_ENCODER, LOG_LEVEL_TRACE)) return;
 
     int is_long;
     bool valid = is_capcode_valid(capcode, &is_long);
-
-    std::cout << "Capcode Validation:\n";
-    std::cout << "  Capcode: " << capcode << " is " << (is_long ? "LONG (32-bit)" : "SHORT (18-bit)") << "\n";
-    std::cout << "  Status: " << (valid ? "VALID" : "INVALID") << "\n\n";
+    log_trace(LOG_ENCODER, "capcode_checked").u("capcode", capcode).b("long", is_long).b("valid", valid);
 }
 
-void log_flex_encoding(const uint8_t* flex_buffer, size_t flex_len, const std::string& message, bool verbose_mode) {
-    if (!verbose_mode) return;
-
-    std::cout << "FLEX Encoding:\n";
-    std::cout << "  Input message length: " << message.length() << " bytes\n";
-    std::cout << "  Buffer size: 1024 bytes\n";
-    std::cout << "  Encoded length: " << flex_len << " bytes\n";
-    std::cout << "  Encoding status: SUCCESS\n";
-    std::cout << "  Encoded FLEX data: ";
-
-    // Print ALL bytes in hex format
-    for (size_t i = 0; i < flex_len; ++i) {
-        if (i > 0 && i % 16 == 0) {
-            std::cout << "\n                     ";
-        }
-        std::cout << std::hex << std::uppercase << std::setfill('0') << std::setw(2)
-                  << static_cast<int>(flex_buffer[i]) << " ";
-    }
-    std::cout << std::dec << "\n\n";
+void log_flex_encoding(const uint8_t* flex_buffer, size_t flex_len, const std::string& message) {
+    log_debug(LOG_ENCODER, "encoded").u("message_bytes", message.length()).u("frame_bytes", flex_len);
+    // The hex dump is only copied here; formatting happens on the log thread
+    log_trace(LOG_ENCODER, "frame").hex("data", flex_buffer, flex_len);
 }
 
-void log_ttgo_setup(uint64_t frequency, int power, const std::string& device, bool verbose_mode) {
-    if (!verbose_mode) return;
-
-    std::cout << "TTGO Setup:\n";
-    std::cout << "  Serial device: " << device << "\n";
-    std::cout << "  Target frequency: " << frequency << " Hz (" << std::fixed << std::setprecision(6)
-              << (frequency / 1000000.0) << " MHz)\n";
-    std::cout << "  TX power: " << power << "\n";
-    std::cout << "  TTGO device: READY\n\n";
+void log_ttgo_setup(uint64_t frequency, int power, const std::string& device) {
+    log_debug(LOG_RADIO, "device_ready").s("device", device).u("frequency", frequency).i("power", power);
 }
 
-void log_ttgo_transmission_start(bool debug_mode, bool verbose_mode) {
-    if (!verbose_mode) return;
-
-    std::cout << "TTGO Transmission:\n";
+void log_ttgo_transmission_start(bool debug_mode) {
     if (debug_mode) {
-        std::cout << "  Status: SKIPPED (debug mode active)\n";
+        log_debug(LOG_RADIO, "transmit_skipped").s("reason", "debug mode");
     } else {
-        std::cout << "  Status: STARTING...\n";
+        log_debug(LOG_RADIO, "transmit_start");
     }
 }
 
-void log_ttgo_transmission_complete(bool debug_mode, bool verbose_mode) {
-    if (!verbose_mode) return;
-
+void log_ttgo_transmission_complete(bool debug_mode, bool success) {
     if (!debug_mode) {
-        std::cout << "  Status: COMPLETED\n";
+        log_debug(LOG_RADIO, "transmit_done").b("success", success);
     }
-    std::cout << "=== Message Processing Completed ===\n\n";
 }
 
-bool process_message(uint64_t capcode, const std::string& message, uint64_t frequency,
-                    ConnectionState& conn_state, const Config& config,
-                    bool debug_mode, bool verbose_mode) {
-
-    log_message_processing_start(capcode, message, frequency, verbose_mode);
-
-    // Validate capcode
+// Checks that a page can be encoded and transmitted before it is queued.
+// Returns an empty string when valid, otherwise a client-facing error.
+std::string validate_message(uint64_t capcode, uint64_t frequency) {
     int is_long;
     if (!is_capcode_valid(capcode, &is_long)) {
-        std::cerr << "Invalid capcode: " << capcode << std::endl;
-        return false;
+        return "Invalid capcode";
     }
-    log_capcode_validation(capcode, verbose_mode);
-
-    // Validate frequency
     if (frequency < 1000000 || frequency > 6000000000) {
-        std::cerr << "Frequency out of valid range: " << frequency << std::endl;
+        return "Frequency out of valid range";
+    }
+    return "";
+}
+
+bool process_message(uint64_t capcode, const std::string& message, uint64_t frequency,
+                    ConnectionState& conn_state, const Config& config,
+                    bool debug_mode) {
+
+    log_message_processing_start(capcode, message, frequency);
+
+    std::string validation_error = validate_message(capcode, frequency);
+    if (!validation_error.empty()) {
+        log_error(LOG_ENCODER, "invalid_page").s("error", validation_error).u("capcode", capcode)
+            .u("frequency", frequency);
         return false;
     }
+    log_capcode_validation(capcode);
 
     // Encode message using TinyFlex
     uint8_t flex_buffer[1024];
@@ -246,18 +263,18 @@ bool process_message(uint64_t capcode, const std::string& message, uint64_t freq
     size_t flex_len = tf_encode_flex_message(message.c_str(), capcode, flex_buffer, sizeof(flex_buffer), &error);
 
     if (error < 0) {
-        std::cerr << "Error encoding message: " << error << std::endl;
+        log_error(LOG_ENCODER, "encode_failed").i("error", error).u("capcode", capcode);
         return false;
     }
-    log_flex_encoding(flex_buffer, flex_len, message, verbose_mode);
+    log_flex_encoding(flex_buffer, flex_len, message);
 
     // Setup TTGO connection
     int ttgo_fd = open_ttgo_serial(config.TTGO_DEVICE, config.TTGO_BAUDRATE);
     if (ttgo_fd < 0) {
-        std::cerr << "Failed to open TTGO device: " << config.TTGO_DEVICE << std::endl;
+        log_error(LOG_RADIO, "device_open_failed").s("device", config.TTGO_DEVICE).s("error", strerror(errno));
         return false;
     }
-    log_ttgo_setup(frequency, config.TTGO_POWER, config.TTGO_DEVICE, verbose_mode);
+    log_ttgo_setup(frequency, config.TTGO_POWER, config.TTGO_DEVICE);
 
     // Create TTGO config for transmission
     TtgoConfig ttgo_config;
@@ -267,14 +284,14 @@ bool process_message(uint64_t capcode, const std::string& message, uint64_t freq
     // Check if we need to send EMR messages
     bool need_emr = should_send_emr(conn_state);
     if (need_emr) {
-        send_emr_messages(ttgo_fd, ttgo_config, debug_mode, verbose_mode);
+        send_emr_messages(ttgo_fd, ttgo_config, debug_mode);
     }
 
     // Transmit FLEX message via TTGO
-    log_ttgo_transmission_start(debug_mode, verbose_mode);
+    log_ttgo_transmission_start(debug_mode);
     bool success = false;
     if (!debug_mode) {
-        success = (send_flex_via_ttgo(ttgo_fd, ttgo_config, flex_buffer, flex_len, verbose_mode) == 0);
+        success = (send_flex_via_ttgo(ttgo_fd, ttgo_config, flex_buffer, flex_len) == 0);
 
         if (success) {
             // Update connection state
@@ -284,20 +301,47 @@ bool process_message(uint64_t capcode, const std::string& message, uint64_t freq
     } else {
         success = true; // In debug mode, we consider it successful
     }
-    log_ttgo_transmission_complete(debug_mode, verbose_mode);
+    log_ttgo_transmission_complete(debug_mode, success);
 
     close_ttgo_serial(ttgo_fd);
     return success;
 }
 
-void handle_serial_client(int client_fd, ConnectionState& conn_state, const Config& config,
-                         bool debug_mode, bool verbose_mode) {
+// Radio thread: the only place that touches the transmitter once the
+// server is running, so transmissions stay strictly serialized. Settings
+// are taken from the current snapshot for each page.
+void radio_worker(JobQueue& queue, const ConfigStore& configs, bool debug_mode) {
+    ConnectionState conn_state;
+
+    while (true) {
+        std::shared_ptr<Job> job = queue.pop();
+        if (!job) {
+            break;
+        }
+
+        log_debug(LOG_RADIO, "job_start").u("id", job->id).u("queued", queue.depth());
+        bool success = process_message(job->capcode, job->message, job->frequency,
+                                       conn_state, configs.current(), debug_mode);
+        queue.finish(job, success);
+
+        if (!success) {
+            log_error(LOG_RADIO, "job_failed").u("id", job->id).u("capcode", job->capcode);
+        }
+    }
+}
+
+void handle_serial_client(int client_fd, JobQueue& queue) {
     char buffer[2048] = {0};
 
-    // Read input from client
-    int valRead = read(client_fd, buffer, sizeof(buffer) - 1);
+    // Read input from client; a client that never sends is dropped
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(SERIAL_READ_TIMEOUT);
+    ssize_t valRead = read_before(client_fd, buffer, sizeof(buffer) - 1, deadline);
     if (valRead <= 0) {
-        perror("read");
+        if (valRead < 0 && errno == EAGAIN) {
+            log_debug(LOG_SERIAL, "read_timeout").i("seconds", SERIAL_READ_TIMEOUT);
+        } else if (valRead < 0 && errno != EINTR) {
+            log_warn(LOG_SERIAL, "read_failed").s("error", strerror(errno));
+        }
         return;
     }
 
@@ -309,6 +353,7 @@ void handle_serial_client(int client_fd, ConnectionState& conn_state, const Conf
     size_t pos2 = input.rfind('|');
     if (pos1 == std::string::npos || pos2 == std::string::npos || pos1 == pos2) {
         std::string error_msg = "Invalid input format. Expected: CAPCODE|MESSAGE|FREQUENCY";
+        log_debug(LOG_SERIAL, "rejected").s("error", error_msg);
         send(client_fd, error_msg.c_str(), error_msg.size(), 0);
         return;
     }
@@ -325,11 +370,24 @@ void handle_serial_client(int client_fd, ConnectionState& conn_state, const Conf
         frequency = std::stoull(freq_str);
     } catch (const std::exception& e) {
         std::string error_msg = "Invalid capcode or frequency format";
+        log_debug(LOG_SERIAL, "rejected").s("error", error_msg);
         send(client_fd, error_msg.c_str(), error_msg.size(), 0);
         return;
     }
 
-    if (process_message(capcode, message, frequency, conn_state, config, debug_mode, verbose_mode)) {
+    std::string validation_error = validate_message(capcode, frequency);
+    if (!validation_error.empty()) {
+        log_debug(LOG_SERIAL, "rejected").s("error", validation_error);
+        send(client_fd, validation_error.c_str(), validation_error.size(), 0);
+        return;
+    }
+
+    // The legacy protocol reports the transmission result, so wait for the
+    // radio thread to get through the job before answering
+    uint64_t job_id = queue.submit(capcode, message, frequency);
+    log_debug(LOG_SERIAL, "queued").u("id", job_id).u("capcode", capcode);
+
+    if (queue.wait(job_id) == JOB_SENT) {
         std::string success_msg = "Message sent successfully!";
         send(client_fd, success_msg.c_str(), success_msg.size(), 0);
     } else {
@@ -338,60 +396,108 @@ void handle_serial_client(int client_fd, ConnectionState& conn_state, const Conf
     }
 }
 
-void handle_http_client(int client_fd, const std::map<std::string, std::string>& passwords,
-                       ConnectionState& conn_state, const Config& config,
-                       bool debug_mode, bool verbose_mode) {
-    char buffer[8192] = {0};
-    struct sockaddr_in client_addr;
-    socklen_t client_len = sizeof(client_addr);
-
-    // Get client info for logging
-    std::string client_ip = "unknown";
-    int client_port = 0;
-    if (getpeername(client_fd, (struct sockaddr*)&client_addr, &client_len) == 0) {
-        client_ip = inet_ntoa(client_addr.sin_addr);
-        client_port = ntohs(client_addr.sin_port);
+// GET /log-levels shows the level of every component; POST changes them,
+// taking the same form as LOG_LEVELS in the body (e.g. "ttgo=trace")
+void handle_log_levels_request(int client_fd, const HttpRequest& request, const std::string& user) {
+    if (request.method == "POST") {
+        std::string error;
+        if (!logger().set_levels(trim(request.body), error)) {
+            std::string escaped;
+            log_json_escape(escaped, error);
+            send_http_response(client_fd, 400, "Bad Request", "{\"error\":\"" + escaped + "\",\"code\":400}");
+            return;
+        }
+        log_info(LOG_CORE, "log_levels_changed").s("user", user).s("log_levels", logger().levels_spec());
     }
+    send_http_response(client_fd, 200, "OK", "{\"log_levels\":\"" + logger().levels_spec() + "\"}");
+}
 
-    // Enhanced HTTP request reading with proper handling of body
-    std::string full_request;
-    int total_read = 0;
-    int content_length = 0;
-    bool headers_complete = false;
-    size_t headers_end_pos = 0;
+void handle_job_status_request(int client_fd, const std::string& path, JobQueue& queue) {
+    const std::string prefix = "/messages/";
+    if (path.compare(0, prefix.size(), prefix) != 0) {
+        send_http_response(client_fd, 404, "Not Found",
+                          "{\"error\":\"Not found\",\"code\":404}");
+        return;
+    }
 
-    // Read initial chunk
-    int initial_read = read(client_fd, buffer, sizeof(buffer) - 1);
-    if (initial_read <= 0) {
-        if (verbose_mode) {
-            std::cout << "Failed to read initial HTTP data from client\n";
+    uint64_t job_id = 0;
+    try {
+        size_t consumed = 0;
+        std::string id_str = path.substr(prefix.size());
+        job_id = std::stoull(id_str, &consumed);
+        if (consumed != id_str.size()) {
+            job_id = 0;
         }
-        send_http_response(client_fd, 400, "Bad Request",
-                          "{\"error\":\"Failed to read request\",\"code\":400}",
-                          "application/json", verbose_mode);
+    } catch (const std::exception& e) {
+        job_id = 0;
+    }
+
+    Job job;
+    if (job_id == 0 || !queue.lookup(job_id, job)) {
+        send_http_response(client_fd, 404, "Not Found",
+                          "{\"error\":\"Unknown message id\",\"code\":404}");
         return;
     }
 
-    buffer[initial_read] = '\0';
-    full_request = std::string(buffer, initial_read);
-    total_read = initial_read;
+    send_http_response(client_fd, 200, "OK", job_status_json(job));
+}
 
-    if (verbose_mode) {
-        std::cout << "\n=== HTTP Client Connected ===\n";
-        std::cout << "Client IP: " << client_ip << "\n";
-        std::cout << "Client Port: " << client_port << "\n";
-        std::cout << "Initial read: " << initial_read << " bytes\n";
+void handle_http_client(int client_fd, const std::string& client_ip, int client_port,
+                       const std::map<std::string, std::string>& passwords, AuthCache& auth_cache,
+                       JobQueue& queue, const Config& config) {
+    char buffer[8192] = {0};
+
+    // Read the headers and then the body, each against its own deadline,
+    // so a client that connects and goes quiet cannot hold the server
+    std::string full_request;
+    int content_length = 0;
+    size_t headers_end_pos = std::string::npos;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(config.HTTP_HEADER_TIMEOUT);
+
+    while (headers_end_pos == std::string::npos) {
+        ssize_t got = read_before(client_fd, buffer, sizeof(buffer) - 1, deadline);
+        if (got < 0 && errno == EINTR) {
+            if (!keep_running) {
+                return;
+            }
+            continue;
+        }
+        if (got < 0 && errno == EAGAIN) {
+            log_debug(LOG_HTTP, "header_timeout").s("client", client_ip).i("port", client_port)
+                .u("bytes", full_request.size());
+            send_http_response(client_fd, 408, "Request Timeout",
+                              "{\"error\":\"Request headers not received in time\",\"code\":408}");
+            return;
+        }
+        if (got <= 0) {
+            break;
+        }
+        full_request.append(buffer, got);
+
+        headers_end_pos = full_request.find("\r\n\r\n");
+        size_t header_bytes = headers_end_pos == std::string::npos ? full_request.size() : headers_end_pos;
+        if (header_bytes > config.HTTP_MAX_HEADER_SIZE) {
+            log_debug(LOG_HTTP, "headers_too_large").s("client", client_ip).u("bytes", header_bytes);
+            send_http_response(client_fd, 431, "Request Header Fields Too Large",
+                              "{\"error\":\"Request headers too large\",\"code\":431}");
+            return;
+        }
+    }
+
+    if (full_request.empty()) {
+        log_debug(LOG_HTTP, "read_failed").s("client", client_ip).i("port", client_port);
+        send_http_response(client_fd, 400, "Bad Request",
+                          "{\"error\":\"Failed to read request\",\"code\":400}");
+        return;
     }
 
-    // Check if headers are complete (look for \r\n\r\n)
-    headers_end_pos = full_request.find("\r\n\r\n");
-    if (headers_end_pos != std::string::npos) {
-        headers_complete = true;
+    bool headers_complete = headers_end_pos != std::string::npos;
+    if (headers_complete) {
         headers_end_pos += 4; // Include the \r\n\r\n
     }
 
     // Parse headers to get Content-Length
-    std::istringstream header_stream(full_request);
+    std::istringstream header_stream(full_request.substr(0, headers_complete ? headers_end_pos : full_request.size()));
     std::string line;
     while (std::getline(header_stream, line) && !line.empty() && line != "\r") {
         line.erase(line.find_last_not_of("\r\n") + 1); // Remove trailing \r\n
@@ -405,119 +511,214 @@ void handle_http_client(int client_fd, const std::map<std::string, std::string>&
                 length_str.erase(0, length_str.find_first_not_of(" \t"));
                 try {
                     content_length = std::stoi(length_str);
-                    if (verbose_mode) {
-                        std::cout << "Found Content-Length: " << content_length << "\n";
-                    }
                 } catch (...) {
-                    if (verbose_mode) {
-                        std::cout << "Failed to parse Content-Length: '" << length_str << "'\n";
-                    }
+                    log_debug(LOG_HTTP, "bad_content_length").s("value", length_str);
                 }
             }
             break;
         }
     }
 
+    if (content_length > 0 && static_cast<uint32_t>(content_length) > config.HTTP_MAX_BODY_SIZE) {
+        log_debug(LOG_HTTP, "body_too_large").s("client", client_ip).i("content_length", content_length);
+        send_http_response(client_fd, 413, "Payload Too Large",
+                          "{\"error\":\"Request body too large\",\"code\":413}");
+        return;
+    }
+
     // If we have content-length, make sure we read the complete body
     if (content_length > 0 && headers_complete) {
-        size_t body_start = headers_end_pos;
-        int body_received = full_request.length() - body_start;
-
-        if (verbose_mode) {
-            std::cout << "Body bytes received so far: " << body_received << "\n";
-            std::cout << "Expected body length: " << content_length << "\n";
-        }
+        int body_received = full_request.length() - headers_end_pos;
+        deadline = std::chrono::steady_clock::now() + std::chrono::seconds(config.HTTP_BODY_TIMEOUT);
 
         // Read more data if needed
         while (body_received < content_length) {
-            int additional_read = read(client_fd, buffer, sizeof(buffer) - 1);
-            if (additional_read <= 0) {
-                if (verbose_mode) {
-                    std::cout << "Failed to read additional body data\n";
+            ssize_t additional_read = read_before(client_fd, buffer, sizeof(buffer) - 1, deadline);
+            if (additional_read < 0 && errno == EINTR) {
+                if (!keep_running) {
+                    return;
                 }
+                continue;
+            }
+            if (additional_read < 0 && errno == EAGAIN) {
+                log_debug(LOG_HTTP, "body_timeout").s("client", client_ip).i("received", body_received)
+                    .i("expected", content_length);
+                send_http_response(client_fd, 408, "Request Timeout",
+                                  "{\"error\":\"Request body not received in time\",\"code\":408}");
+                return;
+            }
+            if (additional_read <= 0) {
+                log_debug(LOG_HTTP, "body_truncated").i("received", body_received).i("expected", content_length);
                 break;
             }
 
-            buffer[additional_read] = '\0';
-            full_request += std::string(buffer, additional_read);
+            full_request.append(buffer, additional_read);
             body_received += additional_read;
-            total_read += additional_read;
-
-            if (verbose_mode) {
-                std::cout << "Read additional " << additional_read << " bytes\n";
-                std::cout << "Total body received: " << body_received << "/" << content_length << "\n";
-            }
+            log_trace(LOG_HTTP, "body_chunk").i("bytes", additional_read).i("received", body_received)
+                .i("expected", content_length);
         }
     }
 
-    if (verbose_mode) {
-        std::cout << "Final HTTP Request (" << full_request.length() << " bytes):\n";
-        std::cout << "---\n" << full_request << "---\n";
-    }
+    log_http_request(full_request, client_ip, client_port);
 
     HttpRequest request = parse_http_request(full_request);
-    log_parsed_request(request, verbose_mode);
+    log_parsed_request(request);
+
+    // Check authentication; a recently verified header skips the crypt() call
+    auto auth_it = request.headers.find("authorization");
+    std::string user;
+    bool authenticated = false;
+    if (auth_it != request.headers.end()) {
+        authenticated = auth_cache.contains(auth_it->second);
+        if (authenticated) {
+            user = basic_auth_user(auth_it->second);
+        } else if (authenticate_user(auth_it->second, passwords, &user)) {
+            auth_cache.insert(auth_it->second, auth_cache.generation());
+            authenticated = true;
+        }
+    }
 
-    // Check if it's a POST request
-    if (request.method != "POST") {
+    if (request.path == "/log-levels") {
+        if (!authenticated) {
+            send_unauthorized_response(client_fd);
+            return;
+        }
+        handle_log_levels_request(client_fd, request, user);
+        return;
+    }
+
+    // Only POST (submit) and GET (job status) are supported
+    if (request.method != "POST" && request.method != "GET") {
         send_http_response(client_fd, 405, "Method Not Allowed",
-                          "{\"error\":\"Only POST method is allowed\",\"code\":405}",
-                          "application/json", verbose_mode);
+                          "{\"error\":\"Only POST and GET methods are allowed\",\"code\":405}");
         return;
     }
 
-    // Check authentication
-    auto auth_it = request.headers.find("authorization");
-    if (auth_it == request.headers.end() || !authenticate_user(auth_it->second, passwords)) {
-        send_unauthorized_response(client_fd, verbose_mode);
+    if (!authenticated) {
+        send_unauthorized_response(client_fd);
+        return;
+    }
+
+    if (request.method == "GET") {
+        handle_job_status_request(client_fd, request.path, queue);
         return;
     }
 
     // Parse JSON message
     JsonMessage json_msg = parse_json_message(request.body);
     if (!json_msg.valid) {
-        if (verbose_mode) {
-            std::cout << "*** JSON MESSAGE PARSING FAILED ***\n";
-            std::cout << "Body was: '" << request.body << "'\n";
-        }
+        log_debug(LOG_HTTP, "json_invalid").s("body", request.body);
         send_http_response(client_fd, 400, "Bad Request",
-                          "{\"error\":\"Invalid JSON format or missing required fields\",\"code\":400}",
-                          "application/json", verbose_mode);
+                          "{\"error\":\"Invalid JSON format or missing required fields\",\"code\":400}");
         return;
     }
 
     // Validate required fields: capcode and message are MANDATORY
     if (json_msg.capcode == 0) {
         send_http_response(client_fd, 400, "Bad Request",
-                          "{\"error\":\"Missing required field: capcode must be specified\",\"code\":400}",
-                          "application/json", verbose_mode);
+                          "{\"error\":\"Missing required field: capcode must be specified\",\"code\":400}");
         return;
     }
 
     if (json_msg.message.empty()) {
         send_http_response(client_fd, 400, "Bad Request",
-                          "{\"error\":\"Missing required field: message must be specified\",\"code\":400}",
-                          "application/json", verbose_mode);
+                          "{\"error\":\"Missing required field: message must be specified\",\"code\":400}");
         return;
     }
 
-    log_json_processing(json_msg, config.DEFAULT_FREQUENCY, verbose_mode);
+    log_json_processing(json_msg, config.DEFAULT_FREQUENCY);
 
     // Use default frequency if not provided (frequency is optional)
     uint64_t frequency = json_msg.frequency > 0 ? json_msg.frequency : config.DEFAULT_FREQUENCY;
 
-    if (process_message(json_msg.capcode, json_msg.message, frequency, conn_state, config, debug_mode, verbose_mode)) {
-        send_http_response(client_fd, 200, "OK",
-                          "{\"status\":\"success\",\"message\":\"Message transmitted successfully\"}",
-                          "application/json", verbose_mode);
+    std::string validation_error = validate_message(json_msg.capcode, frequency);
+    if (!validation_error.empty()) {
+        send_http_response(client_fd, 400, "Bad Request",
+                          "{\"error\":\"" + validation_error + "\",\"code\":400}");
+        return;
+    }
 
-        if (verbose_mode) {
-            std::cout << "HTTP client disconnected.\n\n";
+    // Hand the page to the radio thread and answer right away
+    uint64_t job_id = queue.submit(json_msg.capcode, json_msg.message, frequency);
+    log_debug(LOG_HTTP, "queued").u("id", job_id).u("capcode", json_msg.capcode).s("user", user);
+    send_http_response(client_fd, 202, "Accepted",
+                      "{\"status\":\"queued\",\"id\":" + std::to_string(job_id) +
+                      ",\"location\":\"/messages/" + std::to_string(job_id) + "\"}");
+}
+
+// Files reread while the server runs, and what was last seen of each
+struct ReloadState {
+    std::string config_path;        // empty when the settings came from the environment
+    FileStamp config_stamp;
+    FileStamp passwords_stamp;
+    bool http_auth = false;         // the HTTP port, and so the password file, is in use
+    bool keep_log_levels = false;   // --verbose overrides LOG_LEVELS
+};
+
+/**
+ * @brief Rereads config.ini and the password file if they changed (both
+ * when forced, on SIGHUP) and publishes them for the next client and page.
+ *
+ * Runs on the main loop between clients. A file that cannot be read or
+ * does not validate is reported and the running settings stay as they are.
+ */
+void reload_settings(ReloadState& state, bool force, ConfigStore& configs,
+                     std::map<std::string, std::string>& passwords, AuthCache& auth_cache) {
+    const Config& current = configs.current();
+    bool config_changed = !state.config_path.empty() &&
+                          file_stamp_changed(state.config_path, state.config_stamp);
+    if (config_changed || (force && !state.config_path.empty())) {
+        Config loaded;
+        std::string error;
+        bool ok = false;
+        try {
+            ok = load_config(state.config_path, loaded);
+            if (!ok) {
+                error = strerror(errno);
+            }
+        } catch (const std::exception& e) {
+            error = std::string("invalid value (") + e.what() + ")";
+        }
+        ok = ok && validate_config(loaded, error);
+
+        Config next = current;
+        std::vector<std::string> changed = config_apply_reloadable(next, loaded);
+        std::vector<std::string> pending = config_restart_changes(current, loaded);
+        if (ok && !state.keep_log_levels && next.LOG_LEVELS != current.LOG_LEVELS) {
+            ok = logger().set_levels(next.LOG_LEVELS, error);
+        }
+        auto join = [](const std::vector<std::string>& list) {
+            std::string names;
+            for (const std::string& name : list) {
+                names += (names.empty() ? "" : ",") + name;
+            }
+            return names;
+        };
+        if (!ok) {
+            log_error(LOG_CORE, "config_reload_failed").s("path", state.config_path).s("error", error);
+        } else {
+            if (!changed.empty()) {
+                configs.publish(next);
+                log_info(LOG_CORE, "config_reloaded").s("path", state.config_path).s("changed", join(changed));
+            } else if (pending.empty()) {
+                log_info(LOG_CORE, "config_unchanged").s("path", state.config_path);
+            }
+            // Edited, but the running server keeps the old values
+            if (!pending.empty()) {
+                log_warn(LOG_CORE, "config_restart_required").s("path", state.config_path)
+                    .s("keys", join(pending));
+            }
         }
-    } else {
-        send_http_response(client_fd, 500, "Internal Server Error",
-                          "{\"error\":\"Failed to process message\",\"code\":500}",
-                          "application/json", verbose_mode);
+    }
+
+    // Cached logins may no longer be valid once the passwords change
+    if (!state.http_auth) {
+        return;
+    }
+    if (file_stamp_changed(current.HTTP_AUTH_CREDENTIALS, state.passwords_stamp) || force) {
+        passwords = load_passwords(current.HTTP_AUTH_CREDENTIALS);
+        auth_cache.clear();
+        log_info(LOG_CORE, "passwords_reloaded").u("users", passwords.size());
     }
 }
 
@@ -544,10 +745,13 @@ int main(int argc, char* argv[]) {
 
     Config config;
     bool config_loaded = false;
+    ReloadState reload_state;
 
     // Try to load config.ini first
     if (load_config("config.ini", config)) {
         config_loaded = true;
+        reload_state.config_path = "config.ini";
+        file_stamp_changed(reload_state.config_path, reload_state.config_stamp);
         if (verbose_mode) {
             std::cout << "Configuration loaded from config.ini\n";
         }
@@ -565,6 +769,18 @@ int main(int argc, char* argv[]) {
         const char* env_ttgo_baudrate = getenv("TTGO_BAUDRATE");
         const char* env_ttgo_power = getenv("TTGO_POWER");
         const char* env_default_freq = getenv("DEFAULT_FREQUENCY");
+        const char* env_header_timeout = getenv("HTTP_HEADER_TIMEOUT");
+        const char* env_body_timeout = getenv("HTTP_BODY_TIMEOUT");
+        const char* env_max_header_size = getenv("HTTP_MAX_HEADER_SIZE");
+        const char* env_max_body_size = getenv("HTTP_MAX_BODY_SIZE");
+        const char* env_max_connections_per_ip = getenv("MAX_CONNECTIONS_PER_IP");
+        const char* env_http_auth_cache_ttl = getenv("HTTP_AUTH_CACHE_TTL");
+        const char* env_http_auth_cache_size = getenv("HTTP_AUTH_CACHE_SIZE");
+        const char* env_listen_backlog = getenv("LISTEN_BACKLOG");
+        const char* env_listen_reuseport = getenv("LISTEN_REUSEPORT");
+        const char* env_listen_defer_accept = getenv("LISTEN_DEFER_ACCEPT");
+        const char* env_listen_fastopen = getenv("LISTEN_FASTOPEN");
+        const char* env_log_levels = getenv("LOG_LEVELS");
 
         // Set defaults
         config.BIND_ADDRESS = env_bind ? std::string(env_bind) : "127.0.0.1";
@@ -575,6 +791,18 @@ int main(int argc, char* argv[]) {
         config.TTGO_BAUDRATE = env_ttgo_baudrate ? std::stoul(env_ttgo_baudrate) : 115200;
         config.TTGO_POWER = env_ttgo_power ? std::stoi(env_ttgo_power) : 2;
         config.DEFAULT_FREQUENCY = env_default_freq ? std::stoull(env_default_freq) : 916000000;
+        config.HTTP_HEADER_TIMEOUT = env_header_timeout ? std::stoul(env_header_timeout) : 10;
+        config.HTTP_BODY_TIMEOUT = env_body_timeout ? std::stoul(env_body_timeout) : 30;
+        config.HTTP_MAX_HEADER_SIZE = env_max_header_size ? std::stoul(env_max_header_size) : 8192;
+        config.HTTP_MAX_BODY_SIZE = env_max_body_size ? std::stoul(env_max_body_size) : 65536;
+        config.MAX_CONNECTIONS_PER_IP = env_max_connections_per_ip ? std::stoul(env_max_connections_per_ip) : 4;
+        config.HTTP_AUTH_CACHE_TTL = env_http_auth_cache_ttl ? std::stoul(env_http_auth_cache_ttl) : 300;
+        config.HTTP_AUTH_CACHE_SIZE = env_http_auth_cache_size ? std::stoul(env_http_auth_cache_size) : 1024;
+        config.LISTEN_BACKLOG = env_listen_backlog ? std::stoul(env_listen_backlog) : 128;
+        config.LISTEN_REUSEPORT = env_listen_reuseport ? std::stoul(env_listen_reuseport) : 0;
+        config.LISTEN_DEFER_ACCEPT = env_listen_defer_accept ? std::stoul(env_listen_defer_accept) : 0;
+        config.LISTEN_FASTOPEN = env_listen_fastopen ? std::stoul(env_listen_fastopen) : 0;
+        config.LOG_LEVELS = env_log_levels ? std::string(env_log_levels) : "info";
 
         config_loaded = true;
     }
@@ -585,8 +813,15 @@ int main(int argc, char* argv[]) {
     }
 
     // Validate TTGO configuration
-    if (config.TTGO_POWER < 2 || config.TTGO_POWER > 17) {
-        std::cerr << "Invalid TTGO_POWER: " << config.TTGO_POWER << " (must be 2-17)" << std::endl;
+    std::string config_error;
+    if (!validate_config(config, config_error)) {
+        std::cerr << config_error << std::endl;
+        return 2;
+    }
+
+    std::string log_levels_error;
+    if (!logger().set_levels(verbose_mode ? "trace" : config.LOG_LEVELS, log_levels_error)) {
+        std::cerr << "Invalid LOG_LEVELS: " << log_levels_error << std::endl;
         return 2;
     }
 
@@ -600,6 +835,18 @@ int main(int argc, char* argv[]) {
         std::cout << "  TTGO_BAUDRATE: " << config.TTGO_BAUDRATE << "\n";
         std::cout << "  TTGO_POWER: " << config.TTGO_POWER << "\n";
         std::cout << "  DEFAULT_FREQUENCY: " << config.DEFAULT_FREQUENCY << "\n";
+        std::cout << "  HTTP_HEADER_TIMEOUT: " << config.HTTP_HEADER_TIMEOUT << "\n";
+        std::cout << "  HTTP_BODY_TIMEOUT: " << config.HTTP_BODY_TIMEOUT << "\n";
+        std::cout << "  HTTP_MAX_HEADER_SIZE: " << config.HTTP_MAX_HEADER_SIZE << "\n";
+        std::cout << "  HTTP_MAX_BODY_SIZE: " << config.HTTP_MAX_BODY_SIZE << "\n";
+        std::cout << "  MAX_CONNECTIONS_PER_IP: " << config.MAX_CONNECTIONS_PER_IP << "\n";
+        std::cout << "  HTTP_AUTH_CACHE_TTL: " << config.HTTP_AUTH_CACHE_TTL << "\n";
+        std::cout << "  HTTP_AUTH_CACHE_SIZE: " << config.HTTP_AUTH_CACHE_SIZE << "\n";
+        std::cout << "  LISTEN_BACKLOG: " << config.LISTEN_BACKLOG << "\n";
+        std::cout << "  LISTEN_REUSEPORT: " << config.LISTEN_REUSEPORT << "\n";
+        std::cout << "  LISTEN_DEFER_ACCEPT: " << config.LISTEN_DEFER_ACCEPT << "\n";
+        std::cout << "  LISTEN_FASTOPEN: " << config.LISTEN_FASTOPEN << "\n";
+        std::cout << "  LOG_LEVELS: " << config.LOG_LEVELS << "\n";
     }
 
     // Check if both ports are disabled
@@ -623,13 +870,31 @@ int main(int argc, char* argv[]) {
         }
     }
 
+    // Listening sockets from systemd socket activation. systemd holds the
+    // ports across restarts, so clients wait in the listen backlog
+    // instead of being refused.
+    InheritedListeners inherited;
+    if (inherited.load_systemd() > 0) {
+        printf("Using %zu listening socket(s) from systemd\n", inherited.size());
+    }
+
     // Setup servers
     int serial_server_fd = -1;
     int http_server_fd = -1;
-    struct sockaddr_in serial_address, http_address;
+    TcpListenOptions listen_options;
+    listen_options.backlog = config.LISTEN_BACKLOG;
+    listen_options.reuse_port = config.LISTEN_REUSEPORT != 0;
+    listen_options.defer_accept = config.LISTEN_DEFER_ACCEPT;
+    listen_options.fastopen = config.LISTEN_FASTOPEN;
+
+    // Inherited sockets are used as they are; the rest are bound here
+    auto listen_tcp = [&](int port) {
+        int fd = inherited.take_tcp(port);
+        return fd >= 0 ? fd : setup_tcp_server(port, config.BIND_ADDRESS, listen_options);
+    };
 
     if (config.SERIAL_LISTEN_PORT > 0) {
-        serial_server_fd = setup_tcp_server(config.SERIAL_LISTEN_PORT, serial_address, config.BIND_ADDRESS);
+        serial_server_fd = listen_tcp(config.SERIAL_LISTEN_PORT);
         if (serial_server_fd < 0) {
             std::cerr << "Failed to setup serial TCP server" << std::endl;
             return 3;
@@ -640,7 +905,7 @@ int main(int argc, char* argv[]) {
     }
 
     if (config.HTTP_LISTEN_PORT > 0) {
-        http_server_fd = setup_tcp_server(config.HTTP_LISTEN_PORT, http_address, config.BIND_ADDRESS);
+        http_server_fd = listen_tcp(config.HTTP_LISTEN_PORT);
         if (http_server_fd < 0) {
             if (serial_server_fd >= 0) close(serial_server_fd);
             std::cerr << "Failed to setup HTTP server" << std::endl;
@@ -651,6 +916,9 @@ int main(int argc, char* argv[]) {
         printf("HTTP server disabled (port = 0)\n");
     }
 
+    // Sockets systemd passed that no listener claimed
+    inherited.close_rest();
+
     // Load or create passwords file for HTTP authentication
     std::map<std::string, std::string> passwords;
     if (config.HTTP_LISTEN_PORT > 0) {
@@ -674,15 +942,118 @@ int main(int argc, char* argv[]) {
         }
     }
 
-    ConnectionState conn_state;
-    printf("TTGO HTTP/TCP Server ready, waiting for connections...\n");
+    // Only the main loop takes signals: the radio and log threads start
+    // with all three blocked, so a stop or reload never cuts device I/O
+    // short. On the main loop SA_RESTART keeps writes going, while select()
+    // and client reads (which carry a receive timeout) are still
+    // interrupted, so a stop never waits on an idle client. SIGHUP stays
+    // blocked there too except while it waits in pselect(), so a reload
+    // never cuts a client short.
+    struct sigaction signal_action;
+    memset(&signal_action, 0, sizeof(signal_action));
+    signal_action.sa_handler = signal_handler;
+    signal_action.sa_flags = SA_RESTART;
+    sigemptyset(&signal_action.sa_mask);
+    sigaction(SIGINT, &signal_action, nullptr);
+    sigaction(SIGTERM, &signal_action, nullptr);
+    sigaction(SIGHUP, &signal_action, nullptr);
+    sigset_t handled_signals;
+    sigset_t stop_signals;
+    sigset_t wait_mask;
+    sigemptyset(&handled_signals);
+    sigaddset(&handled_signals, SIGINT);
+    sigaddset(&handled_signals, SIGTERM);
+    sigaddset(&handled_signals, SIGHUP);
+    sigemptyset(&stop_signals);
+    sigaddset(&stop_signals, SIGINT);
+    sigaddset(&stop_signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &handled_signals, &wait_mask);
+    sigdelset(&wait_mask, SIGHUP);
+
+    AuthCache auth_cache(config.HTTP_AUTH_CACHE_SIZE, config.HTTP_AUTH_CACHE_TTL);
+    reload_state.http_auth = config.HTTP_LISTEN_PORT > 0;
+    reload_state.keep_log_levels = verbose_mode;
+    file_stamp_changed(config.HTTP_AUTH_CREDENTIALS, reload_state.passwords_stamp);
+
+    // config.ini and the password file are reread when inotify reports a
+    // change in their directories (polled every second without inotify)
+    // or on SIGHUP
+    ConfigStore config_store(config);
+    FileWatch settings_watch;
+    std::vector<std::string> watched_files = {config.HTTP_AUTH_CREDENTIALS};
+    if (!reload_state.config_path.empty()) {
+        watched_files.push_back(reload_state.config_path);
+    }
+    if (!settings_watch.watch(watched_files)) {
+        log_warn(LOG_CORE, "file_watch_unavailable").s("error", strerror(errno));
+    }
+    auto settings_checked = std::chrono::steady_clock::now();
+    bool settings_touched = false;
+
+    logger().start();
+
+    // All transmissions go through the radio thread
+    JobQueue job_queue;
+    std::thread radio_thread(radio_worker, std::ref(job_queue), std::cref(config_store), debug_mode);
+    pthread_sigmask(SIG_UNBLOCK, &stop_signals, nullptr);
+
+    log_info(LOG_CORE, "ready").u("http_port", config.HTTP_LISTEN_PORT).u("serial_port", config.SERIAL_LISTEN_PORT)
+        .s("log_levels", logger().levels_spec()).b("debug_mode", debug_mode);
+
+    // Clients are served one at a time. Everything already waiting on
+    // either port is accepted into a queue first, so that the per-address
+    // cap applies to it and one address cannot crowd out the rest
+    struct PendingClient {
+        int fd;
+        bool http;
+        std::string ip;
+        int port;
+    };
+    std::deque<PendingClient> pending;
+    ConnectionLimiter limiter(config.MAX_CONNECTIONS_PER_IP);
+
+    auto accept_pending = [&](int server_fd, bool http) {
+        while (true) {
+            PendingClient client;
+            client.http = http;
+            client.fd = accept_tcp_client(server_fd, client.ip, client.port);
+            if (client.fd < 0) {
+                return;
+            }
+            log_component_t component = http ? LOG_HTTP : LOG_SERIAL;
+            if (pending.size() >= MAX_PENDING_CLIENTS || !limiter.acquire(client.ip)) {
+                log_warn(component, "rejected").s("client", client.ip).i("port", client.port)
+                    .u("pending", pending.size());
+                close(client.fd);
+                continue;
+            }
+            log_debug(component, "connected").s("client", client.ip).i("port", client.port);
+            pending.push_back(client);
+        }
+    };
+
+    // Main server loop using pselect()
+    while (keep_running) {
+        // Pick up edits to config.ini and the password file
+        auto now = std::chrono::steady_clock::now();
+        bool reload_forced = reload_requested != 0;
+        bool poll_due = settings_watch.descriptor() < 0 && now - settings_checked >= std::chrono::seconds(1);
+        if (reload_forced || settings_touched || poll_due) {
+            reload_requested = 0;
+            settings_touched = false;
+            settings_checked = now;
+            reload_settings(reload_state, reload_forced, config_store, passwords, auth_cache);
+        }
+        const Config& current = config_store.current();
 
-    // Main server loop using select()
-    while (true) {
         fd_set read_fds;
         FD_ZERO(&read_fds);
 
         int max_fd = 0;
+        if (settings_watch.descriptor() >= 0) {
+            FD_SET(settings_watch.descriptor(), &read_fds);
+            max_fd = settings_watch.descriptor();
+        }
         if (serial_server_fd >= 0) {
             FD_SET(serial_server_fd, &read_fds);
             max_fd = std::max(max_fd, serial_server_fd);
@@ -692,49 +1063,68 @@ int main(int argc, char* argv[]) {
             max_fd = std::max(max_fd, http_server_fd);
         }
 
-        int activity = select(max_fd + 1, &read_fds, NULL, NULL, NULL);
-        if (activity < 0 && errno != EINTR) {
-            perror("select error");
+        // Only poll the listeners while clients are waiting their turn, and
+        // wake once a second to stat the settings files without inotify
+        struct timespec no_wait = {0, 0};
+        struct timespec poll_interval = {1, 0};
+        const struct timespec* timeout = !pending.empty() ? &no_wait :
+                                         settings_watch.descriptor() < 0 ? &poll_interval : NULL;
+        int activity = pselect(max_fd + 1, &read_fds, NULL, NULL, timeout, &wait_mask);
+        if (activity < 0) {
+            if (errno == EINTR) {
+                // The sets are left as passed in; recheck keep_running
+                continue;
+            }
+            log_error(LOG_CORE, "select_failed").s("error", strerror(errno));
             break;
         }
 
-        // Handle serial TCP connections
-        if (serial_server_fd >= 0 && FD_ISSET(serial_server_fd, &read_fds)) {
-            socklen_t serial_addrlen = sizeof(serial_address);
-            int client_fd = accept(serial_server_fd, (struct sockaddr *)&serial_address, &serial_addrlen);
-            if (client_fd >= 0) {
-                if (verbose_mode) {
-                    std::cout << "Serial TCP client connected from " << inet_ntoa(serial_address.sin_addr) << "\n";
-                } else {
-                    printf("Serial TCP client connected!\n");
-                }
+        if (activity > 0 && settings_watch.descriptor() >= 0 && FD_ISSET(settings_watch.descriptor(), &read_fds)) {
+            settings_touched = settings_watch.drain();
+        }
+        if (activity > 0 && serial_server_fd >= 0 && FD_ISSET(serial_server_fd, &read_fds)) {
+            accept_pending(serial_server_fd, false);
+        }
+        if (activity > 0 && http_server_fd >= 0 && FD_ISSET(http_server_fd, &read_fds)) {
+            accept_pending(http_server_fd, true);
+        }
 
-                handle_serial_client(client_fd, conn_state, config, debug_mode, verbose_mode);
-                close(client_fd);
+        if (pending.empty()) {
+            continue;
+        }
+        PendingClient client = pending.front();
+        pending.pop_front();
 
-                if (verbose_mode) {
-                    std::cout << "Serial TCP client connection closed.\n";
-                }
-            }
+        if (client.http) {
+            handle_http_client(client.fd, client.ip, client.port, passwords, auth_cache, job_queue, current);
+        } else {
+            handle_serial_client(client.fd, job_queue);
         }
+        close(client.fd);
+        limiter.release(client.ip);
+        log_debug(client.http ? LOG_HTTP : LOG_SERIAL, "disconnected").s("client", client.ip).i("port", client.port);
+    }
 
-        // Handle HTTP connections
-        if (http_server_fd >= 0 && FD_ISSET(http_server_fd, &read_fds)) {
-            socklen_t http_addrlen = sizeof(http_address);
-            int client_fd = accept(http_server_fd, (struct sockaddr *)&http_address, &http_addrlen);
-            if (client_fd >= 0) {
-                if (!verbose_mode) {
-                    printf("HTTP client connected!\n");
-                }
+    // Clients still waiting are dropped unanswered
+    for (const PendingClient& client : pending) {
+        close(client.fd);
+    }
 
-                handle_http_client(client_fd, passwords, conn_state, config, debug_mode, verbose_mode);
-                close(client_fd);
-            }
-        }
+    if (stop_signal) {
+        log_info(LOG_CORE, "shutting_down").s("signal", strsignal(stop_signal));
     }
 
     // Cleanup
     if (serial_server_fd >= 0) close(serial_server_fd);
     if (http_server_fd >= 0) close(http_server_fd);
+
+    // Pages already accepted are still sent; a second signal stops at once
+    size_t queued = job_queue.depth();
+    if (queued > 0) {
+        log_info(LOG_CORE, "draining").u("queued", queued);
+    }
+    job_queue.stop();
+    radio_thread.join();
+    logger().stop();
     return 0;
 }
@@ -81,6 +81,7 @@ class GrafanaWebhook:
                 'FLEX_SERVER_URL': 'http://127.0.0.1:16180',
                 'FLEX_USERNAME': 'admin',
                 'FLEX_PASSWORD': 'passw0rd',
+                'FLEX_API_TOKEN': '',
                 'DEFAULT_CAPCODE': '',
                 'DEFAULT_FREQUENCY': '931937500',
                 'REQUEST_TIMEOUT': '30'
@@ -299,21 +300,32 @@ class GrafanaWebhook:
         """Send message payload to FLEX HTTP server (HackRF or TTGO)."""
         try:
             url = self.config.get('FLEX', 'FLEX_SERVER_URL')
-            auth = (
-                self.config.get('FLEX', 'FLEX_USERNAME'),
-                self.config.get('FLEX', 'FLEX_PASSWORD')
-            )
             timeout = self.config.getint('FLEX', 'REQUEST_TIMEOUT')
 
+            # Prefer a bearer token: it avoids a password hash check per page.
+            # Only flex_http_server accepts tokens; HackRF and TTGO need Basic.
+            token = self.config.get('FLEX', 'FLEX_API_TOKEN', fallback='')
+            auth = None
+            headers = {}
+            if token:
+                headers['Authorization'] = f'Bearer {token}'
+            else:
+                auth = (
+                    self.config.get('FLEX', 'FLEX_USERNAME'),
+                    self.config.get('FLEX', 'FLEX_PASSWORD')
+                )
+
             response = requests.post(
                 url,
                 auth=auth,
+                headers=headers,
                 json=payload,
                 timeout=timeout,
                 verify=True
             )
 
-            if response.status_code == 200:
+            # 202 Accepted: the FLEX server queued the page for transmission
+            if response.status_code in (200, 202):
                 return True, response.json()
             else:
                 return False, {'status_code': response.status_code, 'response': response.text}
@@ -347,6 +359,7 @@ def generate_config(output_path: str):
         'FLEX_SERVER_URL': 'http://localhost:16180',
         'FLEX_USERNAME': 'admin',
         'FLEX_PASSWORD': 'passw0rd',
+        'FLEX_API_TOKEN': '',
         'DEFAULT_CAPCODE': '0037137',
         'DEFAULT_FREQUENCY': '931937500',
         'REQUEST_TIMEOUT': '30'
@@ -389,6 +402,8 @@ Environment Variables:
   FLEX_SERVER_URL      FLEX server URL (HackRF/TTGO)
   FLEX_USERNAME        FLEX server username
   FLEX_PASSWORD        FLEX server password
+  FLEX_API_TOKEN       flex_http_server API token (used instead of username/password;
+                       leave unset for HackRF/TTGO, which only accept Basic auth)
   DEFAULT_CAPCODE      Default capcode for alerts
   DEFAULT_FREQUENCY    Default frequency for alerts (Hz)
   REQUEST_TIMEOUT      Network timeout (seconds)